@@ -0,0 +1,196 @@
+#ifndef BVH_H
+#define	BVH_H
+
+#include <math.h>
+#include <float.h>
+#include <vector>
+#include <algorithm>
+
+#include "math_3d.h"
+
+// Bounding volume hierarchy over a triangle soup, built once and then only
+// queried for occlusion. Nodes are split at the median centroid along the
+// longest axis of their bounds, which is plenty for static scenery and keeps
+// the build trivial. Queries do not modify the tree and may run on several
+// threads at once.
+class TriangleBVH
+{
+public:
+    TriangleBVH() {}
+
+    // Three vertices per triangle
+    void Build(const std::vector<Vector3f>& Triangles)
+    {
+        triangles = Triangles;
+        nodes.clear();
+        order.resize(triangles.size() / 3);
+
+        for (unsigned int i = 0; i < order.size(); i++)
+        {
+            order[i] = i;
+        }
+
+        if (!order.empty())
+        {
+            nodes.reserve(2 * order.size());
+            nodes.resize(1);
+            BuildNode(0, 0, (unsigned int)order.size());
+        }
+    }
+
+    unsigned int GetNumTriangles() const
+    {
+        return (unsigned int)order.size();
+    }
+
+    // True if anything is hit between Origin and Origin + Dir * MaxDistance. Dir must be normalized.
+    bool Occluded(const Vector3f& Origin, const Vector3f& Dir, float MaxDistance) const
+    {
+        if (nodes.empty()) return false;
+
+        const Vector3f InvDir(1.0f / Dir.x, 1.0f / Dir.y, 1.0f / Dir.z);
+
+        unsigned int Stack[64];
+        unsigned int StackSize = 0;
+        Stack[StackSize++] = 0;
+
+        while (StackSize > 0)
+        {
+            const Node& n = nodes[Stack[--StackSize]];
+
+            if (!IntersectBox(n.Bounds, Origin, InvDir, MaxDistance)) continue;
+
+            if (n.Count > 0)
+            {
+                for (unsigned int i = n.First; i < n.First + n.Count; i++)
+                {
+                    if (IntersectTriangle(order[i], Origin, Dir, MaxDistance)) return true;
+                }
+            }
+            else
+            {
+                Stack[StackSize++] = n.First;
+                Stack[StackSize++] = n.First + 1;
+            }
+        }
+
+        return false;
+    }
+
+private:
+    static const unsigned int MAX_LEAF_TRIANGLES = 4;
+
+    // Inner nodes keep their two children at First and First + 1, leaves the
+    // range [First, First + Count) of the triangle order
+    struct Node
+    {
+        BoundingBox Bounds;
+        unsigned int First;
+        unsigned int Count;
+    };
+
+    const Vector3f& Vertex(unsigned int Triangle, unsigned int Corner) const
+    {
+        return triangles[Triangle * 3 + Corner];
+    }
+
+    float Centroid(unsigned int Triangle, unsigned int Axis) const
+    {
+        const Vector3f& a = Vertex(Triangle, 0);
+        const Vector3f& b = Vertex(Triangle, 1);
+        const Vector3f& c = Vertex(Triangle, 2);
+
+        return Axis == 0 ? a.x + b.x + c.x : (Axis == 1 ? a.y + b.y + c.y : a.z + b.z + c.z);
+    }
+
+    // The node at Slot is already allocated, its children are appended as a pair
+    void BuildNode(unsigned int Slot, unsigned int First, unsigned int Count)
+    {
+        BoundingBox Bounds;
+
+        for (unsigned int i = First; i < First + Count; i++)
+        {
+            Bounds.AddPoint(Vertex(order[i], 0));
+            Bounds.AddPoint(Vertex(order[i], 1));
+            Bounds.AddPoint(Vertex(order[i], 2));
+        }
+
+        nodes[Slot].Bounds = Bounds;
+
+        if (Count <= MAX_LEAF_TRIANGLES)
+        {
+            nodes[Slot].First = First;
+            nodes[Slot].Count = Count;
+            return;
+        }
+
+        const Vector3f Size = Bounds.Max - Bounds.Min;
+        const unsigned int Axis = (Size.x > Size.y && Size.x > Size.z) ? 0 : (Size.y > Size.z ? 1 : 2);
+        const unsigned int Half = Count / 2;
+
+        std::nth_element(order.begin() + First, order.begin() + First + Half, order.begin() + First + Count,
+            [this, Axis](unsigned int l, unsigned int r) { return Centroid(l, Axis) < Centroid(r, Axis); });
+
+        const unsigned int Left = (unsigned int)nodes.size();
+        nodes.resize(Left + 2);
+        nodes[Slot].First = Left;
+        nodes[Slot].Count = 0;
+
+        BuildNode(Left, First, Half);
+        BuildNode(Left + 1, First + Half, Count - Half);
+    }
+
+    static bool IntersectBox(const BoundingBox& b, const Vector3f& Origin, const Vector3f& InvDir, float MaxDistance)
+    {
+        float t0 = (b.Min.x - Origin.x) * InvDir.x;
+        float t1 = (b.Max.x - Origin.x) * InvDir.x;
+        float tMin = fminf(t0, t1);
+        float tMax = fmaxf(t0, t1);
+
+        t0 = (b.Min.y - Origin.y) * InvDir.y;
+        t1 = (b.Max.y - Origin.y) * InvDir.y;
+        tMin = fmaxf(tMin, fminf(t0, t1));
+        tMax = fminf(tMax, fmaxf(t0, t1));
+
+        t0 = (b.Min.z - Origin.z) * InvDir.z;
+        t1 = (b.Max.z - Origin.z) * InvDir.z;
+        tMin = fmaxf(tMin, fminf(t0, t1));
+        tMax = fminf(tMax, fmaxf(t0, t1));
+
+        return tMax >= fmaxf(tMin, 0.0f) && tMin <= MaxDistance;
+    }
+
+    // Moller-Trumbore, both sides of the triangle block the ray
+    bool IntersectTriangle(unsigned int Triangle, const Vector3f& Origin, const Vector3f& Dir, float MaxDistance) const
+    {
+        const Vector3f& a = Vertex(Triangle, 0);
+        const Vector3f e1 = Vertex(Triangle, 1) - a;
+        const Vector3f e2 = Vertex(Triangle, 2) - a;
+
+        const Vector3f p = Dir.Cross(e2);
+        const float Det = e1.x * p.x + e1.y * p.y + e1.z * p.z;
+
+        if (fabsf(Det) < 1e-8f) return false;
+
+        const float InvDet = 1.0f / Det;
+        const Vector3f s = Origin - a;
+        const float u = (s.x * p.x + s.y * p.y + s.z * p.z) * InvDet;
+
+        if (u < 0.0f || u > 1.0f) return false;
+
+        const Vector3f q = s.Cross(e1);
+        const float v = (Dir.x * q.x + Dir.y * q.y + Dir.z * q.z) * InvDet;
+
+        if (v < 0.0f || u + v > 1.0f) return false;
+
+        const float t = (e2.x * q.x + e2.y * q.y + e2.z * q.z) * InvDet;
+
+        return t > 0.0f && t < MaxDistance;
+    }
+
+    std::vector<Vector3f> triangles;
+    std::vector<unsigned int> order;
+    std::vector<Node> nodes;
+};
+
+#endif	/* BVH_H */
@@ -0,0 +1,102 @@
+#ifndef CASCADED_SHADOW_MAP_FBO_H
+#define	CASCADED_SHADOW_MAP_FBO_H
+
+#include <GL/glew.h>
+#include <stdio.h>
+
+#include "shadow_map_fbo.h"
+
+// Depth texture array with one layer per cascade of the directional light.
+// The layers are rendered one at a time and sampled together through a
+// sampler2DArrayShadow.
+class CascadedShadowMapFBO
+{
+public:
+    CascadedShadowMapFBO()
+    {
+        fbo = 0;
+        shadowMap = 0;
+        size = 0;
+        numCascades = 0;
+    }
+
+    ~CascadedShadowMapFBO()
+    {
+        if (fbo != 0) glDeleteFramebuffers(1, &fbo);
+        if (shadowMap != 0) glDeleteTextures(1, &shadowMap);
+    }
+
+    bool Init(unsigned int Size, unsigned int NumCascades, ShadowMapFormat Format = SHADOW_MAP_DEPTH24)
+    {
+        GLenum InternalFormat, Type;
+
+        GetShadowMapFormat(Format, InternalFormat, Type);
+
+        size = Size;
+        numCascades = NumCascades;
+
+        glGenFramebuffers(1, &fbo);
+
+        glGenTextures(1, &shadowMap);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, shadowMap);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, InternalFormat, size, size, numCascades, 0,
+            GL_DEPTH_COMPONENT, Type, NULL);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+        glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowMap, 0, 0);
+
+        glDrawBuffer(GL_NONE);
+
+        GLenum Status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+        if (Status != GL_FRAMEBUFFER_COMPLETE)
+        {
+            printf("FB error, status: 0x%x\n", Status);
+            return false;
+        }
+
+        return true;
+    }
+
+    // Attaches the layer of the given cascade and switches the viewport to
+    // the map size. The previous viewport is restored by UnbindForWriting().
+    void BindForWriting(unsigned int Cascade)
+    {
+        glGetIntegerv(GL_VIEWPORT, savedViewport);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+        glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowMap, 0, Cascade);
+        glViewport(0, 0, size, size);
+    }
+
+    void UnbindForWriting()
+    {
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
+    }
+
+    void BindForReading(GLenum TextureUnit)
+    {
+        glActiveTexture(TextureUnit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, shadowMap);
+    }
+
+    unsigned int GetSize() const { return size; }
+    unsigned int GetNumCascades() const { return numCascades; }
+
+private:
+    GLuint fbo;
+    GLuint shadowMap;
+    unsigned int size;
+    unsigned int numCascades;
+    GLint savedViewport[4];
+};
+
+#endif	/* CASCADED_SHADOW_MAP_FBO_H */
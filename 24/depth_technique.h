@@ -0,0 +1,52 @@
+#ifndef DEPTH_TECHNIQUE_H
+#define	DEPTH_TECHNIQUE_H
+
+#include "technique.h"
+#include "math_3d.h"
+
+// Only the position is read, so the mesh can feed it from its position-only
+// stream (Mesh::RenderDepth). There is no fragment shader - the rasterizer
+// writes the depth and nothing else has to run per fragment.
+static const char* vertex_DT = R"(
+#version 330
+
+layout (location = 0) in vec3 Position;
+
+uniform mat4 gWVP;
+
+void main()
+{
+    gl_Position = gWVP * vec4(Position, 1.0);
+})";
+
+class DepthTechnique : public Technique {
+
+public:
+    DepthTechnique() { }
+
+    bool Init()
+    {
+        if (!Technique::Init()) return false;
+        if (!AddShader(GL_VERTEX_SHADER, vertex_DT)) return false;
+        if (!Finalize()) return false;
+
+        WVPLocation = GetUniformLocation("gWVP");
+
+        if (WVPLocation == INVALID_UNIFORM_LOCATION) {
+            return false;
+        }
+
+        return true;
+    }
+
+    void SetWVP(const Matrix4f& WVP)
+    {
+        glUniformMatrix4fv(WVPLocation, 1, GL_TRUE, (const GLfloat*)WVP.m);
+    }
+
+private:
+
+    GLuint WVPLocation;
+};
+
+#endif	/* DEPTH_TECHNIQUE_H */
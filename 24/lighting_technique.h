@@ -11,6 +11,50 @@
 
 static const unsigned int MAX_POINT_LIGHTS = 2;
 static const unsigned int MAX_SPOT_LIGHTS = 2;
+static const unsigned int NUM_CASCADES = 3;
+
+// Binding point of the SpotShadows block
+static const unsigned int SPOT_SHADOWS_UBO_BINDING = 0;
+
+// std140 mirror of the SpotShadows block
+struct SpotShadowsBlock
+{
+    Matrix4f LightVP[MAX_SPOT_LIGHTS];
+    float Rect[MAX_SPOT_LIGHTS][4];
+};
+
+// Shadow map filtering kernels. All of them use hardware comparison, so each
+// tap already returns the bilinear weighted result of a 2x2 compare. The cost
+// is the number of taps per lit pixel and shadowed light; 'K' measures the
+// lighting pass with every kernel on the GPU at hand.
+//
+//   kernel                    taps   texels
+//   SHADOW_KERNEL_1TAP           1       1
+//   SHADOW_KERNEL_2X2            1       4
+//   SHADOW_KERNEL_POISSON4       4     ~16
+//   SHADOW_KERNEL_POISSON8       8     ~32
+//   SHADOW_KERNEL_POISSON16     16     ~64
+enum ShadowKernel
+{
+    SHADOW_KERNEL_1TAP,
+    SHADOW_KERNEL_2X2,
+    SHADOW_KERNEL_POISSON4,
+    SHADOW_KERNEL_POISSON8,
+    SHADOW_KERNEL_POISSON16,
+    SHADOW_KERNEL_COUNT
+};
+
+// How the spot light shadows are filtered. PCF pays for softness per lit pixel
+// with the kernel above. VSM and EVSM blur a moments copy of the atlas once per
+// texel and then take a single trilinear tap per pixel. EVSM costs twice the
+// storage but suffers much less from light bleeding.
+enum ShadowFilter
+{
+    SHADOW_FILTER_PCF,
+    SHADOW_FILTER_VSM,
+    SHADOW_FILTER_EVSM,
+    SHADOW_FILTER_COUNT
+};
 
 static const char* vertex_LT = R"(                                                          
 #version 330                                                                        
@@ -18,23 +62,23 @@ static const char* vertex_LT = R"(
 layout (location = 0) in vec3 Position;                                             
 layout (location = 1) in vec2 TexCoord;                                             
 layout (location = 2) in vec3 Normal;                                               
+layout (location = 3) in vec2 LightmapTexCoord;                                     
                                                                                     
 uniform mat4 gWVP;                                                                  
-uniform mat4 gLightWVP;                                                             
 uniform mat4 gWorld;                                                                
                                                                                     
-out vec4 LightSpacePos;                                                             
 out vec2 TexCoord0;                                                                 
 out vec3 Normal0;                                                                   
 out vec3 WorldPos0;                                                                 
+out vec2 LightmapTexCoord0;                                                         
                                                                                     
 void main()                                                                         
 {                                                                                   
     gl_Position      = gWVP * vec4(Position, 1.0);                                  
-    LightSpacePos = gLightWVP * vec4(Position, 1.0);                                 
     TexCoord0        = TexCoord;                                                    
     Normal0          = (gWorld * vec4(Normal, 0.0)).xyz;                            
     WorldPos0        = (gWorld * vec4(Position, 1.0)).xyz;                               
+    LightmapTexCoord0 = LightmapTexCoord;                                           
 })";
 
 static const char* fragment_LT = R"(                                                          
@@ -42,11 +86,12 @@ static const char* fragment_LT = R"(
                                                                                     
 const int MAX_POINT_LIGHTS = 2;                                                     
 const int MAX_SPOT_LIGHTS = 2;                                                      
+const int NUM_CASCADES = 3;                                                         
                                                                                     
-in vec4 LightSpacePos;                                                              
 in vec2 TexCoord0;                                                                  
 in vec3 Normal0;                                                                    
 in vec3 WorldPos0;                                                                  
+in vec2 LightmapTexCoord0;                                                          
                                                                                     
 out vec4 FragColor;                                                                 
                                                                                     
@@ -90,23 +135,154 @@ uniform DirectionalLight gDirectionalLight;
 uniform PointLight gPointLights[MAX_POINT_LIGHTS];                                          
 uniform SpotLight gSpotLights[MAX_SPOT_LIGHTS];                                             
 uniform sampler2D gSampler;                                                                 
-uniform sampler2D gShadowMap;                                                               
+uniform sampler2DShadow gShadowMap;                                                         
+uniform int gShadowKernel;                                                                  
+uniform vec2 gShadowMapTexelSize;                                                           
+uniform int gShadowFilter;                                                                  
+uniform sampler2D gShadowMoments;                                                           
+                                                                                            
+// Baked directional light of the static objects, diffuse in rgb and the                    
+// visibility through the static occluders in alpha                                         
+uniform sampler2D gLightmap;                                                                
+uniform bool gLightmapEnabled;                                                              
+                                                                                            
+// World to light clip space transformation of every spot light and the                     
+// rectangle of its tile in the shadow atlas (offset in xy, scale in zw)                    
+layout (std140, row_major) uniform SpotShadows                                              
+{                                                                                           
+    mat4 gSpotShadowVP[MAX_SPOT_LIGHTS];                                                    
+    vec4 gSpotShadowRect[MAX_SPOT_LIGHTS];                                                  
+};                                                                                          
+uniform samplerCubeShadow gPointShadowMap;                                                  
+uniform int gPointShadowLight;                                                              
+uniform float gPointShadowFar;                                                              
+uniform sampler2DArrayShadow gCascadeShadowMap;                                             
+uniform mat4 gCascadeLightVP[NUM_CASCADES];                                                 
+uniform float gCascadeEnd[NUM_CASCADES];                                                    
 uniform vec3 gEyeWorldPos;                                                                  
 uniform float gMatSpecularIntensity;                                                        
 uniform float gSpecularPower;                                                               
                                                                                             
-float CalcShadowFactor(vec4 LightSpacePos)                                                  
+const vec2 PoissonDisk[16] = vec2[](                                                        
+    vec2(-0.94201624, -0.39906216), vec2( 0.94558609, -0.76890725),                         
+    vec2(-0.09418410, -0.92938870), vec2( 0.34495938,  0.29387760),                         
+    vec2(-0.91588581,  0.45771432), vec2(-0.81544232, -0.87912464),                         
+    vec2(-0.38277543,  0.27676845), vec2( 0.97484398,  0.75648379),                         
+    vec2( 0.44323325, -0.97511554), vec2( 0.53742981, -0.47373420),                         
+    vec2(-0.26496911, -0.41893023), vec2( 0.79197514,  0.19090188),                         
+    vec2(-0.24188840,  0.99706507), vec2(-0.81409955,  0.91437590),                         
+    vec2( 0.19984126,  0.78641367), vec2( 0.14383161, -0.14100790));                        
+                                                                                            
+// Must match the exponents used when the moments are written                               
+const float EVSM_POSITIVE_EXPONENT = 5.0;                                                   
+const float EVSM_NEGATIVE_EXPONENT = 5.0;                                                   
+                                                                                            
+// Upper bound of the probability that the pixel is lit, with the tail cut                  
+// off to reduce light bleeding                                                             
+float Chebyshev(vec2 Moments, float Depth, float MinVariance)                               
 {                                                                                           
-    vec3 ProjCoords = LightSpacePos.xyz / LightSpacePos.w;                                  
-    vec2 UVCoords;                                                                          
-    UVCoords.x = 0.5 * ProjCoords.x + 0.5;                                                  
-    UVCoords.y = 0.5 * ProjCoords.y + 0.5;                                                  
-    float z = 0.5 * ProjCoords.z + 0.5;                                                     
-    float Depth = texture(gShadowMap, UVCoords).x;                                          
-    if (Depth < z + 0.00001)                                                                 
-        return 0.5;                                                                         
-    else                                                                                    
+    if (Depth <= Moments.x) {                                                               
+        return 1.0;                                                                         
+    }                                                                                       
+                                                                                            
+    float Variance = max(Moments.y - Moments.x * Moments.x, MinVariance);                   
+    float d = Depth - Moments.x;                                                            
+    float pMax = Variance / (Variance + d * d);                                             
+                                                                                            
+    return clamp((pMax - 0.2) / 0.8, 0.0, 1.0);                                             
+}                                                                                           
+                                                                                            
+float CalcMomentsVisibility(vec2 UV, float Depth)                                           
+{                                                                                           
+    vec4 Moments = texture(gShadowMoments, UV);                                             
+                                                                                            
+    if (gShadowFilter == 1) {                                                               
+        return Chebyshev(Moments.xy, Depth, 0.00002);                                       
+    }                                                                                       
+                                                                                            
+    float Pos = exp(EVSM_POSITIVE_EXPONENT * Depth);                                        
+    float Neg = -exp(-EVSM_NEGATIVE_EXPONENT * Depth);                                      
+                                                                                            
+    return min(Chebyshev(Moments.xy, Pos, 0.00002 * Pos * Pos),                             
+               Chebyshev(Moments.zw, Neg, 0.00002 * Neg * Neg));                            
+}                                                                                           
+                                                                                            
+                                                                                            
+// Every texture() call on the shadow sampler is a hardware depth compare                   
+// with bilinear filtering of the 2x2 results. The coordinates are clamped to               
+// the tile of the light so that the kernel never reads its neighbours.                     
+float CalcSpotShadowFactor(int Light)                                                       
+{                                                                                           
+    vec4 Rect = gSpotShadowRect[Light];                                                     
+                                                                                            
+    if (Rect.z == 0.0) {                                                                    
         return 1.0;                                                                         
+    }                                                                                       
+                                                                                            
+    vec4 LightSpacePos = gSpotShadowVP[Light] * vec4(WorldPos0, 1.0);                       
+    vec3 ProjCoords = LightSpacePos.xyz / LightSpacePos.w;                                  
+    vec3 UVZ = 0.5 * ProjCoords + 0.5;                                                      
+    UVZ.xy = Rect.xy + UVZ.xy * Rect.zw;                                                    
+                                                                                            
+    vec2 TileMin = Rect.xy + 0.5 * gShadowMapTexelSize;                                     
+    vec2 TileMax = Rect.xy + Rect.zw - 0.5 * gShadowMapTexelSize;                           
+    float Visibility;                                                                       
+                                                                                            
+    if (gShadowFilter != 0) {                                                               
+        Visibility = CalcMomentsVisibility(clamp(UVZ.xy, TileMin, TileMax), UVZ.z);         
+    }                                                                                       
+    else if (gShadowKernel == 0) {                                                          
+        // snapped to the texel center so a single texel contributes                        
+        vec2 UV = (floor(UVZ.xy / gShadowMapTexelSize) + 0.5) * gShadowMapTexelSize;        
+        Visibility = texture(gShadowMap, vec3(clamp(UV, TileMin, TileMax), UVZ.z));         
+    }                                                                                       
+    else if (gShadowKernel == 1) {                                                          
+        Visibility = texture(gShadowMap, vec3(clamp(UVZ.xy, TileMin, TileMax), UVZ.z));     
+    }                                                                                       
+    else {                                                                                  
+        int NumTaps = (gShadowKernel == 2) ? 4 : ((gShadowKernel == 3) ? 8 : 16);           
+        Visibility = 0.0;                                                                   
+        for (int i = 0 ; i < NumTaps ; i++) {                                               
+            vec2 UV = UVZ.xy + PoissonDisk[i] * gShadowMapTexelSize * 1.5;                  
+            Visibility += texture(gShadowMap, vec3(clamp(UV, TileMin, TileMax), UVZ.z));    
+        }                                                                                   
+        Visibility /= float(NumTaps);                                                       
+    }                                                                                       
+                                                                                            
+    return 0.5 + 0.5 * Visibility;                                                          
+}                                                                                           
+                                                                                            
+float CalcCascadeVisibility(int Cascade)                                                    
+{                                                                                           
+    vec4 LightSpacePos = gCascadeLightVP[Cascade] * vec4(WorldPos0, 1.0);                   
+    vec3 UVZ = 0.5 * LightSpacePos.xyz + 0.5;                                               
+    return texture(gCascadeShadowMap, vec4(UVZ.xy, float(Cascade), UVZ.z));                 
+}                                                                                           
+                                                                                            
+// The cascade is selected by view depth. Over the last part of a cascade the               
+// result is blended with the next one to hide the change in resolution.                    
+float CalcDirectionalShadowFactor()                                                         
+{                                                                                           
+    float ViewDepth = 1.0 / gl_FragCoord.w;                                                 
+    float CascadeStart = 0.0;                                                               
+                                                                                            
+    for (int i = 0 ; i < NUM_CASCADES ; i++) {                                              
+        if (ViewDepth <= gCascadeEnd[i]) {                                                  
+            float Visibility = CalcCascadeVisibility(i);                                    
+            float BlendStart = mix(CascadeStart, gCascadeEnd[i], 0.9);                      
+                                                                                            
+            if (i < NUM_CASCADES - 1 && ViewDepth > BlendStart) {                           
+                float t = (ViewDepth - BlendStart) / (gCascadeEnd[i] - BlendStart);         
+                Visibility = mix(Visibility, CalcCascadeVisibility(i + 1), t);              
+            }                                                                               
+                                                                                            
+            return 0.5 + 0.5 * Visibility;                                                  
+        }                                                                                   
+                                                                                            
+        CascadeStart = gCascadeEnd[i];                                                      
+    }                                                                                       
+                                                                                            
+    return 1.0;                                                                             
 }                                                                                           
                                                                                             
 vec4 CalcLightInternal(BaseLight Light, vec3 LightDirection, vec3 Normal,            
@@ -136,15 +312,25 @@ vec4 CalcLightInternal(BaseLight Light, vec3 LightDirection, vec3 Normal,
                                                                                             
 vec4 CalcDirectionalLight(vec3 Normal)                                                      
 {                                                                                                
-    return CalcLightInternal(gDirectionalLight.Base, gDirectionalLight.Direction, Normal, 1.0);  
+    return CalcLightInternal(gDirectionalLight.Base, gDirectionalLight.Direction, Normal,       
+                             CalcDirectionalShadowFactor());                                 
 }                                                                                                
                                                                                             
-vec4 CalcPointLight(PointLight l, vec3 Normal, vec4 LightSpacePos)                   
+// The cascades only add the shadows of the dynamic casters on top of the baked ones        
+vec4 CalcBakedDirectionalLight()                                                            
+{                                                                                           
+    vec4 Baked = texture(gLightmap, LightmapTexCoord0);                                     
+    vec4 AmbientColor = vec4(gDirectionalLight.Base.Color, 1.0) *                           
+                        gDirectionalLight.Base.AmbientIntensity;                            
+    float ShadowFactor = min(0.5 + 0.5 * Baked.a, CalcDirectionalShadowFactor());           
+    return AmbientColor + vec4(Baked.rgb, 0.0) * ShadowFactor;                              
+}                                                                                           
+                                                                                            
+vec4 CalcPointLightInternal(PointLight l, vec3 Normal, float ShadowFactor)                  
 {                                                                                           
     vec3 LightDirection = WorldPos0 - l.Position;                                           
     float Distance = length(LightDirection);                                                
     LightDirection = normalize(LightDirection);                                             
-    float ShadowFactor = CalcShadowFactor(LightSpacePos);                                   
                                                                                             
     vec4 Color = CalcLightInternal(l.Base, LightDirection, Normal, ShadowFactor);           
     float Attenuation =  l.Atten.Constant +                                                 
@@ -154,13 +340,34 @@ vec4 CalcPointLight(PointLight l, vec3 Normal, vec4 LightSpacePos)
     return Color / Attenuation;                                                             
 }                                                                                           
                                                                                             
-vec4 CalcSpotLight(SpotLight l, vec3 Normal, vec4 LightSpacePos)                     
+// The cube map stores the distance to the light over the far plane, so the                 
+// light to pixel vector is both the lookup direction and the reference depth               
+float CalcPointShadowFactor(vec3 LightPos)                                                  
+{                                                                                           
+    vec3 LightToPixel = WorldPos0 - LightPos;                                               
+    float Depth = length(LightToPixel) / gPointShadowFar;                                   
+    return 0.5 + 0.5 * texture(gPointShadowMap, vec4(LightToPixel, Depth));                 
+}                                                                                           
+                                                                                            
+vec4 CalcPointLight(int Index, vec3 Normal)                                                 
 {                                                                                           
+    PointLight l = gPointLights[Index];                                                     
+    float ShadowFactor = (Index == gPointShadowLight) ? CalcPointShadowFactor(l.Position) : 1.0;
+    return CalcPointLightInternal(l, Normal, ShadowFactor);                                 
+}                                                                                           
+                                                                                            
+vec4 CalcSpotLight(int Index, vec3 Normal)                                                  
+{                                                                                           
+    SpotLight l = gSpotLights[Index];                                                       
     vec3 LightToPixel = normalize(WorldPos0 - l.Base.Position);                             
     float SpotFactor = dot(LightToPixel, l.Direction);                                      
                                                                                             
+    // Sampled in uniform control flow, the moments are mipmapped and the                   
+    // derivatives for their LOD are undefined inside the cone test                         
+    float ShadowFactor = CalcSpotShadowFactor(Index);                                       
+                                                                                            
     if (SpotFactor > l.Cutoff) {                                                            
-        vec4 Color = CalcPointLight(l.Base, Normal, LightSpacePos);                         
+        vec4 Color = CalcPointLightInternal(l.Base, Normal, ShadowFactor);                  
         return Color * (1.0 - (1.0 - SpotFactor) * 1.0/(1.0 - l.Cutoff));                   
     }                                                                                       
     else {                                                                                  
@@ -171,14 +378,15 @@ vec4 CalcSpotLight(SpotLight l, vec3 Normal, vec4 LightSpacePos)
 void main()                                                                                 
 {                                                                                           
     vec3 Normal = normalize(Normal0);                                                       
-    vec4 TotalLight = CalcDirectionalLight(Normal);                                         
+    vec4 TotalLight = gLightmapEnabled ? CalcBakedDirectionalLight() :                      
+                                         CalcDirectionalLight(Normal);                      
                                                                                             
     for (int i = 0 ; i < gNumPointLights ; i++) {                                           
-        TotalLight += CalcPointLight(gPointLights[i], Normal, LightSpacePos);               
+        TotalLight += CalcPointLight(i, Normal);                              
     }                                                                                       
                                                                                             
     for (int i = 0 ; i < gNumSpotLights ; i++) {                                            
-        TotalLight += CalcSpotLight(gSpotLights[i], Normal, LightSpacePos);                 
+        TotalLight += CalcSpotLight(i, Normal);                                             
     }                                                                                       
                                                                                             
     vec4 SampledColor = texture2D(gSampler, TexCoord0.xy);                                  
@@ -259,8 +467,22 @@ private:
     GLuint numPointLightsLocation;
     GLuint numSpotLightsLocation;
 
-    GLuint LightWVPLocation;
     GLuint shadowMapLocation;
+    GLuint shadowKernelLocation;
+    GLuint shadowMapTexelSizeLocation;
+    GLuint shadowFilterLocation;
+    GLuint shadowMomentsLocation;
+
+    GLuint pointShadowMapLocation;
+    GLuint pointShadowLightLocation;
+    GLuint pointShadowFarLocation;
+
+    GLuint cascadeShadowMapLocation;
+    GLuint cascadeLightVPLocation[NUM_CASCADES];
+    GLuint cascadeEndLocation[NUM_CASCADES];
+
+    GLuint lightmapLocation;
+    GLuint lightmapEnabledLocation;
 
     struct
     {
@@ -330,8 +552,17 @@ public:
         numPointLightsLocation = GetUniformLocation("gNumPointLights");
         numSpotLightsLocation = GetUniformLocation("gNumSpotLights");
 
-        LightWVPLocation = GetUniformLocation("gLightWVP");
         shadowMapLocation = GetUniformLocation("gShadowMap");
+        shadowKernelLocation = GetUniformLocation("gShadowKernel");
+        shadowMapTexelSizeLocation = GetUniformLocation("gShadowMapTexelSize");
+        shadowFilterLocation = GetUniformLocation("gShadowFilter");
+        shadowMomentsLocation = GetUniformLocation("gShadowMoments");
+        pointShadowMapLocation = GetUniformLocation("gPointShadowMap");
+        pointShadowLightLocation = GetUniformLocation("gPointShadowLight");
+        pointShadowFarLocation = GetUniformLocation("gPointShadowFar");
+        cascadeShadowMapLocation = GetUniformLocation("gCascadeShadowMap");
+        lightmapLocation = GetUniformLocation("gLightmap");
+        lightmapEnabledLocation = GetUniformLocation("gLightmapEnabled");
 
         if (dirLightLocation.AmbientIntensity == INVALID_UNIFORM_LOCATION ||
             WVPLocation == INVALID_UNIFORM_LOCATION ||
@@ -344,7 +575,9 @@ public:
             matSpecularIntensityLocation == INVALID_UNIFORM_LOCATION ||
             matSpecularPowerLocation == INVALID_UNIFORM_LOCATION ||
             numPointLightsLocation == INVALID_UNIFORM_LOCATION ||
-            numSpotLightsLocation == INVALID_UNIFORM_LOCATION) {
+            numSpotLightsLocation == INVALID_UNIFORM_LOCATION ||
+            lightmapLocation == INVALID_UNIFORM_LOCATION ||
+            lightmapEnabledLocation == INVALID_UNIFORM_LOCATION) {
             return false;
         }
 
@@ -428,18 +661,91 @@ public:
             }
         }
 
+        if (!BindUniformBlock("SpotShadows", SPOT_SHADOWS_UBO_BINDING)) {
+            return false;
+        }
+
+        for (unsigned int i = 0; i < NUM_CASCADES; i++)
+        {
+            char Name[128];
+            memset(Name, 0, sizeof(Name));
+            snprintf(Name, sizeof(Name), "gCascadeLightVP[%u]", i);
+            cascadeLightVPLocation[i] = GetUniformLocation(Name);
+
+            snprintf(Name, sizeof(Name), "gCascadeEnd[%u]", i);
+            cascadeEndLocation[i] = GetUniformLocation(Name);
+
+            if (cascadeLightVPLocation[i] == INVALID_UNIFORM_LOCATION ||
+                cascadeEndLocation[i] == INVALID_UNIFORM_LOCATION) {
+                return false;
+            }
+        }
+
         return true;
     }
 
-    // calculated from the position of the light source
-    void SetLightWVP(const Matrix4f& LightWVP)
+    void SetShadowMapTextureUnit(unsigned int TextureUnit)
     {
-        glUniformMatrix4fv(LightWVPLocation, 1, GL_TRUE, (const GLfloat*)LightWVP.m);
+        glUniform1i(shadowMapLocation, TextureUnit);
     }
 
-    void SetShadowMapTextureUnit(unsigned int TextureUnit)
+    void SetShadowKernel(ShadowKernel Kernel)
     {
-        glUniform1i(shadowMapLocation, TextureUnit);
+        glUniform1i(shadowKernelLocation, Kernel);
+    }
+
+    void SetShadowFilter(ShadowFilter Filter)
+    {
+        glUniform1i(shadowFilterLocation, Filter);
+    }
+
+    void SetShadowMomentsTextureUnit(unsigned int TextureUnit)
+    {
+        glUniform1i(shadowMomentsLocation, TextureUnit);
+    }
+
+    void SetShadowMapSize(unsigned int Width, unsigned int Height)
+    {
+        glUniform2f(shadowMapTexelSizeLocation, 1.0f / Width, 1.0f / Height);
+    }
+
+    void SetPointShadowMapTextureUnit(unsigned int TextureUnit)
+    {
+        glUniform1i(pointShadowMapLocation, TextureUnit);
+    }
+
+    // Index of the point light that owns the cube shadow map, -1 for none
+    void SetPointShadowLight(int Index, float FarPlane)
+    {
+        glUniform1i(pointShadowLightLocation, Index);
+        glUniform1f(pointShadowFarLocation, FarPlane);
+    }
+
+    void SetCascadeShadowMapTextureUnit(unsigned int TextureUnit)
+    {
+        glUniform1i(cascadeShadowMapLocation, TextureUnit);
+    }
+
+    void SetLightmapTextureUnit(unsigned int TextureUnit)
+    {
+        glUniform1i(lightmapLocation, TextureUnit);
+    }
+
+    // Lightmapped draws take the directional light from the lightmap bound to
+    // the lightmap texture unit and need the lightmap UVs in attribute 3
+    void SetLightmapEnabled(bool Enabled)
+    {
+        glUniform1i(lightmapEnabledLocation, Enabled ? 1 : 0);
+    }
+
+    // world to light clip space transformation and view space end depth of every cascade
+    void SetCascades(const Matrix4f* pLightVP, const float* pCascadeEnd)
+    {
+        for (unsigned int i = 0; i < NUM_CASCADES; i++)
+        {
+            glUniformMatrix4fv(cascadeLightVPLocation[i], 1, GL_TRUE, (const GLfloat*)pLightVP[i].m);
+            glUniform1f(cascadeEndLocation[i], pCascadeEnd[i]);
+        }
     }
 
     void SetWVP(const Matrix4f& WVP)
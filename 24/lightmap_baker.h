@@ -0,0 +1,311 @@
+#ifndef LIGHTMAP_BAKER_H
+#define	LIGHTMAP_BAKER_H
+
+#include <math.h>
+#include <float.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <GL/glew.h>
+
+#include "math_3d.h"
+#include "bvh.h"
+#include "lightmap_uv.h"
+#include "lighting_technique.h"
+
+// Offset along the normal that keeps the shadow rays from hitting the surface they start on
+static const float LIGHTMAP_RAY_BIAS = 0.01f;
+
+// Bakes the static directional light into the lightmap of a static mesh.
+//
+// The triangles of the receiver are rasterized in lightmap space, giving a
+// world position and normal per texel. The texels are then shaded on all
+// cores: the diffuse term of the light goes to rgb and the visibility of the
+// light through the static occluders, found with a ray cast against a BVH,
+// goes to alpha. Keeping them apart lets the lighting shader combine the
+// baked visibility with the shadows of the dynamic casters without darkening
+// the same spot twice. Finally the charts are dilated into the padding so
+// that bilinear filtering never picks up unbaked texels.
+class LightmapBaker
+{
+public:
+    LightmapBaker()
+    {
+        size = 256;
+        dilateIterations = 4;
+        numThreads = std::thread::hardware_concurrency();
+
+        if (numThreads == 0) numThreads = 1;
+    }
+
+    void SetSize(unsigned int Size)
+    {
+        size = Size;
+    }
+
+    unsigned int GetSize() const
+    {
+        return size;
+    }
+
+    void SetNumThreads(unsigned int NumThreads)
+    {
+        numThreads = NumThreads > 0 ? NumThreads : 1;
+    }
+
+    unsigned int GetNumThreads() const
+    {
+        return numThreads;
+    }
+
+    // World space triangles, three vertices each, which may block the light
+    void AddOccluders(const std::vector<Vector3f>& Triangles)
+    {
+        occluders.insert(occluders.end(), Triangles.begin(), Triangles.end());
+    }
+
+    void SetDirectionalLight(const DirectionalLight& Light)
+    {
+        dirLight = Light;
+    }
+
+    // Vertices are in model space and placed by World. Texels receives
+    // Size * Size RGBA values, rows from v = 0 up. Returns the bake time in ms.
+    double Bake(const std::vector<LightmapVertex>& Vertices, const Matrix4f& World, std::vector<float>& Texels)
+    {
+        const auto Start = std::chrono::high_resolution_clock::now();
+
+        bvh.Build(occluders);
+
+        texelPos.assign(size * size, Vector3f(0.0f, 0.0f, 0.0f));
+        texelNormal.assign(size * size, Vector3f(0.0f, 0.0f, 0.0f));
+        covered.assign(size * size, 0);
+
+        for (unsigned int i = 0; i + 2 < Vertices.size(); i += 3)
+        {
+            RasterizeTriangle(&Vertices[i], World);
+        }
+
+        Texels.assign(size * size * 4, 0.0f);
+
+        std::atomic<unsigned int> NextRow(0);
+        std::vector<std::thread> Workers;
+
+        for (unsigned int i = 0; i < numThreads; i++)
+        {
+            Workers.push_back(std::thread([this, &NextRow, &Texels]()
+            {
+                for (unsigned int y = NextRow++; y < size; y = NextRow++)
+                {
+                    ShadeRow(y, &Texels[y * size * 4]);
+                }
+            }));
+        }
+
+        for (unsigned int i = 0; i < Workers.size(); i++)
+        {
+            Workers[i].join();
+        }
+
+        for (unsigned int i = 0; i < dilateIterations; i++)
+        {
+            Dilate(Texels);
+        }
+
+        const auto End = std::chrono::high_resolution_clock::now();
+
+        return std::chrono::duration<double, std::milli>(End - Start).count();
+    }
+
+private:
+    static Vector3f TransformPoint(const Matrix4f& m, const Vector3f& v)
+    {
+        return Vector3f(m.m[0][0] * v.x + m.m[0][1] * v.y + m.m[0][2] * v.z + m.m[0][3],
+                        m.m[1][0] * v.x + m.m[1][1] * v.y + m.m[1][2] * v.z + m.m[1][3],
+                        m.m[2][0] * v.x + m.m[2][1] * v.y + m.m[2][2] * v.z + m.m[2][3]);
+    }
+
+    static Vector3f TransformVector(const Matrix4f& m, const Vector3f& v)
+    {
+        return Vector3f(m.m[0][0] * v.x + m.m[0][1] * v.y + m.m[0][2] * v.z,
+                        m.m[1][0] * v.x + m.m[1][1] * v.y + m.m[1][2] * v.z,
+                        m.m[2][0] * v.x + m.m[2][1] * v.y + m.m[2][2] * v.z);
+    }
+
+    // Fills the position and normal of every texel whose center lies inside the triangle
+    void RasterizeTriangle(const LightmapVertex* pVertices, const Matrix4f& World)
+    {
+        Vector3f Pos[3];
+        Vector3f Normal[3];
+        float x[3];
+        float y[3];
+
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            Pos[i] = TransformPoint(World, pVertices[i].pos);
+            Normal[i] = TransformVector(World, pVertices[i].normal);
+            x[i] = pVertices[i].lightmapTex.x * size;
+            y[i] = pVertices[i].lightmapTex.y * size;
+        }
+
+        const float Area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+
+        if (fabsf(Area) < 1e-8f) return;
+
+        const int MinX = (int)fmaxf(floorf(fminf(x[0], fminf(x[1], x[2]))), 0.0f);
+        const int MinY = (int)fmaxf(floorf(fminf(y[0], fminf(y[1], y[2]))), 0.0f);
+        const int MaxX = (int)fminf(ceilf(fmaxf(x[0], fmaxf(x[1], x[2]))), (float)size - 1);
+        const int MaxY = (int)fminf(ceilf(fmaxf(y[0], fmaxf(y[1], y[2]))), (float)size - 1);
+
+        for (int ty = MinY; ty <= MaxY; ty++)
+        {
+            for (int tx = MinX; tx <= MaxX; tx++)
+            {
+                const float px = tx + 0.5f;
+                const float py = ty + 0.5f;
+
+                const float b0 = ((x[1] - px) * (y[2] - py) - (x[2] - px) * (y[1] - py)) / Area;
+                const float b1 = ((x[2] - px) * (y[0] - py) - (x[0] - px) * (y[2] - py)) / Area;
+                const float b2 = 1.0f - b0 - b1;
+
+                if (b0 < 0.0f || b1 < 0.0f || b2 < 0.0f) continue;
+
+                const unsigned int Texel = ty * size + tx;
+                texelPos[Texel] = Pos[0] * b0 + Pos[1] * b1 + Pos[2] * b2;
+                texelNormal[Texel] = Normal[0] * b0 + Normal[1] * b1 + Normal[2] * b2;
+                texelNormal[Texel].Normalize();
+                covered[Texel] = 1;
+            }
+        }
+    }
+
+    void ShadeRow(unsigned int y, float* pRow) const
+    {
+        Vector3f ToLight = dirLight.Direction * -1.0f;
+        ToLight.Normalize();
+
+        for (unsigned int x = 0; x < size; x++)
+        {
+            const unsigned int Texel = y * size + x;
+
+            if (!covered[Texel]) continue;
+
+            const Vector3f& N = texelNormal[Texel];
+            const float NdotL = N.x * ToLight.x + N.y * ToLight.y + N.z * ToLight.z;
+            float Visibility = 1.0f;
+
+            if (NdotL > 0.0f)
+            {
+                const Vector3f Origin = texelPos[Texel] + N * LIGHTMAP_RAY_BIAS;
+                Visibility = bvh.Occluded(Origin, ToLight, FLT_MAX) ? 0.0f : 1.0f;
+            }
+
+            const float Diffuse = dirLight.DiffuseIntensity * fmaxf(NdotL, 0.0f);
+            pRow[x * 4 + 0] = dirLight.Color.x * Diffuse;
+            pRow[x * 4 + 1] = dirLight.Color.y * Diffuse;
+            pRow[x * 4 + 2] = dirLight.Color.z * Diffuse;
+            pRow[x * 4 + 3] = Visibility;
+        }
+    }
+
+    // Every empty texel next to a baked one takes the average of its baked neighbours
+    void Dilate(std::vector<float>& Texels)
+    {
+        std::vector<unsigned char> Covered = covered;
+
+        for (unsigned int y = 0; y < size; y++)
+        {
+            for (unsigned int x = 0; x < size; x++)
+            {
+                if (covered[y * size + x]) continue;
+
+                float Sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+                unsigned int Count = 0;
+
+                for (int dy = -1; dy <= 1; dy++)
+                {
+                    for (int dx = -1; dx <= 1; dx++)
+                    {
+                        const int nx = (int)x + dx;
+                        const int ny = (int)y + dy;
+
+                        if (nx < 0 || ny < 0 || nx >= (int)size || ny >= (int)size || !covered[ny * size + nx]) continue;
+
+                        for (unsigned int c = 0; c < 4; c++)
+                        {
+                            Sum[c] += Texels[(ny * size + nx) * 4 + c];
+                        }
+
+                        Count++;
+                    }
+                }
+
+                if (Count == 0) continue;
+
+                for (unsigned int c = 0; c < 4; c++)
+                {
+                    Texels[(y * size + x) * 4 + c] = Sum[c] / Count;
+                }
+
+                Covered[y * size + x] = 1;
+            }
+        }
+
+        covered.swap(Covered);
+    }
+
+    unsigned int size;
+    unsigned int numThreads;
+    unsigned int dilateIterations;
+    DirectionalLight dirLight;
+    std::vector<Vector3f> occluders;
+    TriangleBVH bvh;
+    std::vector<Vector3f> texelPos;
+    std::vector<Vector3f> texelNormal;
+    std::vector<unsigned char> covered;
+};
+
+// RGBA16F texture holding the result of LightmapBaker::Bake()
+class LightmapTexture
+{
+public:
+    LightmapTexture()
+    {
+        textureObj = 0;
+    }
+
+    ~LightmapTexture()
+    {
+        if (textureObj != 0) glDeleteTextures(1, &textureObj);
+    }
+
+    bool Init(unsigned int Size, const std::vector<float>& Texels)
+    {
+        // drop the errors of earlier calls, only the allocation below is checked
+        while (glGetError() != GL_NO_ERROR) {}
+
+        if (textureObj == 0) glGenTextures(1, &textureObj);
+
+        glBindTexture(GL_TEXTURE_2D, textureObj);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, Size, Size, 0, GL_RGBA, GL_FLOAT, &Texels[0]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        return glGetError() == GL_NO_ERROR;
+    }
+
+    void Bind(GLenum TextureUnit)
+    {
+        glActiveTexture(TextureUnit);
+        glBindTexture(GL_TEXTURE_2D, textureObj);
+    }
+
+private:
+    GLuint textureObj;
+};
+
+#endif	/* LIGHTMAP_BAKER_H */
@@ -0,0 +1,140 @@
+#ifndef LIGHTMAP_UV_H
+#define	LIGHTMAP_UV_H
+
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+#include "math_3d.h"
+
+// Vertex of a lightmapped mesh. Triangles never share vertices since every
+// one of them owns a separate chart in the lightmap.
+struct LightmapVertex
+{
+    Vector3f pos;
+    Vector2f tex;
+    Vector3f normal;
+    Vector2f lightmapTex;
+};
+
+// Generates the second UV set of a mesh for a square lightmap of Size texels.
+// Every triangle is flattened into its own plane with the longest edge along
+// u, the charts are sorted by height and packed into shelves. The texel
+// density is the same for all triangles and is lowered until everything
+// fits. Padding texels are left around every chart so that the dilated
+// border of one chart never bleeds into its neighbour.
+//
+// Positions holds three vertices per triangle. Returns false if the
+// triangles do not fit at any reasonable density.
+inline bool GenerateLightmapUVs(const std::vector<Vector3f>& Positions, unsigned int Size, unsigned int Padding,
+    std::vector<Vector2f>& UVs)
+{
+    struct Chart
+    {
+        Vector2f Corners[3];
+        float Width;
+        float Height;
+    };
+
+    const unsigned int NumTriangles = (unsigned int)Positions.size() / 3;
+    std::vector<Chart> Charts(NumTriangles);
+    std::vector<unsigned int> Order(NumTriangles);
+    float TotalArea = 0.0f;
+
+    for (unsigned int i = 0; i < NumTriangles; i++)
+    {
+        const Vector3f* p = &Positions[i * 3];
+        float LongestSq = -1.0f;
+        unsigned int Base = 0;
+
+        for (unsigned int e = 0; e < 3; e++)
+        {
+            const Vector3f Edge = p[(e + 1) % 3] - p[e];
+            const float LengthSq = Edge.x * Edge.x + Edge.y * Edge.y + Edge.z * Edge.z;
+
+            if (LengthSq > LongestSq)
+            {
+                LongestSq = LengthSq;
+                Base = e;
+            }
+        }
+
+        const Vector3f& a = p[Base];
+        const Vector3f& b = p[(Base + 1) % 3];
+        const Vector3f& c = p[(Base + 2) % 3];
+        const float BaseLength = sqrtf(LongestSq);
+
+        Vector3f u = b - a;
+        u *= BaseLength > 0.0f ? 1.0f / BaseLength : 0.0f;
+
+        const Vector3f ac = c - a;
+        const float cu = ac.x * u.x + ac.y * u.y + ac.z * u.z;
+        const Vector3f Perp = ac - u * cu;
+        const float cv = sqrtf(Perp.x * Perp.x + Perp.y * Perp.y + Perp.z * Perp.z);
+
+        // the third corner projects inside the base since the base is the longest edge
+        Chart& ch = Charts[i];
+        ch.Corners[Base] = Vector2f(0.0f, 0.0f);
+        ch.Corners[(Base + 1) % 3] = Vector2f(BaseLength, 0.0f);
+        ch.Corners[(Base + 2) % 3] = Vector2f(cu, cv);
+        ch.Width = BaseLength;
+        ch.Height = cv;
+
+        TotalArea += ch.Width * ch.Height;
+        Order[i] = i;
+    }
+
+    std::sort(Order.begin(), Order.end(),
+        [&Charts](unsigned int l, unsigned int r) { return Charts[l].Height > Charts[r].Height; });
+
+    UVs.resize(NumTriangles * 3);
+
+    if (TotalArea <= 0.0f) return false;
+
+    // Start from the density that would fill the whole lightmap and back off
+    // until the shelves fit
+    float TexelsPerUnit = sqrtf((float)Size * Size / TotalArea);
+
+    for (unsigned int Attempt = 0; Attempt < 64; Attempt++, TexelsPerUnit *= 0.9f)
+    {
+        float x = 0.0f;
+        float y = 0.0f;
+        float ShelfHeight = 0.0f;
+        bool Fits = true;
+
+        for (unsigned int i = 0; i < NumTriangles && Fits; i++)
+        {
+            const Chart& ch = Charts[Order[i]];
+            const float w = ceilf(ch.Width * TexelsPerUnit) + 2 * Padding;
+            const float h = ceilf(ch.Height * TexelsPerUnit) + 2 * Padding;
+
+            if (x + w > Size)
+            {
+                x = 0.0f;
+                y += ShelfHeight;
+                ShelfHeight = 0.0f;
+            }
+
+            if (w > Size || y + h > Size)
+            {
+                Fits = false;
+                break;
+            }
+
+            for (unsigned int c = 0; c < 3; c++)
+            {
+                UVs[Order[i] * 3 + c] = Vector2f((x + Padding + ch.Corners[c].x * TexelsPerUnit) / Size,
+                                                 (y + Padding + ch.Corners[c].y * TexelsPerUnit) / Size);
+            }
+
+            x += w;
+            ShelfHeight = fmaxf(ShelfHeight, h);
+        }
+
+        if (Fits) return true;
+    }
+
+    return false;
+}
+
+#endif	/* LIGHTMAP_UV_H */
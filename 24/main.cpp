@@ -1,4 +1,5 @@
 #include <math.h>
+#include <vector>
 #include <GL/glew.h>
 #include <GL/freeglut.h>
 
@@ -10,24 +11,118 @@
 #include "util.h"
 #include "mesh.h"
 #include "shadow_map_fbo.h"
-#include "shadow_map_technique.h"
+#include "depth_technique.h"
+#include "cascaded_shadow_map_fbo.h"
+#include "shadow_cascades.h"
+#include "shadow_atlas.h"
+#include "uniform_buffer.h"
+#include "point_shadow_map_fbo.h"
+#include "point_shadow_technique.h"
+#include "shadow_moments_fbo.h"
+#include "shadow_blur_technique.h"
+#include "shadow_reproject_technique.h"
+#include "shadow_scheduler.h"
+#include "spot_frustum.h"
+#include "lightmap_baker.h"
 
 const int WINDOW_WIDTH = 1280;
 const int WINDOW_HEIGHT = 1024;
 
+// Shadow map resolution is chosen per deployment, not derived from the window.
+// The map is an atlas shared by all spot lights. It stays this large although the
+// projections are fitted to the visible part of the scene: the static casters are
+// cached over the whole cone and only resampled into the fitted tiles.
+const unsigned int SHADOW_MAP_SIZE = 4096;
+const unsigned int MIN_SHADOW_MAP_SIZE = 256;
+const unsigned int MAX_SHADOW_MAP_SIZE = 8192;
+const unsigned int MIN_SHADOW_TILE_SIZE = 256;
+
+// The VSM/EVSM moments are kept at a fraction of the atlas resolution since
+// they are blurred anyway
+const unsigned int SHADOW_MOMENTS_DIVISOR = 2;
+
+// Radius used to estimate the screen coverage of a spot light
+const float SPOT_LIGHT_RANGE = 50.0f;
+
+// Slope-scaled depth bias applied while rendering the shadow casters
+const float SHADOW_SLOPE_BIAS = 2.0f;
+const float SHADOW_CONSTANT_BIAS = 4.0f;
+
+// Every cascade of the directional light gets a layer of this size
+const unsigned int CASCADE_SHADOW_MAP_SIZE = 2048;
+
+// Cube shadow map of the point light
+const unsigned int POINT_SHADOW_MAP_SIZE = 1024;
+const float POINT_SHADOW_NEAR = 0.1f;
+const float POINT_SHADOW_FAR = 50.0f;
+const float POINT_SHADOW_SLOPE_BIAS = 2.0f;
+const float POINT_SHADOW_CONSTANT_BIAS = 0.001f;
+
+// Shadow texels that may be rendered per frame; the scheduler spreads the
+// remaining updates over the next frames
+const unsigned long long SHADOW_TEXEL_BUDGET = 8ull * 1024 * 1024;
+const unsigned int MAX_SHADOW_UPDATE_INTERVAL = 8;
+
+// Number of cube maps rendered per mode by the 'b' benchmark
+const unsigned int POINT_SHADOW_BENCHMARK_PASSES = 100;
+
+// Number of lighting passes rendered per kernel by the 'K' benchmark
+const unsigned int SHADOW_KERNEL_BENCHMARK_PASSES = 100;
+
+// The directional light of the static casters is baked into the ground at startup
+const unsigned int LIGHTMAP_SIZE = 256;
+
+// Static casters are drawn into the cached depth of the spot light shadow map
+// only when it is invalidated, dynamic casters are drawn on top every frame
+struct ShadowCaster
+{
+    Mesh* pMesh;
+    Vector3f Scale;
+    Vector3f Rotate;
+    Vector3f WorldPos;
+    bool Static;
+};
+
 class Main : public ICallbacks
 {
 private:
 
     LightingTechnique* pLightingEffect;
-    ShadowMapTechnique* pShadowMapEffect;
+    DepthTechnique* pShadowMapEffect;
     Camera* pGameCamera;
     float scale;
-    SpotLight spotLight;
+    SpotLight spotLights[MAX_SPOT_LIGHTS];
+    float spotShadowImportance[MAX_SPOT_LIGHTS];
+    DirectionalLight dirLight;
+    PointLight pointLight;
+    PointShadowMapFBO pointShadowMapFBO;
+    PointShadowTechnique* pPointShadowEffects[POINT_SHADOW_MODE_COUNT];
+    PointShadowTechnique* pPointShadowEffect;
+    ShadowScheduler shadowScheduler;
+    unsigned int spotShadowIds[MAX_SPOT_LIGHTS];
+    unsigned int pointShadowId;
+    Matrix4f spotLightVP[MAX_SPOT_LIGHTS];
+    Matrix4f staticSpotLightVP[MAX_SPOT_LIGHTS];
+    SpotShadowFrustum spotFrustums[MAX_SPOT_LIGHTS];
+    Vector3f lastSpotLightPos[MAX_SPOT_LIGHTS];
+    Vector3f lastPointLightPos;
     Mesh* pMesh;
     Mesh* pQuad;
     ShadowMapFBO shadowMapFBO;
+    ShadowAtlas shadowAtlas;
+    SpotShadowsBlock spotShadows;
+    UniformBuffer spotShadowsUBO;
+    CascadedShadowMapFBO cascadeShadowMapFBO;
+    ShadowCascades cascades;
     Texture* pGroundTex;
+    ShadowKernel shadowKernel;
+    ShadowFilter shadowFilter;
+    ShadowMomentsFBO shadowMomentsFBO;
+    ShadowBlurTechnique* pShadowBlurEffect;
+    ShadowReprojectTechnique* pShadowReprojectEffect;
+    std::vector<ShadowCaster> shadowCasters;
+    LightmapTexture groundLightmap;
+    bool lightmapEnabled;
 
 public:
 
@@ -40,20 +135,77 @@ public:
         pQuad = nullptr;
         scale = 0.0f;
         pGroundTex = nullptr;
+        shadowKernel = SHADOW_KERNEL_2X2;
+        shadowFilter = SHADOW_FILTER_PCF;
+        pShadowBlurEffect = nullptr;
+        pShadowReprojectEffect = nullptr;
+        lightmapEnabled = true;
+
+        spotLights[0].AmbientIntensity = 0.9f;
+        spotLights[0].DiffuseIntensity = 0.9f;
+        spotLights[0].Color = Vector3f(1.0f, 1.0f, 1.0f);
+        spotLights[0].Attenuation.Linear = 0.01f;
+        spotLights[0].Position = Vector3f(-20.0, 20.0, 0.0f);
+        spotLights[0].Direction = Vector3f(1.0f, -1.0f, 0.0f);
+        spotLights[0].Cutoff = 20.0f;
+        spotShadowImportance[0] = 1.0f;
+
+        spotLights[1].AmbientIntensity = 0.0f;
+        spotLights[1].DiffuseIntensity = 0.6f;
+        spotLights[1].Color = Vector3f(1.0f, 0.8f, 0.6f);
+        spotLights[1].Attenuation.Linear = 0.01f;
+        spotLights[1].Position = Vector3f(20.0, 20.0, 10.0f);
+        spotLights[1].Direction = Vector3f(-1.0f, -1.0f, -0.5f);
+        spotLights[1].Cutoff = 20.0f;
+        spotShadowImportance[1] = 0.5f;
+
+        dirLight.AmbientIntensity = 0.1f;
+        dirLight.DiffuseIntensity = 0.5f;
+        dirLight.Color = Vector3f(1.0f, 1.0f, 1.0f);
+        dirLight.Direction = Vector3f(0.5f, -1.0f, 0.5f);
+
+        pointLight.DiffuseIntensity = 0.8f;
+        pointLight.Color = Vector3f(0.4f, 0.6f, 1.0f);
+        pointLight.Attenuation.Linear = 0.1f;
+        pointLight.Position = Vector3f(3.0f, 4.0f, 1.0f);
+
+        for (unsigned int i = 0; i < POINT_SHADOW_MODE_COUNT; i++)
+        {
+            pPointShadowEffects[i] = nullptr;
+        }
+        pPointShadowEffect = nullptr;
 
-        spotLight.AmbientIntensity = 0.9f;
-        spotLight.DiffuseIntensity = 0.9f;
-        spotLight.Color = Vector3f(1.0f, 1.0f, 1.0f);
-        spotLight.Attenuation.Linear = 0.01f;
-        spotLight.Position = Vector3f(-20.0, 20.0, 0.0f);
-        spotLight.Direction = Vector3f(1.0f, -1.0f, 0.0f);
-        spotLight.Cutoff = 20.0f;
+        for (unsigned int i = 0; i < MAX_SPOT_LIGHTS; i++)
+        {
+            spotShadowIds[i] = shadowScheduler.AddLight();
+            lastSpotLightPos[i] = spotLights[i].Position;
+
+            // uploaded before every light has a tile
+            for (unsigned int j = 0; j < 4; j++)
+            {
+                spotShadows.LightVP[i].m[j][0] = spotShadows.LightVP[i].m[j][1] = 0.0f;
+                spotShadows.LightVP[i].m[j][2] = spotShadows.LightVP[i].m[j][3] = 0.0f;
+                spotShadows.Rect[i][j] = 0.0f;
+            }
+        }
+        pointShadowId = shadowScheduler.AddLight();
+        lastPointLightPos = pointLight.Position;
+
+        shadowScheduler.SetTexelBudget(SHADOW_TEXEL_BUDGET);
+        shadowScheduler.SetLimits(MAX_SHADOW_UPDATE_INTERVAL, SPOT_LIGHT_RANGE);
+
+        cascades.SetSplits(NUM_CASCADES, 0.75f);
+        cascades.SetPerspectiveProj(60.0f, WINDOW_WIDTH, WINDOW_HEIGHT, 1.0f, 50.0f);
     }
 
     virtual ~Main()
     {
         SAFE_DELETE(pLightingEffect);
         SAFE_DELETE(pShadowMapEffect);
+        SAFE_DELETE(pShadowBlurEffect);
+        SAFE_DELETE(pShadowReprojectEffect);
+        for (unsigned int i = 0; i < POINT_SHADOW_MODE_COUNT; i++)
+            SAFE_DELETE(pPointShadowEffects[i]);
         SAFE_DELETE(pGameCamera);
         SAFE_DELETE(pMesh);
         SAFE_DELETE(pQuad);
@@ -62,7 +214,20 @@ public:
 
     bool Init()
     {
-        if (!shadowMapFBO.Init(WINDOW_WIDTH, WINDOW_HEIGHT)) return false;
+        if (!shadowMapFBO.Init(SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, SHADOW_MAP_DEPTH24)) return false;
+        if (!cascadeShadowMapFBO.Init(CASCADE_SHADOW_MAP_SIZE, NUM_CASCADES)) return false;
+        if (!shadowMomentsFBO.Init(SHADOW_MAP_SIZE / SHADOW_MOMENTS_DIVISOR, SHADOW_MAP_SIZE / SHADOW_MOMENTS_DIVISOR)) return false;
+        if (!pointShadowMapFBO.Init(POINT_SHADOW_MAP_SIZE)) return false;
+        if (!spotShadowsUBO.Init(SPOT_SHADOWS_UBO_BINDING, sizeof(spotShadows))) return false;
+
+        shadowAtlas.SetSize(SHADOW_MAP_SIZE);
+        shadowAtlas.SetMinTileSize(MIN_SHADOW_TILE_SIZE);
+
+        if (!CheckShadowAtlas())
+        {
+            printf("Error: the shadow atlas leaves a spot light without a tile\n");
+            return false;
+        }
 
         pGameCamera = new Camera(WINDOW_WIDTH, WINDOW_HEIGHT);
 
@@ -73,11 +238,21 @@ public:
             return false;
         }
         pLightingEffect->Enable();
-        pLightingEffect->SetSpotLights(1, &spotLight);
+        pLightingEffect->SetDirectionalLight(dirLight);
+        pLightingEffect->SetPointLights(1, &pointLight);
+        pLightingEffect->SetPointShadowLight(0, POINT_SHADOW_FAR);
+        pLightingEffect->SetSpotLights(MAX_SPOT_LIGHTS, spotLights);
         pLightingEffect->SetTextureUnit(0);
         pLightingEffect->SetShadowMapTextureUnit(1);
-
-        pShadowMapEffect = new ShadowMapTechnique();
+        pLightingEffect->SetCascadeShadowMapTextureUnit(2);
+        pLightingEffect->SetPointShadowMapTextureUnit(3);
+        pLightingEffect->SetShadowMomentsTextureUnit(4);
+        pLightingEffect->SetLightmapTextureUnit(5);
+        pLightingEffect->SetShadowFilter(shadowFilter);
+        pLightingEffect->SetShadowKernel(shadowKernel);
+        pLightingEffect->SetShadowMapSize(shadowMapFBO.GetWidth(), shadowMapFBO.GetHeight());
+
+        pShadowMapEffect = new DepthTechnique();
         if (!pShadowMapEffect->Init())
         {
             printf("Error initializing the shadow map technique\n");
@@ -85,6 +260,40 @@ public:
         }
         pShadowMapEffect->Enable();
 
+        pShadowBlurEffect = new ShadowBlurTechnique();
+        if (!pShadowBlurEffect->Init())
+        {
+            printf("Error initializing the shadow blur technique\n");
+            return false;
+        }
+        pShadowBlurEffect->Enable();
+        pShadowBlurEffect->SetSourceTextureUnit(0);
+
+        pShadowReprojectEffect = new ShadowReprojectTechnique();
+        if (!pShadowReprojectEffect->Init())
+        {
+            printf("Error initializing the shadow reproject technique\n");
+            return false;
+        }
+        pShadowReprojectEffect->Enable();
+        pShadowReprojectEffect->SetStaticTextureUnit(0);
+
+        // the six pass path is kept only as a reference for the benchmark
+        for (unsigned int i = 0; i < POINT_SHADOW_MODE_COUNT; i++)
+        {
+            if (!PointShadowTechnique::IsSupported((PointShadowMode)i)) continue;
+
+            pPointShadowEffects[i] = new PointShadowTechnique();
+            if (!pPointShadowEffects[i]->Init((PointShadowMode)i))
+            {
+                printf("Error initializing the point shadow technique %u\n", i);
+                return false;
+            }
+        }
+
+        pPointShadowEffect = pPointShadowEffects[POINT_SHADOW_VERTEX_LAYER] ?
+            pPointShadowEffects[POINT_SHADOW_VERTEX_LAYER] : pPointShadowEffects[POINT_SHADOW_GEOMETRY_SHADER];
+
         pQuad = new Mesh();
         if (!pQuad->LoadMesh("C:/Content/quad.obj")) return false;
 
@@ -92,7 +301,60 @@ public:
         if (!pGroundTex->Load()) return false;
 
         pMesh = new Mesh();
-        return pMesh->LoadMesh("C:/Content/phoenix_ugv.md2");
+        if (!pMesh->LoadMesh("C:/Content/phoenix_ugv.md2")) return false;
+
+        ShadowCaster Ground = { pQuad, Vector3f(10.0f, 10.0f, 10.0f), Vector3f(90.0f, 0.0f, 0.0f),
+            Vector3f(0.0f, 0.0f, 1.0f), true };
+        ShadowCaster Vehicle = { pMesh, Vector3f(0.1f, 0.1f, 0.1f), Vector3f(0.0f, 0.0f, 0.0f),
+            Vector3f(0.0f, 0.0f, 3.0f), false };
+        ShadowCaster ParkedVehicle = { pMesh, Vector3f(0.1f, 0.1f, 0.1f), Vector3f(0.0f, 60.0f, 0.0f),
+            Vector3f(-4.0f, 0.0f, 8.0f), true };
+        shadowCasters.push_back(Ground);
+        shadowCasters.push_back(Vehicle);
+        shadowCasters.push_back(ParkedVehicle);
+
+        if (!pQuad->InitLightmapUVs(LIGHTMAP_SIZE)) return false;
+
+        return BakeLightmaps();
+    }
+
+    // Ray casts the directional light against all the static casters into the
+    // lightmap of the ground
+    bool BakeLightmaps()
+    {
+        LightmapBaker Baker;
+        Baker.SetSize(LIGHTMAP_SIZE);
+        Baker.SetDirectionalLight(dirLight);
+
+        Pipeline p;
+        std::vector<Vector3f> Triangles;
+
+        for (unsigned int i = 0; i < shadowCasters.size(); i++)
+        {
+            const ShadowCaster& Caster = shadowCasters[i];
+
+            if (!Caster.Static) continue;
+
+            p.Scale(Caster.Scale.x, Caster.Scale.y, Caster.Scale.z);
+            p.Rotate(Caster.Rotate.x, Caster.Rotate.y, Caster.Rotate.z);
+            p.WorldPos(Caster.WorldPos.x, Caster.WorldPos.y, Caster.WorldPos.z);
+            Caster.pMesh->GetTriangles(p.GetWorldTrans(), Triangles);
+        }
+
+        Baker.AddOccluders(Triangles);
+
+        const ShadowCaster& Ground = shadowCasters[0];
+        p.Scale(Ground.Scale.x, Ground.Scale.y, Ground.Scale.z);
+        p.Rotate(Ground.Rotate.x, Ground.Rotate.y, Ground.Rotate.z);
+        p.WorldPos(Ground.WorldPos.x, Ground.WorldPos.y, Ground.WorldPos.z);
+
+        std::vector<float> Texels;
+        const double Time = Baker.Bake(pQuad->GetLightmapVertices(), p.GetWorldTrans(), Texels);
+
+        printf("Baked a %ux%u lightmap against %zu triangles in %.1f ms on %u threads\n", LIGHTMAP_SIZE,
+            LIGHTMAP_SIZE, Triangles.size() / 3, Time, Baker.GetNumThreads());
+
+        return groundLightmap.Init(LIGHTMAP_SIZE, Texels);
     }
 
     void Run()
@@ -104,8 +366,18 @@ public:
     {
         pGameCamera->OnRender();
         scale += 0.1f;
+        shadowCasters[1].Rotate.y = scale;
 
+        UpdateSpotShadows();
+        ScheduleShadowUpdates();
         ShadowMapPass();
+        CascadeShadowPass();
+
+        if (shadowScheduler.ShouldUpdate(pointShadowId))
+        {
+            PointShadowPass(pPointShadowEffect);
+        }
+
         RenderPass();
 
         glutSwapBuffers();
@@ -115,20 +387,430 @@ public:
     {
         shadowMapFBO.BindForWriting();
 
-        glClear(GL_DEPTH_BUFFER_BIT);
+        // Only depth is produced - mask color writes and push the stored depth away
+        // from the light in proportion to the slope instead of biasing in the shader
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(SHADOW_SLOPE_BIAS, SHADOW_CONSTANT_BIAS);
 
         pShadowMapEffect->Enable();
 
+        if (shadowMapFBO.NeedsStaticUpdate())
+        {
+            shadowMapFBO.BeginStaticUpdate();
+            RenderSpotShadowTiles(true);
+            shadowMapFBO.EndStaticUpdate();
+        }
+
+        RenderSpotShadowTiles(false);
+        spotShadowsUBO.Update(&spotShadows, sizeof(spotShadows));
+
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+        shadowMapFBO.UnbindForWriting();
+
+        if (shadowFilter != SHADOW_FILTER_PCF)
+        {
+            ShadowMomentsPass();
+        }
+    }
+
+    // Separable blur of every atlas tile into the moments texture, so the
+    // filtering cost depends on the shadow map resolution, not on the screen
+    void ShadowMomentsPass()
+    {
+        GLint Viewport[4];
+        glGetIntegerv(GL_VIEWPORT, Viewport);
+
+        glDisable(GL_DEPTH_TEST);
+
+        pShadowBlurEffect->Enable();
+        pShadowBlurEffect->SetExponential(shadowFilter == SHADOW_FILTER_EVSM);
+        pShadowBlurEffect->SetTargetSize(shadowMomentsFBO.GetWidth(), shadowMomentsFBO.GetHeight());
+
+        // horizontal: atlas depth -> scratch moments
+        shadowMomentsFBO.BindForWriting(ShadowMomentsFBO::SCRATCH);
+        shadowMapFBO.BindForReading(GL_TEXTURE0);
+        shadowMomentsFBO.BindDepthSampler(0);
+        pShadowBlurEffect->SetPass(true);
+        BlurShadowTiles();
+        shadowMomentsFBO.UnbindDepthSampler(0);
+
+        // vertical: scratch -> moments
+        shadowMomentsFBO.BindForWriting(ShadowMomentsFBO::MOMENTS);
+        shadowMomentsFBO.BindForReading(ShadowMomentsFBO::SCRATCH, 0);
+        pShadowBlurEffect->SetPass(false);
+        BlurShadowTiles();
+
+        shadowMomentsFBO.UnbindForWriting();
+        shadowMomentsFBO.GenerateMipmaps();
+
+        glEnable(GL_DEPTH_TEST);
+        glViewport(Viewport[0], Viewport[1], Viewport[2], Viewport[3]);
+    }
+
+    void BlurShadowTiles()
+    {
+        for (unsigned int i = 0; i < MAX_SPOT_LIGHTS; i++)
+        {
+            const ShadowAtlasTile& Tile = shadowAtlas.GetTile(i);
+
+            if (Tile.Size == 0 || !shadowScheduler.ShouldUpdate(spotShadowIds[i])) continue;
+
+            glViewport(Tile.x / SHADOW_MOMENTS_DIVISOR, Tile.y / SHADOW_MOMENTS_DIVISOR,
+                Tile.Size / SHADOW_MOMENTS_DIVISOR, Tile.Size / SHADOW_MOMENTS_DIVISOR);
+            pShadowBlurEffect->SetTileRect(spotShadows.Rect[i]);
+            pShadowBlurEffect->Draw();
+        }
+    }
+
+    // Two lights of different importance, both close enough to ask for at
+    // least the whole atlas, must still get a tile each
+    static bool CheckShadowAtlas()
+    {
+        ShadowAtlas Atlas;
+        Atlas.SetSize(SHADOW_MAP_SIZE);
+        Atlas.SetMinTileSize(MIN_SHADOW_TILE_SIZE);
+
+        const float Importance[2] = { 1.0f, 0.5f };
+        Atlas.Allocate(2, Importance);
+
+        return Atlas.GetTile(0).Size >= MIN_SHADOW_TILE_SIZE && Atlas.GetTile(1).Size >= MIN_SHADOW_TILE_SIZE &&
+            Atlas.GetTile(0).Size >= Atlas.GetTile(1).Size;
+    }
+
+    // Sizes the atlas tiles by the screen coverage of every light and uploads the
+    // light matrices and tile rectangles for the lighting pass
+    void UpdateSpotShadows()
+    {
+        const float TanHalfFOV = tanf(glm::radians(30.0f));
+        float Importance[MAX_SPOT_LIGHTS];
+
+        for (unsigned int i = 0; i < MAX_SPOT_LIGHTS; i++)
+        {
+            Importance[i] = spotShadowImportance[i] * ShadowAtlas::CalcScreenCoverage(spotLights[i].Position,
+                SPOT_LIGHT_RANGE, pGameCamera->GetPos(), TanHalfFOV);
+        }
+
+        if (shadowAtlas.Allocate(MAX_SPOT_LIGHTS, Importance))
+        {
+            shadowMapFBO.InvalidateStatic();
+        }
+
+        std::vector<BoundingBox> CasterBounds(shadowCasters.size());
+        Pipeline World;
+
+        for (unsigned int i = 0; i < shadowCasters.size(); i++)
+        {
+            const ShadowCaster& Caster = shadowCasters[i];
+            World.Scale(Caster.Scale.x, Caster.Scale.y, Caster.Scale.z);
+            World.Rotate(Caster.Rotate.x, Caster.Rotate.y, Caster.Rotate.z);
+            World.WorldPos(Caster.WorldPos.x, Caster.WorldPos.y, Caster.WorldPos.z);
+            CasterBounds[i] = Caster.pMesh->GetBounds().Transform(World.GetWorldTrans());
+        }
+
+        Vector3f CameraCorners[8];
+        GetFrustumCorners(pGameCamera->GetPos(), pGameCamera->GetTarget(), pGameCamera->GetUp(),
+            60.0f, WINDOW_WIDTH, WINDOW_HEIGHT, 1.0f, 50.0f, CameraCorners);
+
+        bool Moved = false;
+
+        for (unsigned int i = 0; i < MAX_SPOT_LIGHTS; i++)
+        {
+            spotFrustums[i] = FitSpotShadowFrustum(spotLights[i].Position, spotLights[i].Direction,
+                spotLights[i].Cutoff, SPOT_LIGHT_RANGE, &CasterBounds[0],
+                (unsigned int)CasterBounds.size(), CameraCorners);
+
+            Pipeline p;
+            p.SetCamera(spotLights[i].Position, spotLights[i].Direction, Vector3f(0.0f, 1.0f, 0.0f));
+            p.SetPerspectiveProj(spotFrustums[i].FOV, 1.0f, 1.0f, spotFrustums[i].zNear, spotFrustums[i].zFar);
+            spotLightVP[i] = p.GetWVPTrans();
+
+            // the static casters use the whole cone, which doesn't follow the camera
+            const SpotShadowFrustum Cone = GetSpotConeFrustum(spotLights[i].Cutoff, SPOT_LIGHT_RANGE);
+            p.SetPerspectiveProj(Cone.FOV, 1.0f, 1.0f, Cone.zNear, Cone.zFar);
+            const Matrix4f& StaticVP = p.GetWVPTrans();
+
+            Moved = Moved || memcmp(&StaticVP, &staticSpotLightVP[i], sizeof(StaticVP)) != 0;
+            staticSpotLightVP[i] = StaticVP;
+        }
+
+        // the cached static depth was rendered from where the lights were before
+        if (Moved)
+        {
+            shadowMapFBO.InvalidateStatic();
+        }
+    }
+
+    // Picks the shadow maps rendered this frame. A rebuilt static cache or a new
+    // atlas layout makes every spot light tile invalid.
+    void ScheduleShadowUpdates()
+    {
+        const float TanHalfFOV = tanf(glm::radians(30.0f));
+        const Vector3f EyePos = pGameCamera->GetPos();
+
+        for (unsigned int i = 0; i < MAX_SPOT_LIGHTS; i++)
+        {
+            const ShadowAtlasTile& Tile = shadowAtlas.GetTile(i);
+            const Vector3f Delta = spotLights[i].Position - EyePos;
+            const Vector3f Motion = spotLights[i].Position - lastSpotLightPos[i];
+
+            if (shadowMapFBO.NeedsStaticUpdate()) shadowScheduler.Invalidate(spotShadowIds[i]);
+
+            shadowScheduler.SetLightState(spotShadowIds[i], sqrtf(Delta.x * Delta.x + Delta.y * Delta.y + Delta.z * Delta.z),
+                ShadowAtlas::CalcScreenCoverage(spotLights[i].Position, SPOT_LIGHT_RANGE, EyePos, TanHalfFOV),
+                Motion.x != 0.0f || Motion.y != 0.0f || Motion.z != 0.0f,
+                (unsigned long long)Tile.Size * Tile.Size);
+            lastSpotLightPos[i] = spotLights[i].Position;
+        }
+
+        const Vector3f Delta = pointLight.Position - EyePos;
+        const Vector3f Motion = pointLight.Position - lastPointLightPos;
+        shadowScheduler.SetLightState(pointShadowId, sqrtf(Delta.x * Delta.x + Delta.y * Delta.y + Delta.z * Delta.z),
+            ShadowAtlas::CalcScreenCoverage(pointLight.Position, POINT_SHADOW_FAR, EyePos, TanHalfFOV),
+            Motion.x != 0.0f || Motion.y != 0.0f || Motion.z != 0.0f,
+            6ull * pointShadowMapFBO.GetSize() * pointShadowMapFBO.GetSize());
+        lastPointLightPos = pointLight.Position;
+
+        shadowScheduler.Schedule();
+    }
+
+    // Every light renders into its own tile; the FBO is bound once for all of
+    // them. Only the tiles scheduled for this frame are touched. The static
+    // casters are rendered over the whole cone, so the cache survives the
+    // fitted projection following the camera, and are reprojected into the
+    // fitted one before the dynamic casters are drawn on top.
+    void RenderSpotShadowTiles(bool Static)
+    {
+        if (!Static)
+        {
+            shadowMapFBO.BindStaticForReading(GL_TEXTURE0);
+        }
+
+        for (unsigned int i = 0; i < MAX_SPOT_LIGHTS; i++)
+        {
+            const ShadowAtlasTile& Tile = shadowAtlas.GetTile(i);
+
+            // an empty rect makes the lighting pass skip the light, instead of
+            // sampling the tile it had before, which may belong to another light
+            if (Tile.Size == 0)
+            {
+                shadowAtlas.GetTileRect(i, spotShadows.Rect[i]);
+                continue;
+            }
+
+            if (!shadowScheduler.ShouldUpdate(spotShadowIds[i])) continue;
+
+            glViewport(Tile.x, Tile.y, Tile.Size, Tile.Size);
+
+            if (Static)
+            {
+                RenderShadowCasters(staticSpotLightVP[i], true);
+                continue;
+            }
+
+            shadowAtlas.GetTileRect(i, spotShadows.Rect[i]);
+            ReprojectStaticDepth(i);
+
+            pShadowMapEffect->Enable();
+            RenderShadowCasters(spotLightVP[i], false);
+
+            // the lighting pass keeps using the matrix the tile was rendered with
+            spotShadows.LightVP[i] = spotLightVP[i];
+        }
+    }
+
+    // Overwrites the whole tile, whatever depth it held before
+    void ReprojectStaticDepth(unsigned int Light)
+    {
+        glDepthFunc(GL_ALWAYS);
+
+        pShadowReprojectEffect->Enable();
+        pShadowReprojectEffect->SetTargetSize(shadowMapFBO.GetWidth(), shadowMapFBO.GetHeight());
+        pShadowReprojectEffect->SetTileRect(spotShadows.Rect[Light]);
+        pShadowReprojectEffect->SetProjections(GetSpotConeFrustum(spotLights[Light].Cutoff, SPOT_LIGHT_RANGE),
+            spotFrustums[Light]);
+        pShadowReprojectEffect->Draw();
+
+        glDepthFunc(GL_LESS);
+    }
+
+    void RenderShadowCasters(const Matrix4f& LightVP, bool Static)
+    {
         Pipeline p;
-        p.Scale(0.2f, 0.2f, 0.2f);
-        p.Rotate(0.0f, scale, 0.0f);
-        p.WorldPos(0.0f, 0.0f, 5.0f);
-        p.SetCamera(spotLight.Position, spotLight.Direction, Vector3f(0.0f, 1.0f, 0.0f));
-        p.SetPerspectiveProj(60.0f, WINDOW_WIDTH, WINDOW_HEIGHT, 1.0f, 50.0f);
-        pShadowMapEffect->SetWVP(p.GetWVPTrans());
-        pMesh->Render();
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        for (unsigned int i = 0; i < shadowCasters.size(); i++)
+        {
+            const ShadowCaster& Caster = shadowCasters[i];
+
+            if (Caster.Static != Static) continue;
+
+            p.Scale(Caster.Scale.x, Caster.Scale.y, Caster.Scale.z);
+            p.Rotate(Caster.Rotate.x, Caster.Rotate.y, Caster.Rotate.z);
+            p.WorldPos(Caster.WorldPos.x, Caster.WorldPos.y, Caster.WorldPos.z);
+            pShadowMapEffect->SetWVP(LightVP * p.GetWorldTrans());
+            Caster.pMesh->RenderDepth();
+        }
+    }
+
+    // Fills all six faces of the point light cube map with the given technique
+    void PointShadowPass(PointShadowTechnique* pEffect)
+    {
+        Matrix4f FaceVP[6];
+        PointShadowMapFBO::InitFaceTransforms(pointLight.Position, POINT_SHADOW_NEAR, POINT_SHADOW_FAR, FaceVP);
+
+        // the cube faces are mirrored, so culling would drop the front faces
+        glDisable(GL_CULL_FACE);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+        pEffect->Enable();
+        pEffect->SetFaceTransforms(FaceVP);
+        pEffect->SetLight(pointLight.Position, POINT_SHADOW_FAR);
+        pEffect->SetDepthBias(POINT_SHADOW_SLOPE_BIAS, POINT_SHADOW_CONSTANT_BIAS);
+
+        pointShadowMapFBO.BindForWriting();
+
+        if (pEffect->GetMode() == POINT_SHADOW_SIX_PASS)
+        {
+            for (unsigned int Face = 0; Face < 6; Face++)
+            {
+                pointShadowMapFBO.BindFaceForWriting(Face);
+                glClear(GL_DEPTH_BUFFER_BIT);
+                pEffect->SetFace(Face);
+                RenderPointShadowCasters(pEffect, 1);
+            }
+        }
+        else
+        {
+            glClear(GL_DEPTH_BUFFER_BIT);
+            RenderPointShadowCasters(pEffect, pEffect->GetMode() == POINT_SHADOW_VERTEX_LAYER ? 6 : 1);
+        }
+
+        pointShadowMapFBO.UnbindForWriting();
+
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glEnable(GL_CULL_FACE);
+    }
+
+    void RenderPointShadowCasters(PointShadowTechnique* pEffect, unsigned int NumInstances)
+    {
+        Pipeline p;
+
+        for (unsigned int i = 0; i < shadowCasters.size(); i++)
+        {
+            const ShadowCaster& Caster = shadowCasters[i];
+
+            p.Scale(Caster.Scale.x, Caster.Scale.y, Caster.Scale.z);
+            p.Rotate(Caster.Rotate.x, Caster.Rotate.y, Caster.Rotate.z);
+            p.WorldPos(Caster.WorldPos.x, Caster.WorldPos.y, Caster.WorldPos.z);
+            pEffect->SetWorldMatrix(p.GetWorldTrans());
+            Caster.pMesh->RenderDepth(NumInstances);
+        }
+    }
+
+    // GPU time of the single pass paths against rendering the faces one by one
+    void BenchmarkPointShadows()
+    {
+        static const char* ModeNames[] = { "geometry shader", "vertex layer", "six passes" };
+
+        GLuint Query;
+        glGenQueries(1, &Query);
+
+        for (unsigned int i = 0; i < POINT_SHADOW_MODE_COUNT; i++)
+        {
+            if (!pPointShadowEffects[i])
+            {
+                printf("%-16s not supported\n", ModeNames[i]);
+                continue;
+            }
+
+            glBeginQuery(GL_TIME_ELAPSED, Query);
+
+            for (unsigned int j = 0; j < POINT_SHADOW_BENCHMARK_PASSES; j++)
+            {
+                PointShadowPass(pPointShadowEffects[i]);
+            }
+
+            glEndQuery(GL_TIME_ELAPSED);
+
+            GLuint64 Time = 0;
+            glGetQueryObjectui64v(Query, GL_QUERY_RESULT, &Time);
+            printf("%-16s %.3f ms per cube map\n", ModeNames[i], Time / 1000000.0 / POINT_SHADOW_BENCHMARK_PASSES);
+        }
+
+        glDeleteQueries(1, &Query);
+    }
+
+    // GPU time of the lighting pass with every PCF kernel, the shadow maps are
+    // left as they are
+    void BenchmarkShadowKernels()
+    {
+        static const char* KernelNames[] = { "1 tap", "2x2 bilinear", "Poisson 4", "Poisson 8", "Poisson 16" };
+
+        if (shadowFilter != SHADOW_FILTER_PCF)
+        {
+            printf("The kernels are only used by PCF, press 'v' to switch to it\n");
+            return;
+        }
+
+        GLuint Query;
+        glGenQueries(1, &Query);
+
+        for (unsigned int i = 0; i < SHADOW_KERNEL_COUNT; i++)
+        {
+            pLightingEffect->Enable();
+            pLightingEffect->SetShadowKernel((ShadowKernel)i);
+
+            glBeginQuery(GL_TIME_ELAPSED, Query);
+
+            for (unsigned int j = 0; j < SHADOW_KERNEL_BENCHMARK_PASSES; j++)
+            {
+                RenderPass();
+            }
+
+            glEndQuery(GL_TIME_ELAPSED);
+
+            GLuint64 Time = 0;
+            glGetQueryObjectui64v(Query, GL_QUERY_RESULT, &Time);
+            printf("%-16s %.3f ms per lighting pass\n", KernelNames[i], Time / 1000000.0 / SHADOW_KERNEL_BENCHMARK_PASSES);
+        }
+
+        glDeleteQueries(1, &Query);
+
+        pLightingEffect->Enable();
+        pLightingEffect->SetShadowKernel(shadowKernel);
+    }
+
+    // One depth pass per cascade, each with the orthographic projection fitted
+    // around its slice of the camera frustum
+    virtual void CascadeShadowPass()
+    {
+        cascades.SetCamera(pGameCamera->GetPos(), pGameCamera->GetTarget(), pGameCamera->GetUp());
+        cascades.Update(dirLight.Direction, cascadeShadowMapFBO.GetSize());
+
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(SHADOW_SLOPE_BIAS, SHADOW_CONSTANT_BIAS);
+
+        pShadowMapEffect->Enable();
+
+        for (unsigned int i = 0; i < cascades.GetNumCascades(); i++)
+        {
+            cascadeShadowMapFBO.BindForWriting(i);
+            glClear(GL_DEPTH_BUFFER_BIT);
+
+            // the static casters are drawn with the lightmap on as well, the baked
+            // shadow only falls on the static geometry and the lighting pass takes
+            // the min of the two
+            RenderShadowCasters(cascades.GetLightVP(i), true);
+            RenderShadowCasters(cascades.GetLightVP(i), false);
+        }
+
+        cascadeShadowMapFBO.UnbindForWriting();
+
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
     }
 
     virtual void RenderPass()
@@ -138,6 +820,20 @@ public:
         pLightingEffect->Enable();
 
         shadowMapFBO.BindForReading(GL_TEXTURE1);
+        cascadeShadowMapFBO.BindForReading(GL_TEXTURE2);
+        shadowMomentsFBO.BindForReading(ShadowMomentsFBO::MOMENTS, 4);
+        pointShadowMapFBO.BindForReading(GL_TEXTURE3);
+
+        Matrix4f CascadeLightVP[NUM_CASCADES];
+        float CascadeEnd[NUM_CASCADES];
+
+        for (unsigned int i = 0; i < NUM_CASCADES; i++)
+        {
+            CascadeLightVP[i] = cascades.GetLightVP(i);
+            CascadeEnd[i] = cascades.GetCascadeEnd(i);
+        }
+
+        pLightingEffect->SetCascades(CascadeLightVP, CascadeEnd);
 
         Pipeline p;
         p.SetPerspectiveProj(60.0f, WINDOW_WIDTH, WINDOW_HEIGHT, 1.0f, 50.0f);
@@ -148,22 +844,33 @@ public:
 
         pLightingEffect->SetWVP(p.GetWVPTrans());
         pLightingEffect->SetWorldMatrix(p.GetWorldTrans());
-        p.SetCamera(spotLight.Position, spotLight.Direction, Vector3f(0.0f, 1.0f, 0.0f));
-        pLightingEffect->SetLightWVP(p.GetWVPTrans());
         pLightingEffect->SetEyeWorldPos(pGameCamera->GetPos());
         pGroundTex->Bind(GL_TEXTURE0);
-        pQuad->Render();
 
-        p.Scale(0.1f, 0.1f, 0.1f);
-        p.Rotate(0.0f, scale, 0.0f);
-        p.WorldPos(0.0f, 0.0f, 3.0f);
-        p.SetCamera(pGameCamera->GetPos(), pGameCamera->GetTarget(), pGameCamera->GetUp());
-        pLightingEffect->SetWVP(p.GetWVPTrans());
-        pLightingEffect->SetWorldMatrix(p.GetWorldTrans());
-        p.SetCamera(spotLight.Position, spotLight.Direction, Vector3f(0.0f, 1.0f, 0.0f));
-        pLightingEffect->SetLightWVP(p.GetWVPTrans());
+        if (lightmapEnabled)
+        {
+            groundLightmap.Bind(GL_TEXTURE5);
+            pLightingEffect->SetLightmapEnabled(true);
+            pQuad->RenderLightmapped();
+            pLightingEffect->SetLightmapEnabled(false);
+        }
+        else
+        {
+            pQuad->Render();
+        }
 
-        pMesh->Render();
+        // the vehicles, drawn with the transforms their shadows were rendered with
+        for (unsigned int i = 1; i < shadowCasters.size(); i++)
+        {
+            const ShadowCaster& Caster = shadowCasters[i];
+            p.Scale(Caster.Scale.x, Caster.Scale.y, Caster.Scale.z);
+            p.Rotate(Caster.Rotate.x, Caster.Rotate.y, Caster.Rotate.z);
+            p.WorldPos(Caster.WorldPos.x, Caster.WorldPos.y, Caster.WorldPos.z);
+            pLightingEffect->SetWVP(p.GetWVPTrans());
+            pLightingEffect->SetWorldMatrix(p.GetWorldTrans());
+
+            Caster.pMesh->Render();
+        }
     }
 
     virtual void IdleCB()
@@ -183,6 +890,58 @@ public:
         case 'q':
             glutLeaveMainLoop();
             break;
+
+        // shadow map resolution and depth precision at runtime
+        case '+':
+            ResizeShadowMap(shadowMapFBO.GetWidth() * 2, shadowMapFBO.GetFormat());
+            break;
+
+        case '-':
+            ResizeShadowMap(shadowMapFBO.GetWidth() / 2, shadowMapFBO.GetFormat());
+            break;
+
+        case 'f':
+            ResizeShadowMap(shadowMapFBO.GetWidth(), (ShadowMapFormat)((shadowMapFBO.GetFormat() + 1) % 3));
+            break;
+
+        case 'v':
+        {
+            static const char* FilterNames[] = { "PCF", "VSM", "EVSM" };
+            shadowFilter = (ShadowFilter)((shadowFilter + 1) % SHADOW_FILTER_COUNT);
+            pLightingEffect->Enable();
+            pLightingEffect->SetShadowFilter(shadowFilter);
+            for (unsigned int i = 0; i < MAX_SPOT_LIGHTS; i++)
+                shadowScheduler.Invalidate(spotShadowIds[i]);
+            printf("Shadow filter mode: %s\n", FilterNames[shadowFilter]);
+            break;
+        }
+
+        case 't':
+            shadowScheduler.PrintStats();
+            break;
+
+        case 'b':
+            BenchmarkPointShadows();
+            break;
+
+        case 'K':
+            BenchmarkShadowKernels();
+            break;
+
+        case 'l':
+            lightmapEnabled = !lightmapEnabled;
+            printf("Baked directional light: %s\n", lightmapEnabled ? "on" : "off");
+            break;
+
+        case 'k':
+        {
+            static const char* KernelNames[] = { "1 tap", "2x2 bilinear", "Poisson 4", "Poisson 8", "Poisson 16" };
+            shadowKernel = (ShadowKernel)((shadowKernel + 1) % SHADOW_KERNEL_COUNT);
+            pLightingEffect->Enable();
+            pLightingEffect->SetShadowKernel(shadowKernel);
+            printf("Shadow filter: %s\n", KernelNames[shadowKernel]);
+            break;
+        }
         }
     }
 
@@ -190,6 +949,22 @@ public:
     {
         pGameCamera->OnMouse(x, y);
     }
+
+    void ResizeShadowMap(unsigned int Size, ShadowMapFormat Format)
+    {
+        if (Size < MIN_SHADOW_MAP_SIZE || Size > MAX_SHADOW_MAP_SIZE) return;
+
+        static const char* FormatNames[] = { "DEPTH16", "DEPTH24", "DEPTH32F" };
+
+        if (shadowMapFBO.Resize(Size, Size, Format))
+        {
+            shadowAtlas.SetSize(Size);
+            shadowMomentsFBO.Resize(Size / SHADOW_MOMENTS_DIVISOR, Size / SHADOW_MOMENTS_DIVISOR);
+            pLightingEffect->Enable();
+            pLightingEffect->SetShadowMapSize(Size, Size);
+            printf("Shadow map %ux%u %s\n", Size, Size, FormatNames[Format]);
+        }
+    }
 };
 
 
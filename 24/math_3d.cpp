@@ -113,6 +113,19 @@ void Matrix4f::InitPersProjTransform(float FOV, float Width, float Height, float
 }
 
 
+void Matrix4f::InitOrthoProjTransform(float Left, float Right, float Bottom, float Top, float zNear, float zFar)
+{
+    const float Width = Right - Left;
+    const float Height = Top - Bottom;
+    const float Depth = zFar - zNear;
+
+    m[0][0] = 2.0f / Width; m[0][1] = 0.0f;          m[0][2] = 0.0f;         m[0][3] = -(Right + Left) / Width;
+    m[1][0] = 0.0f;         m[1][1] = 2.0f / Height; m[1][2] = 0.0f;         m[1][3] = -(Top + Bottom) / Height;
+    m[2][0] = 0.0f;         m[2][1] = 0.0f;          m[2][2] = 2.0f / Depth; m[2][3] = -(zFar + zNear) / Depth;
+    m[3][0] = 0.0f;         m[3][1] = 0.0f;          m[3][2] = 0.0f;         m[3][3] = 1.0f;
+}
+
+
 Quaternion::Quaternion(float _x, float _y, float _z, float _w)
 {
     x = _x;
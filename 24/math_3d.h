@@ -3,6 +3,7 @@
 
 #include <stdio.h>
 #include <math.h>
+#include <float.h>
 
 struct Vector2i
 {
@@ -151,6 +152,74 @@ public:
     void InitTranslationTransform(float x, float y, float z);
     void InitCameraTransform(const Vector3f& Target, const Vector3f& Up);
     void InitPersProjTransform(float FOV, float Width, float Height, float zNear, float zFar);
+    void InitOrthoProjTransform(float Left, float Right, float Bottom, float Top, float zNear, float zFar);
+};
+
+
+// Axis aligned box, empty until the first point is added
+struct BoundingBox
+{
+    Vector3f Min;
+    Vector3f Max;
+
+    BoundingBox()
+    {
+        Clear();
+    }
+
+    void Clear()
+    {
+        Min = Vector3f(FLT_MAX, FLT_MAX, FLT_MAX);
+        Max = Vector3f(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    }
+
+    bool IsEmpty() const
+    {
+        return Min.x > Max.x || Min.y > Max.y || Min.z > Max.z;
+    }
+
+    void AddPoint(const Vector3f& p)
+    {
+        Min.x = fminf(Min.x, p.x); Max.x = fmaxf(Max.x, p.x);
+        Min.y = fminf(Min.y, p.y); Max.y = fmaxf(Max.y, p.y);
+        Min.z = fminf(Min.z, p.z); Max.z = fmaxf(Max.z, p.z);
+    }
+
+    void AddBox(const BoundingBox& b)
+    {
+        if (b.IsEmpty()) return;
+        AddPoint(b.Min);
+        AddPoint(b.Max);
+    }
+
+    void Intersect(const BoundingBox& b)
+    {
+        Min.x = fmaxf(Min.x, b.Min.x); Max.x = fminf(Max.x, b.Max.x);
+        Min.y = fmaxf(Min.y, b.Min.y); Max.y = fminf(Max.y, b.Max.y);
+        Min.z = fmaxf(Min.z, b.Min.z); Max.z = fminf(Max.z, b.Max.z);
+    }
+
+    Vector3f GetCorner(unsigned int i) const
+    {
+        return Vector3f((i & 1) ? Max.x : Min.x, (i & 2) ? Max.y : Min.y, (i & 4) ? Max.z : Min.z);
+    }
+
+    // Box around the eight transformed corners
+    BoundingBox Transform(const Matrix4f& m) const
+    {
+        BoundingBox Ret;
+
+        if (IsEmpty()) return Ret;
+
+        for (unsigned int i = 0; i < 8; i++) {
+            const Vector3f c = GetCorner(i);
+            Ret.AddPoint(Vector3f(m.m[0][0] * c.x + m.m[0][1] * c.y + m.m[0][2] * c.z + m.m[0][3],
+                                  m.m[1][0] * c.x + m.m[1][1] * c.y + m.m[1][2] * c.z + m.m[1][3],
+                                  m.m[2][0] * c.x + m.m[2][1] * c.y + m.m[2][2] * c.z + m.m[2][3]));
+        }
+
+        return Ret;
+    }
 };
 
 
@@ -10,6 +10,7 @@
 #include "util.h"
 #include "math_3d.h"
 #include "texture.h"
+#include "lightmap_uv.h"
 
 struct Vertex
 {
@@ -30,13 +31,18 @@ struct Vertex
 class Mesh
 {
 public:
-    Mesh() {};
+    Mesh() {
+        lightmapVB = INVALID_OGL_VALUE;
+    };
     ~Mesh() {
         Clear();
     };
     bool LoadMesh(const std::string& Filename)
     {
         Clear();
+        bounds.Clear();
+        corners.clear();
+        lightmapVertices.clear();
 
         bool Ret = false;
 
@@ -56,6 +62,94 @@ public:
         return Ret;
     }
 
+    // Object space bounds of all vertices
+    const BoundingBox& GetBounds() const
+    {
+        return bounds;
+    }
+
+    // Appends the triangles of the mesh transformed by World, three vertices each
+    void GetTriangles(const Matrix4f& World, std::vector<Vector3f>& Triangles) const
+    {
+        const Matrix4f& m = World;
+
+        for (unsigned int i = 0; i < corners.size(); i++) {
+            const Vector3f& p = corners[i].pos;
+            Triangles.push_back(Vector3f(m.m[0][0] * p.x + m.m[0][1] * p.y + m.m[0][2] * p.z + m.m[0][3],
+                                         m.m[1][0] * p.x + m.m[1][1] * p.y + m.m[1][2] * p.z + m.m[1][3],
+                                         m.m[2][0] * p.x + m.m[2][1] * p.y + m.m[2][2] * p.z + m.m[2][3]));
+        }
+    }
+
+    // Generates the lightmap UV set and the unindexed vertex buffer drawn by
+    // RenderLightmapped(). All entries share one lightmap.
+    bool InitLightmapUVs(unsigned int LightmapSize)
+    {
+        std::vector<Vector3f> Positions(corners.size());
+        std::vector<Vector2f> UVs;
+
+        for (unsigned int i = 0; i < corners.size(); i++) {
+            Positions[i] = corners[i].pos;
+        }
+
+        if (!GenerateLightmapUVs(Positions, LightmapSize, 2, UVs)) {
+            printf("Mesh does not fit into a %ux%u lightmap\n", LightmapSize, LightmapSize);
+            return false;
+        }
+
+        lightmapVertices.resize(corners.size());
+
+        for (unsigned int i = 0; i < corners.size(); i++) {
+            lightmapVertices[i].pos = corners[i].pos;
+            lightmapVertices[i].tex = corners[i].tex;
+            lightmapVertices[i].normal = corners[i].normal;
+            lightmapVertices[i].lightmapTex = UVs[i];
+        }
+
+        if (lightmapVB == INVALID_OGL_VALUE) glGenBuffers(1, &lightmapVB);
+        glBindBuffer(GL_ARRAY_BUFFER, lightmapVB);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(LightmapVertex) * lightmapVertices.size(),
+            &lightmapVertices[0], GL_STATIC_DRAW);
+
+        return true;
+    }
+
+    // Model space vertices with the lightmap UVs, valid after InitLightmapUVs()
+    const std::vector<LightmapVertex>& GetLightmapVertices() const
+    {
+        return lightmapVertices;
+    }
+
+    // Same as Render() plus the lightmap UVs in attribute 3
+    void RenderLightmapped()
+    {
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+        glEnableVertexAttribArray(2);
+        glEnableVertexAttribArray(3);
+
+        glBindBuffer(GL_ARRAY_BUFFER, lightmapVB);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(LightmapVertex), 0);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(LightmapVertex), (const GLvoid*)12);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(LightmapVertex), (const GLvoid*)20);
+        glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(LightmapVertex), (const GLvoid*)32);
+
+        for (unsigned int i = 0; i < Entries.size(); i++) {
+            const unsigned int MaterialIndex = Entries[i].MaterialIndex;
+
+            if (MaterialIndex < Textures.size() && Textures[MaterialIndex]) {
+                Textures[MaterialIndex]->Bind(GL_TEXTURE0);
+            }
+
+            glDrawArrays(GL_TRIANGLES, Entries[i].FirstCorner, Entries[i].NumIndices);
+        }
+
+        glDisableVertexAttribArray(3);
+        glDisableVertexAttribArray(2);
+        glDisableVertexAttribArray(1);
+        glDisableVertexAttribArray(0);
+    }
+
     void Render()
     {
         glEnableVertexAttribArray(0);
@@ -84,6 +178,28 @@ public:
         glDisableVertexAttribArray(0);
     }
 
+    // Draws the geometry from the tightly packed position buffers only - used by
+    // depth-only passes where the other attributes would just waste fetch bandwidth.
+    // With NumInstances > 1 every instance can route itself to its own layer.
+    void RenderDepth(unsigned int NumInstances = 1)
+    {
+        glEnableVertexAttribArray(0);
+
+        for (unsigned int i = 0; i < Entries.size(); i++) {
+            glBindBuffer(GL_ARRAY_BUFFER, Entries[i].PB);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vector3f), 0);
+
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, Entries[i].IB);
+
+            if (NumInstances > 1)
+                glDrawElementsInstanced(GL_TRIANGLES, Entries[i].NumIndices, GL_UNSIGNED_INT, 0, NumInstances);
+            else
+                glDrawElements(GL_TRIANGLES, Entries[i].NumIndices, GL_UNSIGNED_INT, 0);
+        }
+
+        glDisableVertexAttribArray(0);
+    }
+
 private:
     bool InitFromScene(const aiScene* pScene, const std::string& Filename)
     {
@@ -116,6 +232,7 @@ private:
                 Vector2f(pTexCoord->x, pTexCoord->y),
                 Vector3f(pNormal->x, pNormal->y, pNormal->z));
             Vertices.push_back(v);
+            bounds.AddPoint(v.pos);
         }
 
         for (unsigned int i = 0; i < paiMesh->mNumFaces; i++) {
@@ -126,6 +243,13 @@ private:
             Indices.push_back(Face.mIndices[2]);
         }
 
+        // unindexed copy for the lightmap baker and the lightmap UV set
+        Entries[Index].FirstCorner = (unsigned int)corners.size();
+
+        for (unsigned int i = 0; i < Indices.size(); i++) {
+            corners.push_back(Vertices[Indices[i]]);
+        }
+
         Entries[Index].Init(Vertices, Indices);
     }
 
@@ -174,6 +298,11 @@ private:
     {
         for (unsigned int i = 0; i < Textures.size(); i++)
             SAFE_DELETE(Textures[i]);
+
+        if (lightmapVB != INVALID_OGL_VALUE) {
+            glDeleteBuffers(1, &lightmapVB);
+            lightmapVB = INVALID_OGL_VALUE;
+        }
     }
 
 #define INVALID_MATERIAL 0xFFFFFFFF
@@ -183,14 +312,17 @@ private:
         MeshEntry()
         {
             VB = INVALID_OGL_VALUE;
+            PB = INVALID_OGL_VALUE;
             IB = INVALID_OGL_VALUE;
             NumIndices = 0;
+            FirstCorner = 0;
             MaterialIndex = INVALID_MATERIAL;
         }
 
         ~MeshEntry()
         {
             if (VB != INVALID_OGL_VALUE) glDeleteBuffers(1, &VB);
+            if (PB != INVALID_OGL_VALUE) glDeleteBuffers(1, &PB);
             if (IB != INVALID_OGL_VALUE) glDeleteBuffers(1, &IB);
         }
 
@@ -203,6 +335,16 @@ private:
             glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * Vertices.size(),
                 &Vertices[0], GL_STATIC_DRAW);
 
+            std::vector<Vector3f> Positions(Vertices.size());
+            for (unsigned int i = 0; i < Vertices.size(); i++) {
+                Positions[i] = Vertices[i].pos;
+            }
+
+            glGenBuffers(1, &PB);
+            glBindBuffer(GL_ARRAY_BUFFER, PB);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(Vector3f) * Positions.size(),
+                &Positions[0], GL_STATIC_DRAW);
+
             glGenBuffers(1, &IB);
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IB);
             glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * NumIndices,
@@ -212,12 +354,18 @@ private:
         }
 
         GLuint VB;
+        GLuint PB;
         GLuint IB;
 
         unsigned int NumIndices;
+        unsigned int FirstCorner;
         unsigned int MaterialIndex;
     };
 
     std::vector<MeshEntry> Entries;
     std::vector<Texture*> Textures;
+    BoundingBox bounds;
+    std::vector<Vertex> corners;
+    std::vector<LightmapVertex> lightmapVertices;
+    GLuint lightmapVB;
 };
\ No newline at end of file
@@ -0,0 +1,146 @@
+#ifndef POINT_SHADOW_MAP_FBO_H
+#define	POINT_SHADOW_MAP_FBO_H
+
+#include <GL/glew.h>
+#include <stdio.h>
+
+#include "math_3d.h"
+#include "shadow_map_fbo.h"
+
+// Depth cube map of a point light. The faces hold the distance to the light
+// divided by the far plane, so any direction is compared with one lookup.
+class PointShadowMapFBO
+{
+public:
+    PointShadowMapFBO()
+    {
+        fbo = 0;
+        shadowMap = 0;
+        size = 0;
+    }
+
+    ~PointShadowMapFBO()
+    {
+        if (fbo != 0) glDeleteFramebuffers(1, &fbo);
+        if (shadowMap != 0) glDeleteTextures(1, &shadowMap);
+    }
+
+    bool Init(unsigned int Size, ShadowMapFormat Format = SHADOW_MAP_DEPTH24)
+    {
+        GLenum InternalFormat, Type;
+
+        GetShadowMapFormat(Format, InternalFormat, Type);
+
+        size = Size;
+
+        glGenTextures(1, &shadowMap);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, shadowMap);
+
+        for (unsigned int i = 0; i < 6; i++)
+        {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, InternalFormat, size, size, 0,
+                GL_DEPTH_COMPONENT, Type, NULL);
+        }
+
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+
+        // attached as a layered image - gl_Layer selects the face
+        glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowMap, 0);
+
+        glDrawBuffer(GL_NONE);
+
+        GLenum Status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+        if (Status != GL_FRAMEBUFFER_COMPLETE)
+        {
+            printf("FB error, status: 0x%x\n", Status);
+            return false;
+        }
+
+        return true;
+    }
+
+    // All six faces are bound for a single layered pass
+    void BindForWriting()
+    {
+        glGetIntegerv(GL_VIEWPORT, savedViewport);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+        glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowMap, 0);
+        glViewport(0, 0, size, size);
+    }
+
+    // Only one face is bound, for rendering the faces in separate passes
+    void BindFaceForWriting(unsigned int Face)
+    {
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + Face,
+            shadowMap, 0);
+    }
+
+    void UnbindForWriting()
+    {
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
+    }
+
+    void BindForReading(GLenum TextureUnit)
+    {
+        glActiveTexture(TextureUnit);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, shadowMap);
+    }
+
+    unsigned int GetSize() const { return size; }
+
+    // View projection of every face in GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order.
+    // The face axes follow the cube map addressing rules, which are mirrored
+    // compared to InitCameraTransform, so the faces come out with flipped winding.
+    static void InitFaceTransforms(const Vector3f& LightPos, float zNear, float zFar, Matrix4f FaceVP[6])
+    {
+        static const Vector3f Axes[6][3] = {
+            { Vector3f( 0.0f,  0.0f, -1.0f), Vector3f(0.0f, -1.0f,  0.0f), Vector3f( 1.0f,  0.0f,  0.0f) },
+            { Vector3f( 0.0f,  0.0f,  1.0f), Vector3f(0.0f, -1.0f,  0.0f), Vector3f(-1.0f,  0.0f,  0.0f) },
+            { Vector3f( 1.0f,  0.0f,  0.0f), Vector3f(0.0f,  0.0f,  1.0f), Vector3f( 0.0f,  1.0f,  0.0f) },
+            { Vector3f( 1.0f,  0.0f,  0.0f), Vector3f(0.0f,  0.0f, -1.0f), Vector3f( 0.0f, -1.0f,  0.0f) },
+            { Vector3f( 1.0f,  0.0f,  0.0f), Vector3f(0.0f, -1.0f,  0.0f), Vector3f( 0.0f,  0.0f,  1.0f) },
+            { Vector3f(-1.0f,  0.0f,  0.0f), Vector3f(0.0f, -1.0f,  0.0f), Vector3f( 0.0f,  0.0f, -1.0f) }
+        };
+
+        Matrix4f Translation, Proj;
+        Translation.InitTranslationTransform(-LightPos.x, -LightPos.y, -LightPos.z);
+        Proj.InitPersProjTransform(90.0f, 1.0f, 1.0f, zNear, zFar);
+
+        for (unsigned int i = 0; i < 6; i++)
+        {
+            Matrix4f Rotation;
+            Rotation.InitIdentity();
+
+            for (unsigned int j = 0; j < 3; j++)
+            {
+                Rotation.m[j][0] = Axes[i][j].x;
+                Rotation.m[j][1] = Axes[i][j].y;
+                Rotation.m[j][2] = Axes[i][j].z;
+            }
+
+            FaceVP[i] = Proj * Rotation * Translation;
+        }
+    }
+
+private:
+    GLuint fbo;
+    GLuint shadowMap;
+    unsigned int size;
+    GLint savedViewport[4];
+};
+
+#endif	/* POINT_SHADOW_MAP_FBO_H */
@@ -0,0 +1,216 @@
+#ifndef POINT_SHADOW_TECHNIQUE_H
+#define	POINT_SHADOW_TECHNIQUE_H
+
+#include "technique.h"
+#include "math_3d.h"
+
+// Ways of filling the six faces of a point light shadow cube map.
+//
+//   POINT_SHADOW_GEOMETRY_SHADER  one draw, the geometry shader emits every
+//                                 triangle six times and routes it with gl_Layer
+//   POINT_SHADOW_VERTEX_LAYER     one instanced draw with six instances, the
+//                                 vertex shader writes gl_Layer directly (needs
+//                                 ARB_shader_viewport_layer_array or AMD_vertex_shader_layer)
+//   POINT_SHADOW_SIX_PASS         reference path, one draw per face
+enum PointShadowMode
+{
+    POINT_SHADOW_GEOMETRY_SHADER,
+    POINT_SHADOW_VERTEX_LAYER,
+    POINT_SHADOW_SIX_PASS,
+    POINT_SHADOW_MODE_COUNT
+};
+
+static const char* vertex_PST_GS = R"(
+#version 330
+
+layout (location = 0) in vec3 Position;
+
+uniform mat4 gWorld;
+
+void main()
+{
+    gl_Position = gWorld * vec4(Position, 1.0);
+})";
+
+static const char* geometry_PST_GS = R"(
+#version 330
+
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 18) out;
+
+uniform mat4 gFaceVP[6];
+
+out vec3 WorldPos;
+
+void main()
+{
+    for (int Face = 0 ; Face < 6 ; Face++) {
+        for (int i = 0 ; i < 3 ; i++) {
+            gl_Layer = Face;
+            WorldPos = gl_in[i].gl_Position.xyz;
+            gl_Position = gFaceVP[Face] * gl_in[i].gl_Position;
+            EmitVertex();
+        }
+        EndPrimitive();
+    }
+})";
+
+static const char* vertex_PST_Layer = R"(
+#version 330
+#extension GL_ARB_shader_viewport_layer_array : enable
+#extension GL_AMD_vertex_shader_layer : enable
+
+layout (location = 0) in vec3 Position;
+
+uniform mat4 gWorld;
+uniform mat4 gFaceVP[6];
+
+out vec3 WorldPos;
+
+void main()
+{
+    vec4 Pos = gWorld * vec4(Position, 1.0);
+    WorldPos = Pos.xyz;
+    gl_Position = gFaceVP[gl_InstanceID] * Pos;
+    gl_Layer = gl_InstanceID;
+})";
+
+static const char* vertex_PST_SixPass = R"(
+#version 330
+
+layout (location = 0) in vec3 Position;
+
+uniform mat4 gWorld;
+uniform mat4 gFaceVP[6];
+uniform int gFace;
+
+out vec3 WorldPos;
+
+void main()
+{
+    vec4 Pos = gWorld * vec4(Position, 1.0);
+    WorldPos = Pos.xyz;
+    gl_Position = gFaceVP[gFace] * Pos;
+})";
+
+// Linear distance to the light, so the lighting pass can compare with the
+// length of the light to pixel vector regardless of the face. Polygon offset
+// does not apply to gl_FragDepth, so the slope scaled bias is added here.
+static const char* fragment_PST = R"(
+#version 330
+
+in vec3 WorldPos;
+
+uniform vec3 gLightPos;
+uniform float gFarPlane;
+uniform vec2 gDepthBias;
+
+void main()
+{
+    float Depth = length(WorldPos - gLightPos) / gFarPlane;
+    float Slope = max(abs(dFdx(Depth)), abs(dFdy(Depth)));
+    gl_FragDepth = Depth + gDepthBias.x * Slope + gDepthBias.y;
+})";
+
+class PointShadowTechnique : public Technique {
+
+public:
+    PointShadowTechnique() { }
+
+    static bool IsSupported(PointShadowMode Mode)
+    {
+        if (Mode == POINT_SHADOW_VERTEX_LAYER) {
+            return GLEW_ARB_shader_viewport_layer_array || GLEW_AMD_vertex_shader_layer;
+        }
+
+        return true;
+    }
+
+    bool Init(PointShadowMode Mode)
+    {
+        mode = Mode;
+
+        if (!Technique::Init()) return false;
+
+        switch (mode)
+        {
+        case POINT_SHADOW_GEOMETRY_SHADER:
+            if (!AddShader(GL_VERTEX_SHADER, vertex_PST_GS)) return false;
+            if (!AddShader(GL_GEOMETRY_SHADER, geometry_PST_GS)) return false;
+            break;
+        case POINT_SHADOW_VERTEX_LAYER:
+            if (!AddShader(GL_VERTEX_SHADER, vertex_PST_Layer)) return false;
+            break;
+        default:
+            if (!AddShader(GL_VERTEX_SHADER, vertex_PST_SixPass)) return false;
+            break;
+        }
+
+        if (!AddShader(GL_FRAGMENT_SHADER, fragment_PST)) return false;
+        if (!Finalize()) return false;
+
+        WorldMatrixLocation = GetUniformLocation("gWorld");
+        faceVPLocation = GetUniformLocation("gFaceVP");
+        lightPosLocation = GetUniformLocation("gLightPos");
+        farPlaneLocation = GetUniformLocation("gFarPlane");
+        depthBiasLocation = GetUniformLocation("gDepthBias");
+        faceLocation = (mode == POINT_SHADOW_SIX_PASS) ? GetUniformLocation("gFace") : 0;
+
+        if (WorldMatrixLocation == INVALID_UNIFORM_LOCATION ||
+            faceVPLocation == INVALID_UNIFORM_LOCATION ||
+            lightPosLocation == INVALID_UNIFORM_LOCATION ||
+            farPlaneLocation == INVALID_UNIFORM_LOCATION ||
+            depthBiasLocation == INVALID_UNIFORM_LOCATION ||
+            faceLocation == INVALID_UNIFORM_LOCATION) {
+            return false;
+        }
+
+        return true;
+    }
+
+    PointShadowMode GetMode() const
+    {
+        return mode;
+    }
+
+    void SetWorldMatrix(const Matrix4f& World)
+    {
+        glUniformMatrix4fv(WorldMatrixLocation, 1, GL_TRUE, (const GLfloat*)World.m);
+    }
+
+    void SetFaceTransforms(const Matrix4f FaceVP[6])
+    {
+        glUniformMatrix4fv(faceVPLocation, 6, GL_TRUE, (const GLfloat*)FaceVP[0].m);
+    }
+
+    // only used by POINT_SHADOW_SIX_PASS
+    void SetFace(unsigned int Face)
+    {
+        glUniform1i(faceLocation, Face);
+    }
+
+    void SetLight(const Vector3f& LightPos, float FarPlane)
+    {
+        glUniform3f(lightPosLocation, LightPos.x, LightPos.y, LightPos.z);
+        glUniform1f(farPlaneLocation, FarPlane);
+    }
+
+    // Same meaning as glPolygonOffset, with the constant in units of the far plane
+    void SetDepthBias(float SlopeScale, float Constant)
+    {
+        glUniform2f(depthBiasLocation, SlopeScale, Constant);
+    }
+
+private:
+
+    PointShadowMode mode;
+
+    GLuint WorldMatrixLocation;
+    GLuint faceVPLocation;
+    GLuint lightPosLocation;
+    GLuint farPlaneLocation;
+    GLuint depthBiasLocation;
+    GLuint faceLocation;
+};
+
+#endif	/* POINT_SHADOW_TECHNIQUE_H */
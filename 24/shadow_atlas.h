@@ -0,0 +1,228 @@
+#ifndef SHADOW_ATLAS_H
+#define	SHADOW_ATLAS_H
+
+#include <math.h>
+#include <vector>
+
+#include "math_3d.h"
+
+// Square region of the atlas in texels. Size is 0 when the light did not get a tile.
+struct ShadowAtlasTile
+{
+    unsigned int x;
+    unsigned int y;
+    unsigned int Size;
+};
+
+// Splits one large depth texture into power of two tiles, one per shadowed
+// light. All lights are then rendered into the same FBO by switching the
+// viewport and sampled through a single texture binding.
+class ShadowAtlas
+{
+public:
+    ShadowAtlas()
+    {
+        atlasSize = 0;
+        minTileSize = 128;
+    }
+
+    void SetSize(unsigned int AtlasSize)
+    {
+        atlasSize = AtlasSize;
+    }
+
+    void SetMinTileSize(unsigned int MinTileSize)
+    {
+        minTileSize = MinTileSize;
+    }
+
+    // Importance is the fraction of the atlas edge the light would like to get,
+    // usually the screen coverage of the light scaled by a per-light weight.
+    // The largest requests, the least important first, are halved until the
+    // total area fits the atlas, so every light gets at least the minimum tile
+    // while there is room for that. Lights beyond it stay unshadowed. Returns
+    // true if the layout differs from the previous one.
+    bool Allocate(unsigned int NumLights, const float* pImportance)
+    {
+        std::vector<ShadowAtlasTile> Tiles(NumLights);
+        std::vector<unsigned int> Order(NumLights);
+
+        for (unsigned int i = 0; i < NumLights; i++)
+        {
+            Tiles[i].x = 0;
+            Tiles[i].y = 0;
+            Tiles[i].Size = RequestedSize(pImportance[i]);
+            Order[i] = i;
+        }
+
+        FitRequests(Tiles, pImportance);
+
+        // largest requests first so that power of two tiles pack without holes,
+        // the more important ones first among equal sizes
+        for (unsigned int i = 1; i < NumLights; i++)
+        {
+            for (unsigned int j = i; j > 0 && IsPlacedBefore(Tiles, pImportance, Order[j], Order[j - 1]); j--)
+            {
+                unsigned int Temp = Order[j];
+                Order[j] = Order[j - 1];
+                Order[j - 1] = Temp;
+            }
+        }
+
+        std::vector<ShadowAtlasTile> FreeTiles;
+        ShadowAtlasTile Root = { 0, 0, atlasSize };
+        FreeTiles.push_back(Root);
+
+        for (unsigned int i = 0; i < NumLights; i++)
+        {
+            ShadowAtlasTile& Tile = Tiles[Order[i]];
+
+            while (Tile.Size >= minTileSize && !PlaceTile(FreeTiles, Tile))
+            {
+                Tile.Size /= 2;
+            }
+
+            if (Tile.Size < minTileSize)
+            {
+                Tile.Size = 0;
+            }
+        }
+
+        bool Changed = Tiles.size() != tiles.size();
+
+        for (unsigned int i = 0; !Changed && i < NumLights; i++)
+        {
+            Changed = Tiles[i].x != tiles[i].x || Tiles[i].y != tiles[i].y || Tiles[i].Size != tiles[i].Size;
+        }
+
+        tiles = Tiles;
+
+        return Changed;
+    }
+
+    const ShadowAtlasTile& GetTile(unsigned int Light) const
+    {
+        return tiles[Light];
+    }
+
+    // Offset (xy) and scale (zw) which map the [0,1] shadow coordinates of the
+    // light into its tile. The scale is zero for lights without a tile.
+    void GetTileRect(unsigned int Light, float Rect[4]) const
+    {
+        const ShadowAtlasTile& Tile = tiles[Light];
+
+        Rect[0] = (float)Tile.x / atlasSize;
+        Rect[1] = (float)Tile.y / atlasSize;
+        Rect[2] = (float)Tile.Size / atlasSize;
+        Rect[3] = (float)Tile.Size / atlasSize;
+    }
+
+    // Rough fraction of the screen height covered by a light of the given radius
+    static float CalcScreenCoverage(const Vector3f& LightPos, float Radius, const Vector3f& EyePos, float TanHalfFOV)
+    {
+        Vector3f Delta = LightPos - EyePos;
+        float Distance = sqrtf(Delta.x * Delta.x + Delta.y * Delta.y + Delta.z * Delta.z);
+
+        if (Distance <= Radius) return 1.0f;
+
+        float Coverage = Radius / (Distance * TanHalfFOV);
+        return Coverage < 1.0f ? Coverage : 1.0f;
+    }
+
+private:
+    unsigned int RequestedSize(float Importance) const
+    {
+        unsigned int Size = atlasSize;
+
+        while (Size > minTileSize && Size > Importance * atlasSize)
+        {
+            Size /= 2;
+        }
+
+        return Size;
+    }
+
+    // Power of two squares whose areas add up to at most the atlas area always
+    // pack into it when placed largest first
+    void FitRequests(std::vector<ShadowAtlasTile>& Tiles, const float* pImportance) const
+    {
+        unsigned long long Area = 0;
+
+        for (unsigned int i = 0; i < Tiles.size(); i++)
+        {
+            Area += (unsigned long long)Tiles[i].Size * Tiles[i].Size;
+        }
+
+        while (Area > (unsigned long long)atlasSize * atlasSize)
+        {
+            int Largest = -1;
+
+            for (unsigned int i = 0; i < Tiles.size(); i++)
+            {
+                if (Tiles[i].Size <= minTileSize) continue;
+
+                if (Largest < 0 || Tiles[i].Size > Tiles[Largest].Size ||
+                    (Tiles[i].Size == Tiles[Largest].Size && pImportance[i] < pImportance[Largest]))
+                {
+                    Largest = i;
+                }
+            }
+
+            // all at the minimum, the placement drops the least important ones
+            if (Largest < 0) break;
+
+            const unsigned long long Size = Tiles[Largest].Size;
+            Area -= Size * Size - (Size / 2) * (Size / 2);
+            Tiles[Largest].Size /= 2;
+        }
+    }
+
+    static bool IsPlacedBefore(const std::vector<ShadowAtlasTile>& Tiles, const float* pImportance,
+        unsigned int a, unsigned int b)
+    {
+        if (Tiles[a].Size != Tiles[b].Size) return Tiles[a].Size > Tiles[b].Size;
+        return pImportance[a] > pImportance[b];
+    }
+
+    // Takes the smallest free square that fits and splits it down to the tile size
+    static bool PlaceTile(std::vector<ShadowAtlasTile>& FreeTiles, ShadowAtlasTile& Tile)
+    {
+        int Best = -1;
+
+        for (unsigned int i = 0; i < FreeTiles.size(); i++)
+        {
+            if (FreeTiles[i].Size >= Tile.Size && (Best < 0 || FreeTiles[i].Size < FreeTiles[Best].Size))
+            {
+                Best = i;
+            }
+        }
+
+        if (Best < 0) return false;
+
+        ShadowAtlasTile Free = FreeTiles[Best];
+        FreeTiles.erase(FreeTiles.begin() + Best);
+
+        while (Free.Size > Tile.Size)
+        {
+            Free.Size /= 2;
+
+            ShadowAtlasTile Right = { Free.x + Free.Size, Free.y, Free.Size };
+            ShadowAtlasTile Top = { Free.x, Free.y + Free.Size, Free.Size };
+            ShadowAtlasTile TopRight = { Free.x + Free.Size, Free.y + Free.Size, Free.Size };
+            FreeTiles.push_back(Right);
+            FreeTiles.push_back(Top);
+            FreeTiles.push_back(TopRight);
+        }
+
+        Tile.x = Free.x;
+        Tile.y = Free.y;
+
+        return true;
+    }
+
+    unsigned int atlasSize;
+    unsigned int minTileSize;
+    std::vector<ShadowAtlasTile> tiles;
+};
+
+#endif	/* SHADOW_ATLAS_H */
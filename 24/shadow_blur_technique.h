@@ -0,0 +1,150 @@
+#ifndef SHADOW_BLUR_TECHNIQUE_H
+#define	SHADOW_BLUR_TECHNIQUE_H
+
+#include "technique.h"
+#include "math_3d.h"
+
+// Full screen triangle generated from gl_VertexID, no vertex buffers needed
+static const char* vertex_SBT = R"(
+#version 330
+
+void main()
+{
+    vec2 Pos = vec2((gl_VertexID == 1) ? 3.0 : -1.0, (gl_VertexID == 2) ? 3.0 : -1.0);
+    gl_Position = vec4(Pos, 0.0, 1.0);
+})";
+
+// One direction of a 9 tap separable Gaussian. With gFromDepth set the taps
+// read raw depth and are turned into moments first: (d, d*d) for VSM and the
+// exponentially warped pairs for EVSM. The exponents must match the lighting
+// shader. Taps are clamped to the tile so that neighbouring lights in the
+// atlas do not bleed into each other.
+static const char* fragment_SBT = R"(
+#version 330
+
+const float EVSM_POSITIVE_EXPONENT = 5.0;
+const float EVSM_NEGATIVE_EXPONENT = 5.0;
+
+const float Weights[5] = float[](0.2270270, 0.1945946, 0.1216216, 0.0540541, 0.0162162);
+
+uniform sampler2D gSource;
+uniform int gFromDepth;
+uniform int gExponential;
+uniform vec2 gDirection;
+uniform vec2 gTexelSize;
+uniform vec4 gTileRect;
+
+out vec4 FragColor;
+
+vec4 CalcMoments(float Depth)
+{
+    if (gExponential == 0) {
+        return vec4(Depth, Depth * Depth, 0.0, 0.0);
+    }
+
+    float Pos = exp(EVSM_POSITIVE_EXPONENT * Depth);
+    float Neg = -exp(-EVSM_NEGATIVE_EXPONENT * Depth);
+    return vec4(Pos, Pos * Pos, Neg, Neg * Neg);
+}
+
+vec4 Fetch(vec2 UV)
+{
+    UV = clamp(UV, gTileRect.xy + 0.5 * gTexelSize, gTileRect.xy + gTileRect.zw - 0.5 * gTexelSize);
+
+    if (gFromDepth != 0) {
+        return CalcMoments(texture(gSource, UV).r);
+    }
+
+    return texture(gSource, UV);
+}
+
+void main()
+{
+    vec2 UV = gl_FragCoord.xy * gTexelSize;
+    vec2 Step = gDirection * gTexelSize;
+
+    vec4 Sum = Fetch(UV) * Weights[0];
+
+    for (int i = 1 ; i < 5 ; i++) {
+        Sum += (Fetch(UV + Step * float(i)) + Fetch(UV - Step * float(i))) * Weights[i];
+    }
+
+    FragColor = Sum;
+})";
+
+class ShadowBlurTechnique : public Technique {
+
+public:
+    ShadowBlurTechnique() { }
+
+    bool Init()
+    {
+        if (!Technique::Init()) return false;
+        if (!AddShader(GL_VERTEX_SHADER, vertex_SBT)) return false;
+        if (!AddShader(GL_FRAGMENT_SHADER, fragment_SBT)) return false;
+        if (!Finalize()) return false;
+
+        sourceLocation = GetUniformLocation("gSource");
+        fromDepthLocation = GetUniformLocation("gFromDepth");
+        exponentialLocation = GetUniformLocation("gExponential");
+        directionLocation = GetUniformLocation("gDirection");
+        texelSizeLocation = GetUniformLocation("gTexelSize");
+        tileRectLocation = GetUniformLocation("gTileRect");
+
+        if (sourceLocation == INVALID_UNIFORM_LOCATION ||
+            fromDepthLocation == INVALID_UNIFORM_LOCATION ||
+            exponentialLocation == INVALID_UNIFORM_LOCATION ||
+            directionLocation == INVALID_UNIFORM_LOCATION ||
+            texelSizeLocation == INVALID_UNIFORM_LOCATION ||
+            tileRectLocation == INVALID_UNIFORM_LOCATION) {
+            return false;
+        }
+
+        return true;
+    }
+
+    void SetSourceTextureUnit(unsigned int TextureUnit)
+    {
+        glUniform1i(sourceLocation, TextureUnit);
+    }
+
+    // The horizontal pass reads depth, the vertical pass reads its moments
+    void SetPass(bool Horizontal)
+    {
+        glUniform1i(fromDepthLocation, Horizontal ? 1 : 0);
+        glUniform2f(directionLocation, Horizontal ? 1.0f : 0.0f, Horizontal ? 0.0f : 1.0f);
+    }
+
+    void SetExponential(bool Exponential)
+    {
+        glUniform1i(exponentialLocation, Exponential ? 1 : 0);
+    }
+
+    // size of one texel of the render target
+    void SetTargetSize(unsigned int Width, unsigned int Height)
+    {
+        glUniform2f(texelSizeLocation, 1.0f / Width, 1.0f / Height);
+    }
+
+    void SetTileRect(const float Rect[4])
+    {
+        glUniform4f(tileRectLocation, Rect[0], Rect[1], Rect[2], Rect[3]);
+    }
+
+    // Draws the full screen triangle, the viewport limits it to one tile
+    void Draw()
+    {
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+
+private:
+
+    GLuint sourceLocation;
+    GLuint fromDepthLocation;
+    GLuint exponentialLocation;
+    GLuint directionLocation;
+    GLuint texelSizeLocation;
+    GLuint tileRectLocation;
+};
+
+#endif	/* SHADOW_BLUR_TECHNIQUE_H */
@@ -0,0 +1,192 @@
+#ifndef SHADOW_CASCADES_H
+#define	SHADOW_CASCADES_H
+
+#include <math.h>
+#include <float.h>
+#include <glm/glm.hpp>
+
+#include "math_3d.h"
+
+static const unsigned int MAX_SHADOW_CASCADES = 4;
+
+// Splits the camera frustum along the view direction and fits an orthographic
+// projection of the directional light around the bounding sphere of every
+// slice. Each slice gets the full shadow map resolution, so near geometry gets
+// dense texels while the far slices cover large areas.
+class ShadowCascades
+{
+public:
+    ShadowCascades()
+    {
+        numCascades = 3;
+        splitLambda = 0.75f;
+        casterExtent = 50.0f;
+    }
+
+    // Lambda blends between uniform (0.0) and logarithmic (1.0) split distances
+    void SetSplits(unsigned int NumCascades, float SplitLambda)
+    {
+        numCascades = NumCascades < MAX_SHADOW_CASCADES ? NumCascades : MAX_SHADOW_CASCADES;
+        splitLambda = SplitLambda;
+    }
+
+    // How far towards the light the depth range of every cascade is extended so
+    // that casters outside of the camera frustum still land in the map
+    void SetCasterExtent(float CasterExtent)
+    {
+        casterExtent = CasterExtent;
+    }
+
+    void SetCamera(const Vector3f& Pos, const Vector3f& Target, const Vector3f& Up)
+    {
+        camera.Pos = Pos;
+        camera.Target = Target;
+        camera.Up = Up;
+    }
+
+    void SetPerspectiveProj(float FOV, float Width, float Height, float zNear, float zFar)
+    {
+        persProj.FOV = FOV;
+        persProj.Width = Width;
+        persProj.Height = Height;
+        persProj.zNear = zNear;
+        persProj.zFar = zFar;
+    }
+
+    void Update(const Vector3f& LightDirection, unsigned int ShadowMapSize)
+    {
+        // Orthonormal basis of the light
+        Vector3f N = LightDirection;
+        N.Normalize();
+        Vector3f Up = fabsf(N.y) > 0.99f ? Vector3f(1.0f, 0.0f, 0.0f) : Vector3f(0.0f, 1.0f, 0.0f);
+        Vector3f U = Up.Cross(N);
+        U.Normalize();
+        Vector3f V = N.Cross(U);
+
+        Matrix4f LightView;
+        LightView.m[0][0] = U.x;  LightView.m[0][1] = U.y;  LightView.m[0][2] = U.z;  LightView.m[0][3] = 0.0f;
+        LightView.m[1][0] = V.x;  LightView.m[1][1] = V.y;  LightView.m[1][2] = V.z;  LightView.m[1][3] = 0.0f;
+        LightView.m[2][0] = N.x;  LightView.m[2][1] = N.y;  LightView.m[2][2] = N.z;  LightView.m[2][3] = 0.0f;
+        LightView.m[3][0] = 0.0f; LightView.m[3][1] = 0.0f; LightView.m[3][2] = 0.0f; LightView.m[3][3] = 1.0f;
+
+        // Orthonormal basis of the camera, same convention as InitCameraTransform
+        Vector3f CamN = camera.Target;
+        CamN.Normalize();
+        Vector3f CamU = camera.Up.Cross(CamN);
+        CamU.Normalize();
+        Vector3f CamV = CamN.Cross(CamU);
+
+        const float TanHalfFOV = tanf(glm::radians(persProj.FOV / 2.0f));
+        const float AspectRatio = persProj.Width / persProj.Height;
+        const float zNear = persProj.zNear;
+        const float zFar = persProj.zFar;
+
+        float Splits[MAX_SHADOW_CASCADES + 1];
+
+        for (unsigned int i = 0; i <= numCascades; i++) {
+            const float t = (float)i / numCascades;
+            const float LogSplit = zNear * powf(zFar / zNear, t);
+            const float UniformSplit = zNear + (zFar - zNear) * t;
+            Splits[i] = splitLambda * LogSplit + (1.0f - splitLambda) * UniformSplit;
+        }
+
+        for (unsigned int i = 0; i < numCascades; i++) {
+            Vector3f Corners[8];
+            Vector3f Center(0.0f, 0.0f, 0.0f);
+
+            for (unsigned int j = 0; j < 2; j++) {
+                const float Dist = Splits[i + j];
+                const float HalfHeight = Dist * TanHalfFOV;
+                const float HalfWidth = HalfHeight * AspectRatio;
+                const Vector3f SliceCenter = camera.Pos + CamN * Dist;
+
+                for (unsigned int k = 0; k < 4; k++) {
+                    const float SignX = (k & 1) ? 1.0f : -1.0f;
+                    const float SignY = (k & 2) ? 1.0f : -1.0f;
+                    Corners[j * 4 + k] = SliceCenter + CamU * (SignX * HalfWidth) + CamV * (SignY * HalfHeight);
+                    Center = Center + Corners[j * 4 + k] * 0.125f;
+                }
+            }
+
+            // The sphere around the slice only depends on the split distances and
+            // the projection, so the size of the cascade stays the same however the
+            // camera turns. The radius is rounded up so that float noise in the
+            // corners cannot change the texel size from one frame to the next.
+            float Radius = 0.0f;
+
+            for (unsigned int k = 0; k < 8; k++) {
+                const Vector3f d = Corners[k] - Center;
+                Radius = fmaxf(Radius, sqrtf(Dot(d, d)));
+            }
+
+            Radius = ceilf(Radius * 16.0f) / 16.0f;
+
+            // With the texel size fixed, moving the origin in whole texel steps keeps
+            // the projection of static geometry from shimmering as the camera moves
+            const float Texel = 2.0f * Radius / ShadowMapSize;
+            const Vector3f LightCenter(Dot(Center, U), Dot(Center, V), Dot(Center, N));
+
+            Vector3f Min, Max;
+            Min.x = floorf((LightCenter.x - Radius) / Texel) * Texel;
+            Min.y = floorf((LightCenter.y - Radius) / Texel) * Texel;
+            Min.z = LightCenter.z - Radius;
+            Max.x = Min.x + 2.0f * Radius;
+            Max.y = Min.y + 2.0f * Radius;
+            Max.z = LightCenter.z + Radius;
+
+            Matrix4f Ortho;
+            Ortho.InitOrthoProjTransform(Min.x, Max.x, Min.y, Max.y, Min.z - casterExtent, Max.z);
+
+            cascades[i].LightVP = Ortho * LightView;
+            cascades[i].EndViewZ = Splits[i + 1];
+        }
+    }
+
+    unsigned int GetNumCascades() const
+    {
+        return numCascades;
+    }
+
+    // World to light clip space transformation of the cascade
+    const Matrix4f& GetLightVP(unsigned int Cascade) const
+    {
+        return cascades[Cascade].LightVP;
+    }
+
+    // View space depth where the cascade ends
+    float GetCascadeEnd(unsigned int Cascade) const
+    {
+        return cascades[Cascade].EndViewZ;
+    }
+
+private:
+    static float Dot(const Vector3f& a, const Vector3f& b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    unsigned int numCascades;
+    float splitLambda;
+    float casterExtent;
+
+    struct {
+        Vector3f Pos;
+        Vector3f Target;
+        Vector3f Up;
+    } camera;
+
+    struct {
+        float FOV;
+        float Width;
+        float Height;
+        float zNear;
+        float zFar;
+    } persProj;
+
+    struct {
+        Matrix4f LightVP;
+        float EndViewZ;
+    } cascades[MAX_SHADOW_CASCADES];
+};
+
+#endif	/* SHADOW_CASCADES_H */
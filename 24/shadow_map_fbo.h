@@ -1,6 +1,37 @@
+#ifndef SHADOW_MAP_FBO_H
+#define	SHADOW_MAP_FBO_H
+
 #include <GL/glew.h>
 #include <stdio.h>
 
+// Precision of the depth texture. 16 bits is enough for short light ranges and
+// halves the bandwidth of 32F, which is only worth it for long ranges.
+enum ShadowMapFormat
+{
+    SHADOW_MAP_DEPTH16,
+    SHADOW_MAP_DEPTH24,
+    SHADOW_MAP_DEPTH32F
+};
+
+inline void GetShadowMapFormat(ShadowMapFormat Format, GLenum& InternalFormat, GLenum& Type)
+{
+    switch (Format)
+    {
+    case SHADOW_MAP_DEPTH16:
+        InternalFormat = GL_DEPTH_COMPONENT16;
+        Type = GL_UNSIGNED_SHORT;
+        break;
+    case SHADOW_MAP_DEPTH24:
+        InternalFormat = GL_DEPTH_COMPONENT24;
+        Type = GL_UNSIGNED_INT;
+        break;
+    default:
+        InternalFormat = GL_DEPTH_COMPONENT32F;
+        Type = GL_FLOAT;
+        break;
+    }
+}
+
 class ShadowMapFBO
 {
 public:
@@ -8,45 +39,114 @@ public:
     {
         fbo = 0;
         shadowMap = 0;
+        staticFbo = 0;
+        staticMap = 0;
+        staticValid = false;
+        width = 0;
+        height = 0;
+        format = SHADOW_MAP_DEPTH24;
     }
 
     ~ShadowMapFBO()
     {
         if (fbo != 0) glDeleteFramebuffers(1, &fbo);
-        if (shadowMap != 0) glDeleteFramebuffers(1, &shadowMap);
+        if (shadowMap != 0) glDeleteTextures(1, &shadowMap);
+        if (staticFbo != 0) glDeleteFramebuffers(1, &staticFbo);
+        if (staticMap != 0) glDeleteTextures(1, &staticMap);
     }
 
-    bool Init(unsigned int WindowWidth, unsigned int WindowHeight)
+    // The size is independent from the window so that shadow quality can be
+    // traded against fill rate separately from the display resolution
+    bool Init(unsigned int Width, unsigned int Height, ShadowMapFormat Format = SHADOW_MAP_DEPTH24)
     {
         glGenFramebuffers(1, &fbo);
 
         glGenTextures(1, &shadowMap);
         glBindTexture(GL_TEXTURE_2D, shadowMap);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, WindowWidth, WindowHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
         glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
         glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
 
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
-        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
-            shadowMap, 0);
+        // Sampled through sampler2DShadow: each fetch compares against the
+        // reference depth and the linear filter blends the 2x2 results
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
 
-        glDrawBuffer(GL_NONE);
+        // Depth of the static casters only. It is never sampled for lighting, just
+        // reprojected into the shadow map before the dynamic casters.
+        glGenFramebuffers(1, &staticFbo);
 
-        GLenum Status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-        if (Status != GL_FRAMEBUFFER_COMPLETE)
-        {
-            printf("FB error, status: 0x%x\n", Status);
-            return false;
-        }
+        glGenTextures(1, &staticMap);
+        glBindTexture(GL_TEXTURE_2D, staticMap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        return Resize(Width, Height, Format);
+    }
+
+    // Reallocates the depth texture. Can be called at any time after Init().
+    bool Resize(unsigned int Width, unsigned int Height, ShadowMapFormat Format)
+    {
+        GLenum InternalFormat, Type;
+
+        GetShadowMapFormat(Format, InternalFormat, Type);
+
+        width = Width;
+        height = Height;
+        format = Format;
+        staticValid = false;
+
+        // Both maps share size and format so that the static tiles line up
+        if (!AttachDepth(fbo, shadowMap, InternalFormat, Type)) return false;
+        if (!AttachDepth(staticFbo, staticMap, InternalFormat, Type)) return false;
 
         return true;
     }
 
+    bool Resize(unsigned int Width, unsigned int Height)
+    {
+        return Resize(Width, Height, format);
+    }
+
+    // Binds the FBO and switches the viewport to the shadow map size. The
+    // previous viewport is restored by UnbindForWriting().
     void BindForWriting()
     {
+        glGetIntegerv(GL_VIEWPORT, savedViewport);
         glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+        glViewport(0, 0, width, height);
+    }
+
+    // True when the static casters have to be rendered again, after a resize or
+    // after InvalidateStatic() was called because the light or a static caster moved
+    bool NeedsStaticUpdate() const
+    {
+        return !staticValid;
+    }
+
+    void InvalidateStatic()
+    {
+        staticValid = false;
+    }
+
+    // Must be called between BindForWriting() and UnbindForWriting()
+    void BeginStaticUpdate()
+    {
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, staticFbo);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
+    void EndStaticUpdate()
+    {
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+        staticValid = true;
+    }
+
+    void UnbindForWriting()
+    {
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
     }
 
     void BindForReading(GLenum TextureUnit)
@@ -55,7 +155,55 @@ public:
         glBindTexture(GL_TEXTURE_2D, shadowMap);
     }
 
+    // For reprojecting the static depth, which is rendered with another
+    // projection than the shadow map
+    void BindStaticForReading(GLenum TextureUnit)
+    {
+        glActiveTexture(TextureUnit);
+        glBindTexture(GL_TEXTURE_2D, staticMap);
+    }
+
+    unsigned int GetWidth() const { return width; }
+    unsigned int GetHeight() const { return height; }
+    ShadowMapFormat GetFormat() const { return format; }
+
 private:
+    bool AttachDepth(GLuint Fbo, GLuint Texture, GLenum InternalFormat, GLenum Type)
+    {
+        glBindTexture(GL_TEXTURE_2D, Texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, InternalFormat, width, height, 0, GL_DEPTH_COMPONENT, Type, NULL);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, Fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
+            Texture, 0);
+
+        // Depth only. Without a read buffer of NONE the FBO is incomplete when
+        // bound for reading.
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+
+        GLenum Status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        if (Status != GL_FRAMEBUFFER_COMPLETE)
+        {
+            printf("FB error, status: 0x%x\n", Status);
+            return false;
+        }
+
+        return true;
+    }
+
     GLuint fbo;
     GLuint shadowMap;
+    GLuint staticFbo;
+    GLuint staticMap;
+    bool staticValid;
+    unsigned int width;
+    unsigned int height;
+    ShadowMapFormat format;
+    GLint savedViewport[4];
 };
+
+#endif	/* SHADOW_MAP_FBO_H */
@@ -0,0 +1,144 @@
+#ifndef SHADOW_MOMENTS_FBO_H
+#define	SHADOW_MOMENTS_FBO_H
+
+#include <GL/glew.h>
+#include <stdio.h>
+
+// Filterable copy of the shadow map for variance shadow maps. The depth is
+// converted into moments while blurring horizontally into a scratch texture,
+// the vertical blur then writes the final moments which are mipmapped so the
+// lighting pass can use plain trilinear filtering.
+class ShadowMomentsFBO
+{
+public:
+    enum Target
+    {
+        SCRATCH,
+        MOMENTS,
+        TARGET_COUNT
+    };
+
+    ShadowMomentsFBO()
+    {
+        for (unsigned int i = 0; i < TARGET_COUNT; i++)
+        {
+            fbo[i] = 0;
+            textures[i] = 0;
+        }
+        depthSampler = 0;
+        width = 0;
+        height = 0;
+    }
+
+    ~ShadowMomentsFBO()
+    {
+        for (unsigned int i = 0; i < TARGET_COUNT; i++)
+        {
+            if (fbo[i] != 0) glDeleteFramebuffers(1, &fbo[i]);
+            if (textures[i] != 0) glDeleteTextures(1, &textures[i]);
+        }
+        if (depthSampler != 0) glDeleteSamplers(1, &depthSampler);
+    }
+
+    bool Init(unsigned int Width, unsigned int Height)
+    {
+        glGenFramebuffers(TARGET_COUNT, fbo);
+        glGenTextures(TARGET_COUNT, textures);
+
+        for (unsigned int i = 0; i < TARGET_COUNT; i++)
+        {
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, i == MOMENTS ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+
+        // The shadow map itself is set up for hardware comparison. The first
+        // blur pass reads raw depth through this sampler instead.
+        glGenSamplers(1, &depthSampler);
+        glSamplerParameteri(depthSampler, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+        glSamplerParameteri(depthSampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glSamplerParameteri(depthSampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glSamplerParameteri(depthSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glSamplerParameteri(depthSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        return Resize(Width, Height);
+    }
+
+    bool Resize(unsigned int Width, unsigned int Height)
+    {
+        width = Width;
+        height = Height;
+
+        for (unsigned int i = 0; i < TARGET_COUNT; i++)
+        {
+            // 16 bit floats keep the two EVSM moment pairs at half the bandwidth of 32F
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+
+            if (i == MOMENTS) glGenerateMipmap(GL_TEXTURE_2D);
+
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo[i]);
+            glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[i], 0);
+
+            GLenum Status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+
+            if (Status != GL_FRAMEBUFFER_COMPLETE)
+            {
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+                printf("FB error, status: 0x%x\n", Status);
+                return false;
+            }
+        }
+
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+        return true;
+    }
+
+    void BindForWriting(Target Dst)
+    {
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo[Dst]);
+    }
+
+    void UnbindForWriting()
+    {
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    }
+
+    void BindForReading(Target Src, unsigned int TextureUnit)
+    {
+        glActiveTexture(GL_TEXTURE0 + TextureUnit);
+        glBindTexture(GL_TEXTURE_2D, textures[Src]);
+    }
+
+    // Overrides the comparison state of whatever depth texture is on the unit
+    void BindDepthSampler(unsigned int TextureUnit)
+    {
+        glBindSampler(TextureUnit, depthSampler);
+    }
+
+    void UnbindDepthSampler(unsigned int TextureUnit)
+    {
+        glBindSampler(TextureUnit, 0);
+    }
+
+    void GenerateMipmaps()
+    {
+        glBindTexture(GL_TEXTURE_2D, textures[MOMENTS]);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+
+    unsigned int GetWidth() const { return width; }
+    unsigned int GetHeight() const { return height; }
+
+private:
+    GLuint fbo[TARGET_COUNT];
+    GLuint textures[TARGET_COUNT];
+    GLuint depthSampler;
+    unsigned int width;
+    unsigned int height;
+};
+
+#endif	/* SHADOW_MOMENTS_FBO_H */
@@ -0,0 +1,129 @@
+#ifndef SHADOW_REPROJECT_TECHNIQUE_H
+#define	SHADOW_REPROJECT_TECHNIQUE_H
+
+#include <math.h>
+#include <glm/glm.hpp>
+
+#include "technique.h"
+#include "spot_frustum.h"
+
+// Full screen triangle generated from gl_VertexID, no vertex buffers needed
+static const char* vertex_SRT = R"(
+#version 330
+
+void main()
+{
+    vec2 Pos = vec2((gl_VertexID == 1) ? 3.0 : -1.0, (gl_VertexID == 2) ? 3.0 : -1.0);
+    gl_Position = vec4(Pos, 0.0, 1.0);
+})";
+
+// Writes the static depth of a tile, rendered over the whole cone, in the
+// fitted projection of the tile. Both share the light position and direction,
+// so a texel only moves towards the center by the ratio of the FOV tangents
+// and its depth is converted from one depth range to the other.
+static const char* fragment_SRT = R"(
+#version 330
+
+uniform sampler2D gStaticMap;
+uniform vec2 gTexelSize;
+uniform vec4 gTileRect;
+uniform float gFOVScale;
+uniform vec2 gStaticRange;
+uniform vec2 gRange;
+
+// distance along the light direction of a [0, 1] depth
+float CalcViewDepth(float Depth, vec2 Range)
+{
+    float Ndc = Depth * 2.0 - 1.0;
+    return 2.0 * Range.x * Range.y / (Range.x + Range.y - Ndc * (Range.y - Range.x));
+}
+
+void main()
+{
+    vec2 UV = gl_FragCoord.xy * gTexelSize;
+    vec2 Local = (UV - gTileRect.xy) / gTileRect.zw;
+    float Depth = texture(gStaticMap, gTileRect.xy + gTileRect.zw * (0.5 + (Local - 0.5) * gFOVScale)).r;
+
+    // nothing was drawn there
+    if (Depth >= 1.0) {
+        gl_FragDepth = 1.0;
+        return;
+    }
+
+    float z = CalcViewDepth(Depth, gStaticRange);
+    float Ndc = (gRange.y + gRange.x - 2.0 * gRange.x * gRange.y / z) / (gRange.y - gRange.x);
+    gl_FragDepth = clamp(Ndc * 0.5 + 0.5, 0.0, 1.0);
+})";
+
+class ShadowReprojectTechnique : public Technique {
+
+public:
+    ShadowReprojectTechnique() { }
+
+    bool Init()
+    {
+        if (!Technique::Init()) return false;
+        if (!AddShader(GL_VERTEX_SHADER, vertex_SRT)) return false;
+        if (!AddShader(GL_FRAGMENT_SHADER, fragment_SRT)) return false;
+        if (!Finalize()) return false;
+
+        staticMapLocation = GetUniformLocation("gStaticMap");
+        texelSizeLocation = GetUniformLocation("gTexelSize");
+        tileRectLocation = GetUniformLocation("gTileRect");
+        fovScaleLocation = GetUniformLocation("gFOVScale");
+        staticRangeLocation = GetUniformLocation("gStaticRange");
+        rangeLocation = GetUniformLocation("gRange");
+
+        if (staticMapLocation == INVALID_UNIFORM_LOCATION ||
+            texelSizeLocation == INVALID_UNIFORM_LOCATION ||
+            tileRectLocation == INVALID_UNIFORM_LOCATION ||
+            fovScaleLocation == INVALID_UNIFORM_LOCATION ||
+            staticRangeLocation == INVALID_UNIFORM_LOCATION ||
+            rangeLocation == INVALID_UNIFORM_LOCATION) {
+            return false;
+        }
+
+        return true;
+    }
+
+    void SetStaticTextureUnit(unsigned int TextureUnit)
+    {
+        glUniform1i(staticMapLocation, TextureUnit);
+    }
+
+    // size of the shadow atlas
+    void SetTargetSize(unsigned int Width, unsigned int Height)
+    {
+        glUniform2f(texelSizeLocation, 1.0f / Width, 1.0f / Height);
+    }
+
+    void SetTileRect(const float Rect[4])
+    {
+        glUniform4f(tileRectLocation, Rect[0], Rect[1], Rect[2], Rect[3]);
+    }
+
+    // The static depth was rendered with Static, the tile uses Fitted
+    void SetProjections(const SpotShadowFrustum& Static, const SpotShadowFrustum& Fitted)
+    {
+        glUniform1f(fovScaleLocation, tanf(glm::radians(Fitted.FOV / 2.0f)) / tanf(glm::radians(Static.FOV / 2.0f)));
+        glUniform2f(staticRangeLocation, Static.zNear, Static.zFar);
+        glUniform2f(rangeLocation, Fitted.zNear, Fitted.zFar);
+    }
+
+    // Draws the full screen triangle, the viewport limits it to one tile
+    void Draw()
+    {
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+
+private:
+
+    GLuint staticMapLocation;
+    GLuint texelSizeLocation;
+    GLuint tileRectLocation;
+    GLuint fovScaleLocation;
+    GLuint staticRangeLocation;
+    GLuint rangeLocation;
+};
+
+#endif	/* SHADOW_REPROJECT_TECHNIQUE_H */
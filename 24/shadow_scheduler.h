@@ -0,0 +1,180 @@
+#ifndef SHADOW_SCHEDULER_H
+#define	SHADOW_SCHEDULER_H
+
+#include <stdio.h>
+#include <vector>
+
+// Spreads shadow map updates over several frames. Every light gets an update
+// interval from its screen size, distance and motion, and each frame the due
+// lights are picked round-robin until the texel budget is spent. Lights whose
+// map became invalid (resize, new atlas tile) are always taken first.
+class ShadowScheduler
+{
+public:
+    ShadowScheduler()
+    {
+        texelBudget = 0;
+        maxInterval = 8;
+        farDistance = 40.0f;
+        frame = 0;
+        cursor = 0;
+        scheduledTexels = 0;
+    }
+
+    // 0 disables the budget
+    void SetTexelBudget(unsigned long long TexelBudget)
+    {
+        texelBudget = TexelBudget;
+    }
+
+    // Lights further than FarDistance always use the longest interval
+    void SetLimits(unsigned int MaxInterval, float FarDistance)
+    {
+        maxInterval = MaxInterval;
+        farDistance = FarDistance;
+    }
+
+    unsigned int AddLight()
+    {
+        Entry e;
+        e.Distance = 0.0f;
+        e.ScreenSize = 1.0f;
+        e.Moved = false;
+        e.Forced = true;
+        e.Texels = 0;
+        e.Interval = 1;
+        e.LastUpdate = 0;
+        e.Update = false;
+        entries.push_back(e);
+
+        return (unsigned int)entries.size() - 1;
+    }
+
+    // Called every frame before Schedule(). Texels is the cost of one update
+    // of the light's map, e.g. 6 * Size * Size for a cube map.
+    void SetLightState(unsigned int Light, float Distance, float ScreenSize, bool Moved, unsigned long long Texels)
+    {
+        Entry& e = entries[Light];
+        e.Distance = Distance;
+        e.ScreenSize = ScreenSize;
+        e.Moved = Moved;
+        e.Texels = Texels;
+    }
+
+    // The map content is unusable, update it on the next frame regardless of the budget
+    void Invalidate(unsigned int Light)
+    {
+        entries[Light].Forced = true;
+    }
+
+    void Schedule()
+    {
+        frame++;
+        scheduledTexels = 0;
+
+        const unsigned int NumLights = (unsigned int)entries.size();
+
+        for (unsigned int i = 0; i < NumLights; i++)
+        {
+            Entry& e = entries[i];
+            e.Interval = CalcInterval(e);
+            e.Update = e.Forced;
+
+            if (e.Update) scheduledTexels += e.Texels;
+        }
+
+        // due lights in round-robin order, starting after the last one served
+        unsigned int Last = cursor;
+
+        for (unsigned int n = 0; n < NumLights; n++)
+        {
+            const unsigned int i = (cursor + n) % NumLights;
+            Entry& e = entries[i];
+
+            if (e.Update || GetStaleness(i) < e.Interval) continue;
+
+            // the first due light always fits, otherwise a light larger than
+            // the budget would never be updated
+            if (texelBudget != 0 && scheduledTexels != 0 && scheduledTexels + e.Texels > texelBudget) break;
+
+            e.Update = true;
+            scheduledTexels += e.Texels;
+            Last = i + 1;
+        }
+
+        cursor = NumLights ? Last % NumLights : 0;
+
+        for (unsigned int i = 0; i < NumLights; i++)
+        {
+            Entry& e = entries[i];
+
+            if (e.Update)
+            {
+                e.LastUpdate = frame;
+                e.Forced = false;
+            }
+        }
+    }
+
+    bool ShouldUpdate(unsigned int Light) const
+    {
+        return entries[Light].Update;
+    }
+
+    // Frames since the map of the light was last rendered, 0 if it was rendered this frame
+    unsigned int GetStaleness(unsigned int Light) const
+    {
+        return frame - entries[Light].LastUpdate;
+    }
+
+    void PrintStats() const
+    {
+        printf("Shadow updates: %llu texels this frame, budget %llu\n", scheduledTexels, texelBudget);
+
+        for (unsigned int i = 0; i < entries.size(); i++)
+        {
+            const Entry& e = entries[i];
+            printf("  light %u: every %u frame(s), stale for %u, %llu texels%s\n", i, e.Interval,
+                GetStaleness(i), e.Texels, e.Update ? ", updated" : "");
+        }
+    }
+
+private:
+    struct Entry
+    {
+        float Distance;
+        float ScreenSize;
+        bool Moved;
+        bool Forced;
+        unsigned long long Texels;
+        unsigned int Interval;
+        unsigned int LastUpdate;
+        bool Update;
+    };
+
+    unsigned int CalcInterval(const Entry& e) const
+    {
+        if (e.Moved) return 1;
+        if (e.Distance > farDistance) return maxInterval;
+
+        unsigned int Interval = 1;
+
+        // halve the rate every time the light covers half as much of the screen
+        for (float Size = 0.5f; e.ScreenSize < Size && Interval < maxInterval; Size *= 0.5f)
+        {
+            Interval *= 2;
+        }
+
+        return Interval;
+    }
+
+    std::vector<Entry> entries;
+    unsigned long long texelBudget;
+    unsigned long long scheduledTexels;
+    unsigned int maxInterval;
+    float farDistance;
+    unsigned int frame;
+    unsigned int cursor;
+};
+
+#endif	/* SHADOW_SCHEDULER_H */
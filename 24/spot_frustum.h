@@ -0,0 +1,211 @@
+#ifndef SPOT_FRUSTUM_H
+#define	SPOT_FRUSTUM_H
+
+#include <math.h>
+#include <glm/glm.hpp>
+
+#include "math_3d.h"
+
+// Perspective parameters of a spot light shadow map
+struct SpotShadowFrustum
+{
+    float FOV;
+    float zNear;
+    float zFar;
+};
+
+// Fixed projection over the whole cone, a little wider than it so the filter
+// kernel has texels at the edge. It only changes when the light does.
+inline SpotShadowFrustum GetSpotConeFrustum(float Cutoff, float Range)
+{
+    SpotShadowFrustum Ret;
+    Ret.FOV = 2.0f * glm::degrees(atanf(tanf(glm::radians(Cutoff)) * 1.05f));
+    Ret.zNear = 1.0f;
+    Ret.zFar = Range;
+    return Ret;
+}
+
+// Corners of the camera frustum in world space, same camera convention as
+// InitCameraTransform
+inline void GetFrustumCorners(const Vector3f& Pos, const Vector3f& Target, const Vector3f& Up,
+    float FOV, float Width, float Height, float zNear, float zFar, Vector3f Corners[8])
+{
+    Vector3f N = Target;
+    N.Normalize();
+    Vector3f U = Up.Cross(N);
+    U.Normalize();
+    Vector3f V = N.Cross(U);
+
+    const float TanHalfFOV = tanf(glm::radians(FOV / 2.0f));
+    const float AspectRatio = Width / Height;
+
+    for (unsigned int i = 0; i < 8; i++) {
+        const float Dist = (i & 4) ? zFar : zNear;
+        const float HalfHeight = Dist * TanHalfFOV;
+        const float HalfWidth = HalfHeight * AspectRatio;
+
+        Corners[i] = Pos + N * Dist + U * ((i & 1) ? HalfWidth : -HalfWidth) + V * ((i & 2) ? HalfHeight : -HalfHeight);
+    }
+}
+
+// Clips the segment between two points against planes given by the signed
+// distances of both ends, positive inside. t0 and t1 are the part of the
+// segment that is left; returns false when nothing is.
+inline bool ClipSegment(const float* pDist0, const float* pDist1, unsigned int NumPlanes, float& t0, float& t1)
+{
+    t0 = 0.0f;
+    t1 = 1.0f;
+
+    for (unsigned int i = 0; i < NumPlanes; i++) {
+        if (pDist0[i] < 0.0f && pDist1[i] < 0.0f) return false;
+
+        if (pDist0[i] < 0.0f) {
+            t0 = fmaxf(t0, pDist0[i] / (pDist0[i] - pDist1[i]));
+        }
+        else if (pDist1[i] < 0.0f) {
+            t1 = fminf(t1, pDist0[i] / (pDist0[i] - pDist1[i]));
+        }
+    }
+
+    return t0 <= t1;
+}
+
+// Nearest depth along the light direction of the part of the box inside the
+// light pyramid between zNear and zFar. The overlap is convex, so the nearest
+// point is one of its vertices and each of those lies on an edge of the box
+// clipped by the pyramid or on an edge of the pyramid clipped by the box.
+// Returns zFar when they don't overlap.
+inline float CalcNearestDepth(const Vector3f& LightPos, const Vector3f& U, const Vector3f& V, const Vector3f& N,
+    float TanHalfFOV, float zNear, float zFar, const BoundingBox& Box)
+{
+    float BoxDist[8][6];
+    float BoxDepth[8];
+    float PyramidDist[8][6];
+    float PyramidDepth[8];
+
+    for (unsigned int i = 0; i < 8; i++) {
+        const Vector3f d = Box.GetCorner(i) - LightPos;
+        const float x = d.x * U.x + d.y * U.y + d.z * U.z;
+        const float y = d.x * V.x + d.y * V.y + d.z * V.z;
+        const float z = d.x * N.x + d.y * N.y + d.z * N.z;
+
+        BoxDist[i][0] = z - zNear;
+        BoxDist[i][1] = zFar - z;
+        BoxDist[i][2] = z * TanHalfFOV - x;
+        BoxDist[i][3] = z * TanHalfFOV + x;
+        BoxDist[i][4] = z * TanHalfFOV - y;
+        BoxDist[i][5] = z * TanHalfFOV + y;
+        BoxDepth[i] = z;
+
+        const float Depth = (i & 4) ? zFar : zNear;
+        const float Half = Depth * TanHalfFOV;
+        const Vector3f p = LightPos + N * Depth + U * ((i & 1) ? Half : -Half) + V * ((i & 2) ? Half : -Half);
+
+        PyramidDist[i][0] = p.x - Box.Min.x;
+        PyramidDist[i][1] = Box.Max.x - p.x;
+        PyramidDist[i][2] = p.y - Box.Min.y;
+        PyramidDist[i][3] = Box.Max.y - p.y;
+        PyramidDist[i][4] = p.z - Box.Min.z;
+        PyramidDist[i][5] = Box.Max.z - p.z;
+        PyramidDepth[i] = Depth;
+    }
+
+    float Nearest = zFar;
+
+    // both corner sets are numbered the same way, the edges join corners that
+    // differ in a single bit
+    for (unsigned int i = 0; i < 8; i++) {
+        for (unsigned int Bit = 1; Bit < 8; Bit <<= 1) {
+            if (i & Bit) continue;
+
+            const unsigned int j = i | Bit;
+            float t0, t1;
+
+            if (ClipSegment(BoxDist[i], BoxDist[j], 6, t0, t1)) {
+                Nearest = fminf(Nearest, BoxDepth[i] + (BoxDepth[j] - BoxDepth[i]) * t0);
+                Nearest = fminf(Nearest, BoxDepth[i] + (BoxDepth[j] - BoxDepth[i]) * t1);
+            }
+
+            if (ClipSegment(PyramidDist[i], PyramidDist[j], 6, t0, t1)) {
+                Nearest = fminf(Nearest, PyramidDepth[i] + (PyramidDepth[j] - PyramidDepth[i]) * t0);
+                Nearest = fminf(Nearest, PyramidDepth[i] + (PyramidDepth[j] - PyramidDepth[i]) * t1);
+            }
+        }
+    }
+
+    return Nearest;
+}
+
+// Tightens the spot light projection to what can actually be seen. The
+// casters are given by their world space boxes and the receivers are the
+// part of the scene inside the camera frustum; the FOV only has to cover
+// them (never more than the cone) and the depth range runs from the nearest
+// caster in front of the light and inside the fitted FOV to the farthest
+// receiver. The FOV and depth range move in coarse steps so the projection,
+// and with it the shadow texels, stays put while the camera moves a little.
+inline SpotShadowFrustum FitSpotShadowFrustum(const Vector3f& LightPos, const Vector3f& LightDirection, float Cutoff,
+    float Range, const BoundingBox* pCasterBounds, unsigned int NumCasters, const Vector3f CameraCorners[8])
+{
+    const float MIN_NEAR = 0.1f;
+    const unsigned int FOV_STEPS = 16;
+
+    Vector3f N = LightDirection;
+    N.Normalize();
+    Vector3f Up = fabsf(N.y) > 0.99f ? Vector3f(1.0f, 0.0f, 0.0f) : Vector3f(0.0f, 1.0f, 0.0f);
+    Vector3f U = Up.Cross(N);
+    U.Normalize();
+    Vector3f V = N.Cross(U);
+
+    SpotShadowFrustum Ret = GetSpotConeFrustum(Cutoff, Range);
+    const float TanCone = tanf(glm::radians(Ret.FOV / 2.0f));
+
+    BoundingBox SceneBounds;
+    for (unsigned int i = 0; i < NumCasters; i++) {
+        SceneBounds.AddBox(pCasterBounds[i]);
+    }
+
+    BoundingBox Receivers;
+    for (unsigned int i = 0; i < 8; i++) {
+        Receivers.AddPoint(CameraCorners[i]);
+    }
+    Receivers.Intersect(SceneBounds);
+
+    if (Receivers.IsEmpty()) return Ret;
+
+    float TanHalfFOV = 0.0f;
+    float zFar = 0.0f;
+
+    for (unsigned int i = 0; i < 8; i++) {
+        const Vector3f d = Receivers.GetCorner(i) - LightPos;
+        const float x = d.x * U.x + d.y * U.y + d.z * U.z;
+        const float y = d.x * V.x + d.y * V.y + d.z * V.z;
+        const float z = d.x * N.x + d.y * N.y + d.z * N.z;
+
+        // a corner beside or behind the light can't be bounded by a narrower cone
+        TanHalfFOV = (z > MIN_NEAR) ? fmaxf(TanHalfFOV, fmaxf(fabsf(x), fabsf(y)) / z) : TanCone;
+        zFar = fmaxf(zFar, z);
+    }
+
+    if (zFar <= MIN_NEAR) return Ret;
+
+    const float Step = TanCone / FOV_STEPS;
+    TanHalfFOV = fminf(ceilf(TanHalfFOV / Step) * Step, TanCone);
+
+    Ret.FOV = 2.0f * glm::degrees(atanf(TanHalfFOV));
+    Ret.zFar = fminf(ceilf(zFar), Range);
+
+    // every receiver is a caster as well. The casters are clipped one by one,
+    // their union usually holds the light itself.
+    float zNear = Ret.zFar;
+    for (unsigned int i = 0; i < NumCasters; i++) {
+        zNear = fminf(zNear, CalcNearestDepth(LightPos, U, V, N, TanHalfFOV, MIN_NEAR, Ret.zFar, pCasterBounds[i]));
+    }
+
+    Ret.zNear = fmaxf(floorf(zNear), MIN_NEAR);
+
+    if (Ret.zNear >= Ret.zFar) Ret.zNear = MIN_NEAR;
+
+    return Ret;
+}
+
+#endif	/* SPOT_FRUSTUM_H */
@@ -134,6 +134,21 @@ protected:
 
         return Location;
     }
+
+    bool BindUniformBlock(const char* pBlockName, GLuint BindingPoint)
+    {
+        GLuint BlockIndex = glGetUniformBlockIndex(ShaderProgram, pBlockName);
+
+        if (BlockIndex == GL_INVALID_INDEX)
+        {
+            fprintf(stderr, "Warning! Unable to get the index of uniform block '%s'\n", pBlockName);
+            return false;
+        }
+
+        glUniformBlockBinding(ShaderProgram, BlockIndex, BindingPoint);
+
+        return true;
+    }
 };
 
 #endif /* TEXHNIQUE_H */
\ No newline at end of file
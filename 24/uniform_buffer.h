@@ -0,0 +1,60 @@
+#ifndef UNIFORM_BUFFER_H
+#define	UNIFORM_BUFFER_H
+
+#include <GL/glew.h>
+#include <stdio.h>
+#include <assert.h>
+
+// Uniform buffer object which stays attached to a fixed binding point. Every
+// program that binds a block to the same point reads from this storage.
+class UniformBuffer
+{
+public:
+    UniformBuffer()
+    {
+        ubo = 0;
+        size = 0;
+    }
+
+    ~UniformBuffer()
+    {
+        if (ubo != 0) glDeleteBuffers(1, &ubo);
+    }
+
+    bool Init(GLuint BindingPoint, unsigned int Size)
+    {
+        size = Size;
+
+        glGenBuffers(1, &ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        glBindBufferBase(GL_UNIFORM_BUFFER, BindingPoint, ubo);
+
+        GLenum Error = glGetError();
+
+        if (Error != GL_NO_ERROR)
+        {
+            fprintf(stderr, "Error creating uniform buffer for binding %u: 0x%x\n", BindingPoint, Error);
+            return false;
+        }
+
+        return true;
+    }
+
+    void Update(const void* pData, unsigned int Size)
+    {
+        assert(Size <= size);
+
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, Size, pData);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+private:
+    GLuint ubo;
+    unsigned int size;
+};
+
+#endif	/* UNIFORM_BUFFER_H */
@@ -1,8 +1,16 @@
 #include <iostream>
+#include <string.h>
+#include <thread>
+#include <functional>
 #include "cubemap_texture.h"
 #include "util.h"
 #include "cubemap_texture.h"
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define CUBEMAP_SH_SSE
+#include <xmmintrin.h>
+#endif
+
 static const GLenum types[6] = {  GL_TEXTURE_CUBE_MAP_POSITIVE_X,
                                   GL_TEXTURE_CUBE_MAP_NEGATIVE_X,
                                   GL_TEXTURE_CUBE_MAP_POSITIVE_Y,
@@ -10,6 +18,157 @@ static const GLenum types[6] = {  GL_TEXTURE_CUBE_MAP_POSITIVE_X,
                                   GL_TEXTURE_CUBE_MAP_POSITIVE_Z,
                                   GL_TEXTURE_CUBE_MAP_NEGATIVE_Z };
 
+// Direction of the texel at (s, t) in [-1, 1] is s * S + t * T + M, following
+// the face selection rules of the GL spec. The first row of an image is t = -1.
+static const float FaceAxes[6][3][3] = { { {  0.0f,  0.0f, -1.0f }, { 0.0f, -1.0f,  0.0f }, {  1.0f,  0.0f,  0.0f } },
+                                         { {  0.0f,  0.0f,  1.0f }, { 0.0f, -1.0f,  0.0f }, { -1.0f,  0.0f,  0.0f } },
+                                         { {  1.0f,  0.0f,  0.0f }, { 0.0f,  0.0f,  1.0f }, {  0.0f,  1.0f,  0.0f } },
+                                         { {  1.0f,  0.0f,  0.0f }, { 0.0f,  0.0f, -1.0f }, {  0.0f, -1.0f,  0.0f } },
+                                         { {  1.0f,  0.0f,  0.0f }, { 0.0f, -1.0f,  0.0f }, {  0.0f,  0.0f,  1.0f } },
+                                         { { -1.0f,  0.0f,  0.0f }, { 0.0f, -1.0f,  0.0f }, {  0.0f,  0.0f, -1.0f } } };
+
+// Squared normalization constant of every basis function times the cosine
+// lobe factor of its band (pi, 2pi/3, pi/4) over pi. Turns projected radiance
+// into the irradiance polynomial of GetAmbientSH().
+static const float SHIrradianceFactors[NUM_SH_COEFFICIENTS] = { 0.282095f * 0.282095f,
+                                                                0.488603f * 0.488603f * 2.0f / 3.0f,
+                                                                0.488603f * 0.488603f * 2.0f / 3.0f,
+                                                                0.488603f * 0.488603f * 2.0f / 3.0f,
+                                                                1.092548f * 1.092548f * 0.25f,
+                                                                1.092548f * 1.092548f * 0.25f,
+                                                                0.315392f * 0.315392f * 0.25f,
+                                                                1.092548f * 1.092548f * 0.25f,
+                                                                0.546274f * 0.546274f * 0.25f };
+
+// Texel colors times basis polynomial and solid angle, summed over a face
+struct SHSums
+{
+    float Color[NUM_SH_COEFFICIENTS][3];
+    float Weight;
+};
+
+
+// The solid angle of a texel is proportional to 1 / |Dir|^3 for the
+// unnormalized direction on the unit cube
+static void AddTexelSH(float x, float y, float z, const unsigned char* pPixel, SHSums& Sums)
+{
+    const float InvLength = 1.0f / sqrtf(x * x + y * y + z * z);
+    const float Weight = InvLength * InvLength * InvLength;
+
+    x *= InvLength;
+    y *= InvLength;
+    z *= InvLength;
+
+    const float Basis[NUM_SH_COEFFICIENTS] = { 1.0f, y, z, x, x * y, y * z, 3.0f * z * z - 1.0f, x * z, x * x - y * y };
+
+    for (unsigned int i = 0 ; i < NUM_SH_COEFFICIENTS ; i++) {
+        for (unsigned int c = 0 ; c < 3 ; c++) {
+            Sums.Color[i][c] += Basis[i] * Weight * pPixel[c];
+        }
+    }
+
+    Sums.Weight += Weight;
+}
+
+
+// Runs on its own thread for every face. The pixels are RGBA bytes.
+static void ProjectFaceSH(unsigned int Face, const unsigned char* pPixels, unsigned int Width, unsigned int Height,
+                          SHSums& Sums)
+{
+    const float (&Axes)[3][3] = FaceAxes[Face];
+    const float InvWidth = 2.0f / Width;
+
+    memset(&Sums, 0, sizeof(Sums));
+
+#ifdef CUBEMAP_SH_SSE
+    __m128 Acc[NUM_SH_COEFFICIENTS][3];
+    __m128 AccWeight = _mm_setzero_ps();
+
+    for (unsigned int i = 0 ; i < NUM_SH_COEFFICIENTS ; i++) {
+        Acc[i][0] = Acc[i][1] = Acc[i][2] = _mm_setzero_ps();
+    }
+
+    const __m128 One = _mm_set1_ps(1.0f);
+    const __m128 Three = _mm_set1_ps(3.0f);
+    const __m128 SX = _mm_set1_ps(Axes[0][0]);
+    const __m128 SY = _mm_set1_ps(Axes[0][1]);
+    const __m128 SZ = _mm_set1_ps(Axes[0][2]);
+#endif
+
+    for (unsigned int y = 0 ; y < Height ; y++) {
+        // Everything but s is constant along a row
+        const float t = (y + 0.5f) * 2.0f / Height - 1.0f;
+        const float RowX = t * Axes[1][0] + Axes[2][0];
+        const float RowY = t * Axes[1][1] + Axes[2][1];
+        const float RowZ = t * Axes[1][2] + Axes[2][2];
+        const unsigned char* pRow = pPixels + y * Width * 4;
+        unsigned int x = 0;
+
+#ifdef CUBEMAP_SH_SSE
+        // Four texels of the row at a time
+        const __m128 DirX = _mm_set1_ps(RowX);
+        const __m128 DirY = _mm_set1_ps(RowY);
+        const __m128 DirZ = _mm_set1_ps(RowZ);
+
+        for ( ; x + 4 <= Width ; x += 4) {
+            const __m128 s = _mm_sub_ps(_mm_mul_ps(_mm_set_ps(x + 3.5f, x + 2.5f, x + 1.5f, x + 0.5f),
+                                                   _mm_set1_ps(InvWidth)), One);
+            __m128 dx = _mm_add_ps(DirX, _mm_mul_ps(s, SX));
+            __m128 dy = _mm_add_ps(DirY, _mm_mul_ps(s, SY));
+            __m128 dz = _mm_add_ps(DirZ, _mm_mul_ps(s, SZ));
+
+            const __m128 InvLength = _mm_div_ps(One, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx),
+                                                                                      _mm_mul_ps(dy, dy)),
+                                                                           _mm_mul_ps(dz, dz))));
+            const __m128 Weight = _mm_mul_ps(_mm_mul_ps(InvLength, InvLength), InvLength);
+
+            dx = _mm_mul_ps(dx, InvLength);
+            dy = _mm_mul_ps(dy, InvLength);
+            dz = _mm_mul_ps(dz, InvLength);
+
+            const __m128 Basis[NUM_SH_COEFFICIENTS] = { One, dy, dz, dx,
+                                                        _mm_mul_ps(dx, dy),
+                                                        _mm_mul_ps(dy, dz),
+                                                        _mm_sub_ps(_mm_mul_ps(Three, _mm_mul_ps(dz, dz)), One),
+                                                        _mm_mul_ps(dx, dz),
+                                                        _mm_sub_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)) };
+
+            const unsigned char* p = pRow + x * 4;
+            const __m128 Color[3] = { _mm_mul_ps(_mm_set_ps(p[12], p[8], p[4], p[0]), Weight),
+                                      _mm_mul_ps(_mm_set_ps(p[13], p[9], p[5], p[1]), Weight),
+                                      _mm_mul_ps(_mm_set_ps(p[14], p[10], p[6], p[2]), Weight) };
+
+            for (unsigned int i = 0 ; i < NUM_SH_COEFFICIENTS ; i++) {
+                for (unsigned int c = 0 ; c < 3 ; c++) {
+                    Acc[i][c] = _mm_add_ps(Acc[i][c], _mm_mul_ps(Basis[i], Color[c]));
+                }
+            }
+
+            AccWeight = _mm_add_ps(AccWeight, Weight);
+        }
+#endif
+
+        for ( ; x < Width ; x++) {
+            const float s = (x + 0.5f) * InvWidth - 1.0f;
+            AddTexelSH(RowX + s * Axes[0][0], RowY + s * Axes[0][1], RowZ + s * Axes[0][2], pRow + x * 4, Sums);
+        }
+    }
+
+#ifdef CUBEMAP_SH_SSE
+    float Lanes[4];
+
+    for (unsigned int i = 0 ; i < NUM_SH_COEFFICIENTS ; i++) {
+        for (unsigned int c = 0 ; c < 3 ; c++) {
+            _mm_storeu_ps(Lanes, Acc[i][c]);
+            Sums.Color[i][c] += Lanes[0] + Lanes[1] + Lanes[2] + Lanes[3];
+        }
+    }
+
+    _mm_storeu_ps(Lanes, AccWeight);
+    Sums.Weight += Lanes[0] + Lanes[1] + Lanes[2] + Lanes[3];
+#endif
+}
+
 
 CubemapTexture::CubemapTexture(const string& Directory,
                                const string& PosXFilename,
@@ -27,6 +186,19 @@ CubemapTexture::CubemapTexture(const string& Directory,
     m_fileNames[5] = NegZFilename;
     
     m_textureObj = 0;
+
+    for (unsigned int i = 0 ; i < NUM_SH_COEFFICIENTS ; i++) {
+        m_ambientSH[i] = Vector3f(0.0f, 0.0f, 0.0f);
+    }
+}
+
+CubemapTexture::CubemapTexture()
+{
+    m_textureObj = 0;
+
+    for (unsigned int i = 0 ; i < NUM_SH_COEFFICIENTS ; i++) {
+        m_ambientSH[i] = Vector3f(0.0f, 0.0f, 0.0f);
+    }
 }
 
 CubemapTexture::~CubemapTexture()
@@ -42,10 +214,13 @@ bool CubemapTexture::Load()
     glBindTexture(GL_TEXTURE_CUBE_MAP, m_textureObj);
 
     Magick::Image* pImage = NULL;
-    Magick::Blob blob;
+    Magick::Blob blobs[ARRAY_SIZE_IN_ELEMENTS(types)];
+    unsigned int widths[ARRAY_SIZE_IN_ELEMENTS(types)];
+    unsigned int heights[ARRAY_SIZE_IN_ELEMENTS(types)];
 
     for (unsigned int i = 0 ; i < ARRAY_SIZE_IN_ELEMENTS(types) ; i++) {
         pImage = new Magick::Image(m_fileNames[i]);
+        Magick::Blob& blob = blobs[i];
         
         try {            
             pImage->write(&blob, "RGBA");
@@ -57,6 +232,9 @@ bool CubemapTexture::Load()
         }
 
         glTexImage2D(types[i], 0, GL_RGB, pImage->columns(), pImage->rows(), 0, GL_RGBA, GL_UNSIGNED_BYTE, blob.data());
+
+        widths[i] = pImage->columns();
+        heights[i] = pImage->rows();
         
         delete pImage;
     }    
@@ -66,10 +244,97 @@ bool CubemapTexture::Load()
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);           
+
+    ProjectSH(blobs, widths, heights);
     
     return true;
 }
 
+
+// Projects the decoded faces onto the SH basis, one thread per face, and
+// convolves the result with the cosine lobe
+void CubemapTexture::ProjectSH(const Magick::Blob* pFaces, const unsigned int* pWidths, const unsigned int* pHeights)
+{
+    SHSums FaceSums[ARRAY_SIZE_IN_ELEMENTS(types)];
+    thread Workers[ARRAY_SIZE_IN_ELEMENTS(types)];
+
+    for (unsigned int i = 0 ; i < ARRAY_SIZE_IN_ELEMENTS(types) ; i++) {
+        if (pFaces[i].length() < (size_t)pWidths[i] * pHeights[i] * 4) {
+            memset(&FaceSums[i], 0, sizeof(FaceSums[i]));
+            continue;
+        }
+
+        Workers[i] = thread(ProjectFaceSH, i, (const unsigned char*)pFaces[i].data(), pWidths[i], pHeights[i],
+                            ref(FaceSums[i]));
+    }
+
+    float Weight = 0.0f;
+
+    for (unsigned int i = 0 ; i < ARRAY_SIZE_IN_ELEMENTS(types) ; i++) {
+        if (Workers[i].joinable()) {
+            Workers[i].join();
+        }
+
+        Weight += FaceSums[i].Weight;
+    }
+
+    if (Weight <= 0.0f) {
+        return;
+    }
+
+    // The weights add up to the full sphere and the colors are bytes
+    const float Scale = 4.0f * (float)M_PI / (Weight * 255.0f);
+
+    for (unsigned int i = 0 ; i < NUM_SH_COEFFICIENTS ; i++) {
+        float Sum[3] = { 0.0f, 0.0f, 0.0f };
+
+        for (unsigned int Face = 0 ; Face < ARRAY_SIZE_IN_ELEMENTS(types) ; Face++) {
+            for (unsigned int c = 0 ; c < 3 ; c++) {
+                Sum[c] += FaceSums[Face].Color[i][c];
+            }
+        }
+
+        m_ambientSH[i] = Vector3f(Sum[0], Sum[1], Sum[2]) * (Scale * SHIrradianceFactors[i]);
+    }
+}
+
+
+bool CubemapTexture::InitRenderTarget(unsigned int Size)
+{
+    // Drop the errors of earlier calls, only the allocation below is checked
+    while (glGetError() != GL_NO_ERROR) {
+    }
+
+    if (m_textureObj == 0) {
+        glGenTextures(1, &m_textureObj);
+    }
+
+    glBindTexture(GL_TEXTURE_CUBE_MAP, m_textureObj);
+
+    for (unsigned int i = 0 ; i < ARRAY_SIZE_IN_ELEMENTS(types) ; i++) {
+        glTexImage2D(types[i], 0, GL_RGBA8, Size, Size, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    }
+
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+    return glGetError() == GL_NO_ERROR;
+}
+
+
+void CubemapTexture::GenerateMipmaps()
+{
+    glBindTexture(GL_TEXTURE_CUBE_MAP, m_textureObj);
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+}
+
     
 void CubemapTexture::Bind(GLenum TextureUnit)
 {
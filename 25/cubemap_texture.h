@@ -5,8 +5,13 @@
 #include <GL/glew.h>
 #include <Magick++.h>
 
+#include "math_3d.h"
+
 using namespace std;
 
+// Second order spherical harmonics, bands 0 to 2
+#define NUM_SH_COEFFICIENTS 9
+
 //implementation of cube texture, interface of load and use
 class CubemapTexture
 {
@@ -20,16 +25,41 @@ public:
                    const string& PosZFilename,
                    const string& NegZFilename);
 
+    // Cubemap without files, to be filled by InitRenderTarget()
+    CubemapTexture();
+
     ~CubemapTexture();
     
     bool Load();
 
+    // Allocates empty RGBA faces of Size x Size with a full mip chain for
+    // rendering into. The faces are attached through GetTextureObj().
+    bool InitRenderTarget(unsigned int Size);
+
+    void GenerateMipmaps();
+
+    GLuint GetTextureObj() const
+    {
+        return m_textureObj;
+    }
+
     void Bind(GLenum TextureUnit);
 
+    // Irradiance of the cubemap divided by pi, i.e. the light a white
+    // lambertian surface reflects, as polynomial coefficients in the normal:
+    // 1, y, z, x, xy, yz, 3z^2 - 1, xz, x^2 - y^2. Valid after Load().
+    const Vector3f* GetAmbientSH() const
+    {
+        return m_ambientSH;
+    }
+
 private:
+
+    void ProjectSH(const Magick::Blob* pFaces, const unsigned int* pWidths, const unsigned int* pHeights);
    
     string m_fileNames[6];
     GLuint m_textureObj;
+    Vector3f m_ambientSH[NUM_SH_COEFFICIENTS];
 };
 
 #endif	/* CUBEMAP_H */
@@ -0,0 +1,159 @@
+#include <stdio.h>
+
+#include "environment_probe.h"
+#include "util.h"
+
+// Looking direction and up vector of every face, in the order of
+// GL_TEXTURE_CUBE_MAP_POSITIVE_X and on
+static const Vector3f FaceTargets[6] = { Vector3f( 1.0f,  0.0f,  0.0f),
+                                         Vector3f(-1.0f,  0.0f,  0.0f),
+                                         Vector3f( 0.0f,  1.0f,  0.0f),
+                                         Vector3f( 0.0f, -1.0f,  0.0f),
+                                         Vector3f( 0.0f,  0.0f,  1.0f),
+                                         Vector3f( 0.0f,  0.0f, -1.0f) };
+
+static const Vector3f FaceUps[6] = { Vector3f(0.0f, -1.0f,  0.0f),
+                                     Vector3f(0.0f, -1.0f,  0.0f),
+                                     Vector3f(0.0f,  0.0f,  1.0f),
+                                     Vector3f(0.0f,  0.0f, -1.0f),
+                                     Vector3f(0.0f, -1.0f,  0.0f),
+                                     Vector3f(0.0f, -1.0f,  0.0f) };
+
+
+EnvironmentProbe::EnvironmentProbe()
+{
+    m_fbo = 0;
+    m_depthBuffer = 0;
+    m_size = 0;
+    m_facesPerFrame = 1;
+    m_nextFace = 0;
+    m_needsFullUpdate = true;
+    m_pos = Vector3f(0.0f, 0.0f, 0.0f);
+}
+
+
+EnvironmentProbe::~EnvironmentProbe()
+{
+    if (m_fbo != 0) {
+        glDeleteFramebuffers(1, &m_fbo);
+    }
+
+    if (m_depthBuffer != 0) {
+        glDeleteRenderbuffers(1, &m_depthBuffer);
+    }
+}
+
+
+bool EnvironmentProbe::Init(unsigned int Size, unsigned int FacesPerFrame)
+{
+    m_size = Size;
+    SetFacesPerFrame(FacesPerFrame);
+
+    if (!m_cubemap.InitRenderTarget(Size)) {
+        return false;
+    }
+
+    // Global state, not per texture: the small mips of the probe are filtered
+    // across the face edges
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+    glGenRenderbuffers(1, &m_depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, Size, Size);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &m_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X,
+                           m_cubemap.GetTextureObj(), 0);
+
+    GLenum Status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (Status != GL_FRAMEBUFFER_COMPLETE) {
+        printf("Environment probe FB error, status: 0x%x\n", Status);
+        return false;
+    }
+
+    m_needsFullUpdate = true;
+
+    return true;
+}
+
+
+void EnvironmentProbe::SetPosition(const Vector3f& Pos)
+{
+    m_pos = Pos;
+}
+
+
+void EnvironmentProbe::SetFacesPerFrame(unsigned int FacesPerFrame)
+{
+    m_facesPerFrame = FacesPerFrame < 1 ? 1 : (FacesPerFrame > 6 ? 6 : FacesPerFrame);
+}
+
+
+unsigned int EnvironmentProbe::ScheduleFaces(unsigned int* pFaces)
+{
+    const unsigned int NumFaces = m_needsFullUpdate ? 6 : m_facesPerFrame;
+
+    for (unsigned int i = 0 ; i < NumFaces ; i++) {
+        pFaces[i] = m_nextFace;
+        m_nextFace = (m_nextFace + 1) % 6;
+    }
+
+    m_needsFullUpdate = false;
+
+    return NumFaces;
+}
+
+
+void EnvironmentProbe::BindForWriting(unsigned int Face)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + Face,
+                           m_cubemap.GetTextureObj(), 0);
+    glViewport(0, 0, m_size, m_size);
+}
+
+
+void EnvironmentProbe::EndUpdate()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    m_cubemap.GenerateMipmaps();
+}
+
+
+Matrix4f EnvironmentProbe::GetFaceViewProj(unsigned int Face, float zNear, float zFar) const
+{
+    PersProjInfo ProjInfo;
+    ProjInfo.FOV = 90.0f;
+    ProjInfo.Width = (float)m_size;
+    ProjInfo.Height = (float)m_size;
+    ProjInfo.zNear = zNear;
+    ProjInfo.zFar = zFar;
+
+    Matrix4f Mirror, PersProjTrans, CameraRotateTrans, CameraTranslationTrans;
+
+    Mirror.InitScaleTransform(-1.0f, 1.0f, 1.0f);
+    PersProjTrans.InitPersProjTransform(ProjInfo);
+    CameraRotateTrans.InitCameraTransform(FaceTargets[Face], FaceUps[Face]);
+    CameraTranslationTrans.InitTranslationTransform(-m_pos.x, -m_pos.y, -m_pos.z);
+
+    return Mirror * PersProjTrans * CameraRotateTrans * CameraTranslationTrans;
+}
+
+
+void EnvironmentProbe::Bind(GLenum TextureUnit)
+{
+    m_cubemap.Bind(TextureUnit);
+}
+
+
+void EnvironmentProbe::Unbind(GLenum TextureUnit)
+{
+    glActiveTexture(TextureUnit);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+}
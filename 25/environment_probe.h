@@ -0,0 +1,68 @@
+#ifndef ENVIRONMENT_PROBE_H
+#define	ENVIRONMENT_PROBE_H
+
+#include <GL/glew.h>
+
+#include "math_3d.h"
+#include "cubemap_texture.h"
+
+// Captures the scene around a point into a cubemap for reflections. Only a
+// few faces are rendered per frame, in turn, so a full update is spread over
+// several frames. The faces are small and mipmapped after every update, which
+// keeps the reflection from shimmering on curved surfaces.
+class EnvironmentProbe
+{
+public:
+
+    EnvironmentProbe();
+
+    ~EnvironmentProbe();
+
+    bool Init(unsigned int Size, unsigned int FacesPerFrame);
+
+    void SetPosition(const Vector3f& Pos);
+
+    const Vector3f& GetPosition() const
+    {
+        return m_pos;
+    }
+
+    void SetFacesPerFrame(unsigned int FacesPerFrame);
+
+    unsigned int GetFacesPerFrame() const
+    {
+        return m_facesPerFrame;
+    }
+
+    // Fills pFaces with the faces due this frame and returns their number.
+    // All six are due right after Init().
+    unsigned int ScheduleFaces(unsigned int* pFaces);
+
+    void BindForWriting(unsigned int Face);
+
+    // Restores the default framebuffer and rebuilds the mips
+    void EndUpdate();
+
+    // View projection of a face. It mirrors x to match the cubemap face
+    // layout, so the winding of the front faces flips while rendering.
+    Matrix4f GetFaceViewProj(unsigned int Face, float zNear, float zFar) const;
+
+    void Bind(GLenum TextureUnit);
+
+    // Leaves no cubemap on the unit. Needed while capturing, since sampling
+    // the cubemap being rendered into is a feedback loop.
+    void Unbind(GLenum TextureUnit);
+
+private:
+
+    CubemapTexture m_cubemap;
+    GLuint m_fbo;
+    GLuint m_depthBuffer;
+    unsigned int m_size;
+    unsigned int m_facesPerFrame;
+    unsigned int m_nextFace;
+    bool m_needsFullUpdate;
+    Vector3f m_pos;
+};
+
+#endif	/* ENVIRONMENT_PROBE_H */
@@ -0,0 +1,422 @@
+#include <math.h>
+#include <float.h>
+#include <string.h>
+
+#include "light_manager.h"
+
+// Attenuated intensity below which a light no longer counts
+#define LIGHT_CUTOFF 256.0f
+
+// Lights which would cover more cells than this along an axis are kept in the
+// global list instead of the grid
+#define MAX_CELLS_PER_LIGHT 16
+
+static float MaxChannel(const Vector3f& Color)
+{
+    float Max = Color.x;
+
+    if (Color.y > Max) Max = Color.y;
+    if (Color.z > Max) Max = Color.z;
+
+    return Max;
+}
+
+
+static float CalcLightRange(const PointLight& Light)
+{
+    // Solve Exp * d^2 + Linear * d + Constant = Intensity * LIGHT_CUTOFF
+    const float c = Light.Attenuation.Constant -
+                    MaxChannel(Light.Color) * (Light.DiffuseIntensity + Light.AmbientIntensity) * LIGHT_CUTOFF;
+
+    if (c >= 0.0f) {
+        return 0.0f;
+    }
+
+    if (Light.Attenuation.Exp > 0.0f) {
+        const float a = Light.Attenuation.Exp;
+        const float b = Light.Attenuation.Linear;
+        return (-b + sqrtf(b * b - 4.0f * a * c)) / (2.0f * a);
+    }
+
+    if (Light.Attenuation.Linear > 0.0f) {
+        return -c / Light.Attenuation.Linear;
+    }
+
+    return FLT_MAX;
+}
+
+
+// Keeps the Max highest scores in descending order
+static void InsertByScore(float Score, unsigned int Entry, float* pScores, unsigned int* pEntries,
+                          unsigned int& Count, unsigned int Max)
+{
+    if (Count == Max && Score <= pScores[Max - 1]) {
+        return;
+    }
+
+    unsigned int i = Count < Max ? Count++ : Max - 1;
+
+    for ( ; i > 0 && pScores[i - 1] < Score ; i--) {
+        pScores[i] = pScores[i - 1];
+        pEntries[i] = pEntries[i - 1];
+    }
+
+    pScores[i] = Score;
+    pEntries[i] = Entry;
+}
+
+
+LightManager::LightManager()
+{
+    m_cellSize = 10.0f;
+    m_globalChange = 0;
+    m_changeCounter = 1;
+    m_queryCounter = 0;
+
+    ResetStats();
+}
+
+
+void LightManager::Init(float CellSize)
+{
+    m_cellSize = CellSize;
+
+    m_cells.clear();
+    m_pointLights.clear();
+    m_spotLights.clear();
+    m_pointEntries.clear();
+    m_spotEntries.clear();
+    m_entries.clear();
+    m_globalLights.clear();
+    m_objects.clear();
+
+    m_globalChange = 0;
+    m_changeCounter = 1;
+    m_queryCounter = 0;
+
+    ResetStats();
+}
+
+
+void LightManager::ResetStats()
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+
+unsigned int LightManager::AddPointLight(const PointLight& Light)
+{
+    m_pointLights.push_back(Light);
+    m_pointEntries.push_back(AddLight(false, m_pointLights.size() - 1, Light));
+
+    return m_pointLights.size() - 1;
+}
+
+
+unsigned int LightManager::AddSpotLight(const SpotLight& Light)
+{
+    m_spotLights.push_back(Light);
+    m_spotEntries.push_back(AddLight(true, m_spotLights.size() - 1, Light));
+
+    return m_spotLights.size() - 1;
+}
+
+
+void LightManager::UpdatePointLight(unsigned int Index, const PointLight& Light)
+{
+    m_pointLights[Index] = Light;
+    MoveLight(m_pointEntries[Index], Light);
+}
+
+
+void LightManager::UpdateSpotLight(unsigned int Index, const SpotLight& Light)
+{
+    m_spotLights[Index] = Light;
+    MoveLight(m_spotEntries[Index], Light);
+}
+
+
+unsigned int LightManager::AddObject()
+{
+    ObjectCache Object;
+    Object.Valid = false;
+
+    m_objects.push_back(Object);
+
+    return m_objects.size() - 1;
+}
+
+
+unsigned int LightManager::AddLight(bool IsSpot, unsigned int Index, const PointLight& Light)
+{
+    LightEntry Entry;
+    Entry.IsSpot = IsSpot;
+    Entry.Index = Index;
+    Entry.LastQuery = 0;
+
+    m_entries.push_back(Entry);
+
+    unsigned int EntryIndex = m_entries.size() - 1;
+    PlaceLight(EntryIndex, Light);
+
+    return EntryIndex;
+}
+
+
+void LightManager::MoveLight(unsigned int EntryIndex, const PointLight& Light)
+{
+    RemoveLight(EntryIndex);
+    PlaceLight(EntryIndex, Light);
+}
+
+
+void LightManager::PlaceLight(unsigned int EntryIndex, const PointLight& Light)
+{
+    LightEntry& Entry = m_entries[EntryIndex];
+
+    Entry.Position = Light.Position;
+    Entry.Range = CalcLightRange(Light);
+    Entry.Global = Entry.Range > m_cellSize * MAX_CELLS_PER_LIGHT;
+
+    InsertLight(EntryIndex);
+}
+
+
+void LightManager::InsertLight(unsigned int EntryIndex)
+{
+    LightEntry& Entry = m_entries[EntryIndex];
+
+    m_changeCounter++;
+
+    if (Entry.Global) {
+        m_globalLights.push_back(EntryIndex);
+        m_globalChange = m_changeCounter;
+        return;
+    }
+
+    GetCellRange(Entry.Position, Entry.Range, Entry.Cells);
+
+    for (int z = Entry.Cells.Min[2] ; z <= Entry.Cells.Max[2] ; z++) {
+        for (int y = Entry.Cells.Min[1] ; y <= Entry.Cells.Max[1] ; y++) {
+            for (int x = Entry.Cells.Min[0] ; x <= Entry.Cells.Max[0] ; x++) {
+                Cell& c = m_cells[MakeKey(x, y, z)];
+                c.Lights.push_back(EntryIndex);
+                c.LastChange = m_changeCounter;
+            }
+        }
+    }
+}
+
+
+void LightManager::RemoveLight(unsigned int EntryIndex)
+{
+    const LightEntry& Entry = m_entries[EntryIndex];
+
+    m_changeCounter++;
+
+    if (Entry.Global) {
+        for (unsigned int i = 0 ; i < m_globalLights.size() ; i++) {
+            if (m_globalLights[i] == EntryIndex) {
+                m_globalLights[i] = m_globalLights.back();
+                m_globalLights.pop_back();
+                break;
+            }
+        }
+
+        m_globalChange = m_changeCounter;
+        return;
+    }
+
+    for (int z = Entry.Cells.Min[2] ; z <= Entry.Cells.Max[2] ; z++) {
+        for (int y = Entry.Cells.Min[1] ; y <= Entry.Cells.Max[1] ; y++) {
+            for (int x = Entry.Cells.Min[0] ; x <= Entry.Cells.Max[0] ; x++) {
+                std::map<CellKey, Cell>::iterator it = m_cells.find(MakeKey(x, y, z));
+
+                if (it == m_cells.end()) {
+                    continue;
+                }
+
+                std::vector<unsigned int>& Lights = it->second.Lights;
+
+                for (unsigned int i = 0 ; i < Lights.size() ; i++) {
+                    if (Lights[i] == EntryIndex) {
+                        Lights[i] = Lights.back();
+                        Lights.pop_back();
+                        break;
+                    }
+                }
+
+                it->second.LastChange = m_changeCounter;
+            }
+        }
+    }
+}
+
+
+void LightManager::GetCellRange(const Vector3f& Center, float Radius, CellRange& Range) const
+{
+    const float Min[3] = { Center.x - Radius, Center.y - Radius, Center.z - Radius };
+    const float Max[3] = { Center.x + Radius, Center.y + Radius, Center.z + Radius };
+
+    for (unsigned int i = 0 ; i < 3 ; i++) {
+        Range.Min[i] = (int)floorf(Min[i] / m_cellSize);
+        Range.Max[i] = (int)floorf(Max[i] / m_cellSize);
+    }
+}
+
+
+bool LightManager::CellsChangedSince(const CellRange& Range, unsigned int Stamp) const
+{
+    if (m_globalChange > Stamp) {
+        return true;
+    }
+
+    for (int z = Range.Min[2] ; z <= Range.Max[2] ; z++) {
+        for (int y = Range.Min[1] ; y <= Range.Max[1] ; y++) {
+            for (int x = Range.Min[0] ; x <= Range.Max[0] ; x++) {
+                std::map<CellKey, Cell>::const_iterator it = m_cells.find(MakeKey(x, y, z));
+
+                if (it != m_cells.end() && it->second.LastChange > Stamp) {
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+
+LightManager::CellKey LightManager::MakeKey(int x, int y, int z)
+{
+    // 21 bits per axis is plenty for a scene measured in cells
+    const CellKey Mask = (1ULL << 21) - 1;
+
+    return ((CellKey)x & Mask) | (((CellKey)y & Mask) << 21) | (((CellKey)z & Mask) << 42);
+}
+
+
+float LightManager::CalcInfluence(const LightEntry& Entry, const Vector3f& Center, float Radius) const
+{
+    const PointLight& Light = Entry.IsSpot ? m_spotLights[Entry.Index] : m_pointLights[Entry.Index];
+
+    const Vector3f ToCenter = Center - Entry.Position;
+    const float CenterDistance = sqrtf(ToCenter.x * ToCenter.x + ToCenter.y * ToCenter.y + ToCenter.z * ToCenter.z);
+    const float Distance = CenterDistance > Radius ? CenterDistance - Radius : 0.0f;
+
+    if (Distance > Entry.Range) {
+        return 0.0f;
+    }
+
+    if (Entry.IsSpot && CenterDistance > Radius) {
+        const SpotLight& Spot = m_spotLights[Entry.Index];
+        Vector3f Direction = Spot.Direction;
+        Direction.Normalize();
+
+        // Distance of the center from the surface of the cone
+        const float Along = ToCenter.x * Direction.x + ToCenter.y * Direction.y + ToCenter.z * Direction.z;
+        const float Across = sqrtf(fmaxf(CenterDistance * CenterDistance - Along * Along, 0.0f));
+        const float Angle = ToRadian(Spot.Cutoff);
+
+        if (Along < -Radius || cosf(Angle) * Across - sinf(Angle) * Along > Radius) {
+            return 0.0f;
+        }
+    }
+
+    const float Attenuation = Light.Attenuation.Constant +
+                              Light.Attenuation.Linear * Distance +
+                              Light.Attenuation.Exp * Distance * Distance;
+
+    return MaxChannel(Light.Color) * (Light.DiffuseIntensity + Light.AmbientIntensity) / Attenuation;
+}
+
+
+const LightSelection& LightManager::SelectLights(unsigned int Object, const Vector3f& Center, float Radius)
+{
+    ObjectCache& Cache = m_objects[Object];
+
+    m_stats.Selections++;
+
+    if (Cache.Valid &&
+        Cache.Center.x == Center.x && Cache.Center.y == Center.y && Cache.Center.z == Center.z &&
+        Cache.Radius == Radius &&
+        !CellsChangedSince(Cache.Cells, Cache.Stamp)) {
+        m_stats.CacheHits++;
+        return Cache.Selection;
+    }
+
+    Cache.Valid = true;
+    Cache.Center = Center;
+    Cache.Radius = Radius;
+    Cache.Stamp = m_changeCounter;
+    GetCellRange(Center, Radius, Cache.Cells);
+
+    float PointScores[LightingTechnique::MAX_POINT_LIGHTS];
+    unsigned int PointEntries[LightingTechnique::MAX_POINT_LIGHTS];
+    unsigned int NumPoint = 0;
+    float SpotScores[LightingTechnique::MAX_SPOT_LIGHTS];
+    unsigned int SpotEntries[LightingTechnique::MAX_SPOT_LIGHTS];
+    unsigned int NumSpot = 0;
+
+    // A light spanning several of the object's cells must only be tested once
+    m_queryCounter++;
+
+    std::vector<const std::vector<unsigned int>*> Lists;
+    Lists.push_back(&m_globalLights);
+
+    for (int z = Cache.Cells.Min[2] ; z <= Cache.Cells.Max[2] ; z++) {
+        for (int y = Cache.Cells.Min[1] ; y <= Cache.Cells.Max[1] ; y++) {
+            for (int x = Cache.Cells.Min[0] ; x <= Cache.Cells.Max[0] ; x++) {
+                std::map<CellKey, Cell>::const_iterator it = m_cells.find(MakeKey(x, y, z));
+
+                if (it != m_cells.end()) {
+                    Lists.push_back(&it->second.Lights);
+                }
+            }
+        }
+    }
+
+    for (unsigned int l = 0 ; l < Lists.size() ; l++) {
+        const std::vector<unsigned int>& Lights = *Lists[l];
+
+        for (unsigned int i = 0 ; i < Lights.size() ; i++) {
+            LightEntry& Entry = m_entries[Lights[i]];
+
+            if (Entry.LastQuery == m_queryCounter) {
+                continue;
+            }
+
+            Entry.LastQuery = m_queryCounter;
+            m_stats.LightsTested++;
+
+            const float Score = CalcInfluence(Entry, Center, Radius);
+
+            if (Score <= 0.0f) {
+                continue;
+            }
+
+            if (Entry.IsSpot) {
+                InsertByScore(Score, Entry.Index, SpotScores, SpotEntries, NumSpot, LightingTechnique::MAX_SPOT_LIGHTS);
+            }
+            else {
+                InsertByScore(Score, Entry.Index, PointScores, PointEntries, NumPoint, LightingTechnique::MAX_POINT_LIGHTS);
+            }
+        }
+    }
+
+    LightSelection& Selection = Cache.Selection;
+
+    Selection.NumPointLights = NumPoint;
+
+    for (unsigned int i = 0 ; i < NumPoint ; i++) {
+        Selection.PointLights[i] = m_pointLights[PointEntries[i]];
+    }
+
+    Selection.NumSpotLights = NumSpot;
+
+    for (unsigned int i = 0 ; i < NumSpot ; i++) {
+        Selection.SpotLights[i] = m_spotLights[SpotEntries[i]];
+    }
+
+    return Selection;
+}
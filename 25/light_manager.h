@@ -0,0 +1,138 @@
+#ifndef LIGHT_MANAGER_H
+#define	LIGHT_MANAGER_H
+
+#include <map>
+#include <vector>
+
+#include "math_3d.h"
+#include "lighting_technique.h"
+
+// The lights picked for one object, strongest first
+struct LightSelection
+{
+    unsigned int NumPointLights;
+    PointLight PointLights[LightingTechnique::MAX_POINT_LIGHTS];
+    unsigned int NumSpotLights;
+    SpotLight SpotLights[LightingTechnique::MAX_SPOT_LIGHTS];
+};
+
+struct LightManagerStats
+{
+    unsigned int Selections;
+    unsigned int CacheHits;
+    unsigned int LightsTested;
+};
+
+// Keeps all the point and spot lights of the scene in a uniform grid and
+// picks, per object, the few which the lighting technique can take. A light
+// is stored in every cell its range touches (the range is where the
+// attenuation drops below 1/256) and the object only looks at the cells
+// covered by its bounding sphere. The candidates are ranked by the intensity
+// they deliver at the point of the sphere closest to them.
+//
+// Every cell remembers when a light last entered, left or changed in it. The
+// selection of an object is reused as long as its sphere stays the same and
+// none of its cells changed since the selection was made.
+class LightManager
+{
+public:
+
+    LightManager();
+
+    void Init(float CellSize);
+
+    // The returned index is the one to pass to the update functions
+    unsigned int AddPointLight(const PointLight& Light);
+    unsigned int AddSpotLight(const SpotLight& Light);
+
+    void UpdatePointLight(unsigned int Index, const PointLight& Light);
+    void UpdateSpotLight(unsigned int Index, const SpotLight& Light);
+
+    // Returns the id to pass to SelectLights()
+    unsigned int AddObject();
+
+    const LightSelection& SelectLights(unsigned int Object, const Vector3f& Center, float Radius);
+
+    const LightManagerStats& GetStats() const
+    {
+        return m_stats;
+    }
+
+    void ResetStats();
+
+private:
+
+    struct CellRange
+    {
+        int Min[3];
+        int Max[3];
+    };
+
+    struct LightEntry
+    {
+        bool IsSpot;
+        unsigned int Index;
+        Vector3f Position;
+        float Range;
+        bool Global;
+        CellRange Cells;
+        unsigned int LastQuery;
+    };
+
+    struct Cell
+    {
+        Cell()
+        {
+            LastChange = 0;
+        }
+
+        std::vector<unsigned int> Lights;
+        unsigned int LastChange;
+    };
+
+    struct ObjectCache
+    {
+        bool Valid;
+        Vector3f Center;
+        float Radius;
+        unsigned int Stamp;
+        CellRange Cells;
+        LightSelection Selection;
+    };
+
+    typedef unsigned long long CellKey;
+
+    unsigned int AddLight(bool IsSpot, unsigned int Index, const PointLight& Light);
+    void MoveLight(unsigned int Entry, const PointLight& Light);
+    void PlaceLight(unsigned int Entry, const PointLight& Light);
+    void InsertLight(unsigned int Entry);
+    void RemoveLight(unsigned int Entry);
+    void GetCellRange(const Vector3f& Center, float Radius, CellRange& Range) const;
+    bool CellsChangedSince(const CellRange& Range, unsigned int Stamp) const;
+    float CalcInfluence(const LightEntry& Entry, const Vector3f& Center, float Radius) const;
+
+    static CellKey MakeKey(int x, int y, int z);
+
+    float m_cellSize;
+    std::map<CellKey, Cell> m_cells;
+
+    std::vector<PointLight> m_pointLights;
+    std::vector<SpotLight> m_spotLights;
+    std::vector<unsigned int> m_pointEntries;
+    std::vector<unsigned int> m_spotEntries;
+    std::vector<LightEntry> m_entries;
+
+    // Lights without a finite range are candidates for every object
+    std::vector<unsigned int> m_globalLights;
+    unsigned int m_globalChange;
+
+    std::vector<ObjectCache> m_objects;
+
+    unsigned int m_changeCounter;
+    unsigned int m_queryCounter;
+
+    LightManagerStats m_stats;
+};
+
+
+#endif	/* LIGHT_MANAGER_H */
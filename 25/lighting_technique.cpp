@@ -86,6 +86,9 @@ uniform sampler2D gShadowMap;
 uniform vec3 gEyeWorldPos;                                                                  \n\
 uniform float gMatSpecularIntensity;                                                        \n\
 uniform float gSpecularPower;                                                               \n\
+uniform vec3 gAmbientSH[9];                                                                 \n\
+uniform samplerCube gEnvironmentMap;                                                        \n\
+uniform float gReflectivity;                                                                \n\
                                                                                             \n\
 float CalcShadowFactor(vec4 LightSpacePos)                                                  \n\
 {                                                                                           \n\
@@ -125,10 +128,27 @@ vec4 CalcLightInternal(BaseLight Light, vec3 LightDirection, vec3 Normal,
     return (AmbientColor + ShadowFactor * (DiffuseColor + SpecularColor));                  \n\
 }                                                                                           \n\
                                                                                             \n\
+// Light reflected by a white lambertian surface under the environment,                     \n\
+// evaluated from the irradiance SH of the skybox                                           \n\
+vec3 CalcAmbientSH(vec3 n)                                                                  \n\
+{                                                                                           \n\
+    return gAmbientSH[0] +                                                                  \n\
+           gAmbientSH[1] * n.y + gAmbientSH[2] * n.z + gAmbientSH[3] * n.x +                \n\
+           gAmbientSH[4] * (n.x * n.y) + gAmbientSH[5] * (n.y * n.z) +                      \n\
+           gAmbientSH[6] * (3.0 * n.z * n.z - 1.0) + gAmbientSH[7] * (n.x * n.z) +          \n\
+           gAmbientSH[8] * (n.x * n.x - n.y * n.y);                                         \n\
+}                                                                                           \n\
+                                                                                            \n\
 vec4 CalcDirectionalLight(vec3 Normal)                                                      \n\
-{                                                                                                \n\
-    return CalcLightInternal(gDirectionalLight.Base, gDirectionalLight.Direction, Normal, 1.0);  \n\
-}                                                                                                \n\
+{                                                                                           \n\
+    BaseLight Light = gDirectionalLight.Base;                                               \n\
+    Light.AmbientIntensity = 0.0;                                                           \n\
+                                                                                            \n\
+    vec4 AmbientColor = vec4(Light.Color * CalcAmbientSH(Normal), 1.0) *                    \n\
+                        gDirectionalLight.Base.AmbientIntensity;                            \n\
+                                                                                            \n\
+    return AmbientColor + CalcLightInternal(Light, gDirectionalLight.Direction, Normal, 1.0);\n\
+}                                                                                           \n\
                                                                                             \n\
 vec4 CalcPointLight(PointLight l, vec3 Normal, vec4 LightSpacePos)                   \n\
 {                                                                                           \n\
@@ -174,6 +194,11 @@ void main()
                                                                                             \n\
     vec4 SampledColor = texture2D(gSampler, TexCoord0.xy);                                  \n\
     FragColor = SampledColor * TotalLight;                                                  \n\
+                                                                                            \n\
+    if (gReflectivity > 0.0) {                                                              \n\
+        vec3 Reflected = reflect(normalize(WorldPos0 - gEyeWorldPos), Normal);              \n\
+        FragColor = mix(FragColor, texture(gEnvironmentMap, Reflected), gReflectivity);     \n\
+    }                                                                                       \n\
 }";
 
 
@@ -214,6 +239,9 @@ bool LightingTechnique::Init()
     m_matSpecularPowerLocation = GetUniformLocation("gSpecularPower");
     m_numPointLightsLocation = GetUniformLocation("gNumPointLights");
     m_numSpotLightsLocation = GetUniformLocation("gNumSpotLights");
+    m_ambientSHLocation = GetUniformLocation("gAmbientSH");
+    m_environmentMapLocation = GetUniformLocation("gEnvironmentMap");
+    m_reflectivityLocation = GetUniformLocation("gReflectivity");
 
     if (m_dirLightLocation.AmbientIntensity == INVALID_UNIFORM_LOCATION ||
         m_WVPLocation == INVALID_UNIFORM_LOCATION ||
@@ -228,7 +256,10 @@ bool LightingTechnique::Init()
         m_matSpecularIntensityLocation == INVALID_UNIFORM_LOCATION ||
         m_matSpecularPowerLocation == INVALID_UNIFORM_LOCATION ||
         m_numPointLightsLocation == INVALID_UNIFORM_LOCATION ||
-        m_numSpotLightsLocation == INVALID_UNIFORM_LOCATION) {
+        m_numSpotLightsLocation == INVALID_UNIFORM_LOCATION ||
+        m_ambientSHLocation == INVALID_UNIFORM_LOCATION ||
+        m_environmentMapLocation == INVALID_UNIFORM_LOCATION ||
+        m_reflectivityLocation == INVALID_UNIFORM_LOCATION) {
         return false;
     }
 
@@ -355,6 +386,24 @@ void LightingTechnique::SetDirectionalLight(const DirectionalLight& Light)
 }
 
 
+void LightingTechnique::SetAmbientSH(const Vector3f* pCoefficients)
+{
+    glUniform3fv(m_ambientSHLocation, NUM_SH_COEFFICIENTS, (const GLfloat*)pCoefficients);
+}
+
+
+void LightingTechnique::SetEnvironmentMapTextureUnit(unsigned int TextureUnit)
+{
+    glUniform1i(m_environmentMapLocation, TextureUnit);
+}
+
+
+void LightingTechnique::SetReflectivity(float Reflectivity)
+{
+    glUniform1f(m_reflectivityLocation, Reflectivity);
+}
+
+
 void LightingTechnique::SetEyeWorldPos(const Vector3f& EyeWorldPos)
 {
     glUniform3f(m_eyeWorldPosLocation, EyeWorldPos.x, EyeWorldPos.y, EyeWorldPos.z);
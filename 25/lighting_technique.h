@@ -3,6 +3,7 @@
 
 #include "technique.h"
 #include "math_3d.h"
+#include "cubemap_texture.h"
 
 struct BaseLight
 {
@@ -76,6 +77,12 @@ public:
     void SetTextureUnit(unsigned int TextureUnit);
     void SetShadowMapTextureUnit(unsigned int TextureUnit);
     void SetDirectionalLight(const DirectionalLight& Light);
+    // NUM_SH_COEFFICIENTS values as returned by CubemapTexture::GetAmbientSH().
+    // They replace the flat ambient term of the directional light.
+    void SetAmbientSH(const Vector3f* pCoefficients);
+    void SetEnvironmentMapTextureUnit(unsigned int TextureUnit);
+    // Share of the environment map reflection in the final color, 0 disables it
+    void SetReflectivity(float Reflectivity);
     void SetPointLights(unsigned int NumLights, const PointLight* pLights);
     void SetSpotLights(unsigned int NumLights, const SpotLight* pLights);
     void SetEyeWorldPos(const Vector3f& EyeWorldPos);
@@ -94,6 +101,9 @@ private:
     GLuint m_matSpecularPowerLocation;
     GLuint m_numPointLightsLocation;
     GLuint m_numSpotLightsLocation;
+    GLuint m_ambientSHLocation;
+    GLuint m_environmentMapLocation;
+    GLuint m_reflectivityLocation;
 
     struct {
         GLuint Color;
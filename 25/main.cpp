@@ -11,10 +11,31 @@
 #include "glut_backend.h"
 #include "mesh.h"
 #include "skybox.h"
+#include "light_manager.h"
+#include "environment_probe.h"
 
 #define WINDOW_WIDTH  1920
 #define WINDOW_HEIGHT 1200
 
+#define NUM_TANKS_X 5
+#define NUM_TANKS_Z 5
+#define NUM_TANKS (NUM_TANKS_X * NUM_TANKS_Z)
+#define TANK_SPACING 8.0f
+
+#define NUM_POINT_LIGHTS_X 6
+#define NUM_POINT_LIGHTS_Z 6
+#define NUM_POINT_LIGHTS (NUM_POINT_LIGHTS_X * NUM_POINT_LIGHTS_Z)
+#define NUM_MOVING_POINT_LIGHTS 4
+#define NUM_SPOT_LIGHTS NUM_TANKS_X
+
+#define LIGHT_GRID_CELL_SIZE 10.0f
+
+// The tank in the middle reflects the rest of the field through a probe
+// at its center, of which a couple of faces are rendered per frame
+#define ENV_PROBE_SIZE 128
+#define ENV_PROBE_FACES_PER_FRAME 2
+#define TANK_REFLECTIVITY 0.5f
+
 
 class Main : public ICallbacks
 {
@@ -27,6 +48,14 @@ public:
         m_pTankMesh = NULL;
         m_scale = 0.0f;
         m_pSkyBox = NULL;
+        m_ambientSHEnabled = true;
+
+        // A constant first coefficient gives back the flat ambient term
+        for (unsigned int i = 0 ; i < NUM_SH_COEFFICIENTS ; i++) {
+            m_flatAmbientSH[i] = Vector3f(0.0f, 0.0f, 0.0f);
+        }
+
+        m_flatAmbientSH[0] = Vector3f(1.0f, 1.0f, 1.0f);
 
         m_dirLight.AmbientIntensity = 0.2f;
         m_dirLight.DiffuseIntensity = 0.8f;
@@ -38,6 +67,10 @@ public:
         m_persProjInfo.Width = WINDOW_WIDTH;
         m_persProjInfo.zNear = 1.0f;
         m_persProjInfo.zFar = 100.0f;        
+
+        for (unsigned int i = 0 ; i < NUM_TANKS ; i++) {
+            m_tankObjects[i] = 0;
+        }
     }
     
     virtual ~Main()
@@ -66,12 +99,33 @@ public:
         m_pLightingTechnique->Enable();
         m_pLightingTechnique->SetDirectionalLight(m_dirLight);
         m_pLightingTechnique->SetTextureUnit(0);
+        m_pLightingTechnique->SetEnvironmentMapTextureUnit(1);
               
         m_pTankMesh = new Mesh();
         
         if (!m_pTankMesh->LoadMesh("C:/Content/phoenix_ugv.md2")) {
             return false;
         }
+
+        m_pTankMesh->GetBoundingSphere(m_tankBoundsCenter, m_tankBoundsRadius);
+
+        if (!m_probe.Init(ENV_PROBE_SIZE, ENV_PROBE_FACES_PER_FRAME)) {
+            return false;
+        }
+
+        // The reflective tank only turns in place
+        Pipeline p;
+        p.Scale(0.1f, 0.1f, 0.1f);
+        p.WorldPos(GetTankPos(NUM_TANKS_X / 2, NUM_TANKS_Z / 2).x,
+                   GetTankPos(NUM_TANKS_X / 2, NUM_TANKS_Z / 2).y,
+                   GetTankPos(NUM_TANKS_X / 2, NUM_TANKS_Z / 2).z);
+
+        Vector3f ProbePos;
+        float ProbeRadius;
+        TransformSphere(p.GetWorldTrans(), m_tankBoundsCenter, m_tankBoundsRadius, ProbePos, ProbeRadius);
+        m_probe.SetPosition(ProbePos);
+
+        InitLights();
         
         m_pSkyBox = new SkyBox(m_pGameCamera, m_persProjInfo);
         
@@ -84,6 +138,9 @@ public:
                              "C:/Content/sp3back.jpg")) {
             return false;
         }
+
+        m_pLightingTechnique->Enable();
+        m_pLightingTechnique->SetAmbientSH(m_pSkyBox->GetCubemapTexture()->GetAmbientSH());
         
         return true;
     }
@@ -99,21 +156,19 @@ public:
     {
         m_pGameCamera->OnRender();
         m_scale += 0.05f;
+
+        UpdateLights();
+
+        CaptureEnvironment();
         
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        m_pLightingTechnique->Enable();
-       
-        Pipeline p;        
-        p.Scale(0.1f, 0.1f, 0.1f);
-        p.Rotate(0.0f, m_scale, 0.0f);
-        p.WorldPos(0.0f, -5.0f, 3.0f);
+        Pipeline p;
         p.SetCamera(m_pGameCamera->GetPos(), m_pGameCamera->GetTarget(), m_pGameCamera->GetUp());
         p.SetPerspectiveProj(m_persProjInfo);
-        
-        m_pLightingTechnique->SetWVP(p.GetWVPTrans());
-        m_pLightingTechnique->SetWorldMatrix(p.GetWorldTrans());
-        m_pTankMesh->Render();
+
+        m_probe.Bind(GL_TEXTURE1);
+        RenderTanks(p.GetWVPTrans(), m_pGameCamera->GetPos(), false);
         
         m_pSkyBox->Render();
       
@@ -121,6 +176,74 @@ public:
     }
 
 
+    // Renders the probe faces due this frame. The reflective tank sits at the
+    // probe and is left out of its own reflection.
+    void CaptureEnvironment()
+    {
+        unsigned int Faces[6];
+        const unsigned int NumFaces = m_probe.ScheduleFaces(Faces);
+
+        // The probe is still bound for the reflections of the last frame.
+        // RenderSceneCB() binds it again once the capture is done.
+        m_probe.Unbind(GL_TEXTURE1);
+
+        // The face projections are mirrored
+        glFrontFace(GL_CCW);
+
+        for (unsigned int i = 0 ; i < NumFaces ; i++) {
+            m_probe.BindForWriting(Faces[i]);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            const Matrix4f VP = m_probe.GetFaceViewProj(Faces[i], m_persProjInfo.zNear, m_persProjInfo.zFar);
+            RenderTanks(VP, m_probe.GetPosition(), true);
+            m_pSkyBox->Render(VP, m_probe.GetPosition());
+        }
+
+        m_probe.EndUpdate();
+
+        glFrontFace(GL_CW);
+        glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+    }
+
+
+    // Only the tank in the middle turns, the light selection of the others is
+    // reused until a light moves near them
+    void RenderTanks(const Matrix4f& VP, const Vector3f& EyePos, bool EnvironmentCapture)
+    {
+        m_pLightingTechnique->Enable();
+        m_pLightingTechnique->SetEyeWorldPos(EyePos);
+
+        for (unsigned int z = 0 ; z < NUM_TANKS_Z ; z++) {
+            for (unsigned int x = 0 ; x < NUM_TANKS_X ; x++) {
+                const unsigned int Tank = z * NUM_TANKS_X + x;
+                const bool Turning = (x == NUM_TANKS_X / 2) && (z == NUM_TANKS_Z / 2);
+
+                if (Turning && EnvironmentCapture) {
+                    continue;
+                }
+
+                Pipeline p;
+                p.Scale(0.1f, 0.1f, 0.1f);
+                p.Rotate(0.0f, Turning ? m_scale : 0.0f, 0.0f);
+                p.WorldPos(GetTankPos(x, z).x, GetTankPos(x, z).y, GetTankPos(x, z).z);
+
+                Vector3f Center;
+                float Radius;
+                TransformSphere(p.GetWorldTrans(), m_tankBoundsCenter, m_tankBoundsRadius, Center, Radius);
+
+                const LightSelection& Lights = m_lightManager.SelectLights(m_tankObjects[Tank], Center, Radius);
+                m_pLightingTechnique->SetPointLights(Lights.NumPointLights, Lights.PointLights);
+                m_pLightingTechnique->SetSpotLights(Lights.NumSpotLights, Lights.SpotLights);
+
+                m_pLightingTechnique->SetWVP(VP * p.GetWorldTrans());
+                m_pLightingTechnique->SetWorldMatrix(p.GetWorldTrans());
+                m_pLightingTechnique->SetReflectivity(Turning ? TANK_REFLECTIVITY : 0.0f);
+                m_pTankMesh->Render();
+            }
+        }
+    }
+
+
     virtual void IdleCB()
     {
         RenderSceneCB();
@@ -139,6 +262,23 @@ public:
             case 'q':
                 glutLeaveMainLoop();
                 break;
+
+            case 'l':
+                PrintLightStats();
+                break;
+
+            case 'r':
+                m_probe.SetFacesPerFrame(m_probe.GetFacesPerFrame() == 1 ? 2 : (m_probe.GetFacesPerFrame() == 2 ? 6 : 1));
+                printf("Environment probe faces per frame: %u\n", m_probe.GetFacesPerFrame());
+                break;
+
+            case 'h':
+                m_ambientSHEnabled = !m_ambientSHEnabled;
+                m_pLightingTechnique->Enable();
+                m_pLightingTechnique->SetAmbientSH(m_ambientSHEnabled ?
+                                                   m_pSkyBox->GetCubemapTexture()->GetAmbientSH() : m_flatAmbientSH);
+                printf("Ambient: %s\n", m_ambientSHEnabled ? "skybox SH" : "flat");
+                break;
         }
     }
 
@@ -150,6 +290,103 @@ public:
 
  private:
 
+    static Vector3f GetTankPos(unsigned int x, unsigned int z)
+    {
+        return Vector3f(((float)x - (NUM_TANKS_X - 1) * 0.5f) * TANK_SPACING,
+                        -5.0f,
+                        3.0f + ((float)z - (NUM_TANKS_Z - 1) * 0.5f) * TANK_SPACING);
+    }
+
+
+    // Bounding sphere of the mesh in world space. The radius is scaled by the
+    // largest axis scale of the world matrix.
+    static void TransformSphere(const Matrix4f& World, const Vector3f& Center, float Radius,
+                                Vector3f& WorldCenter, float& WorldRadius)
+    {
+        WorldCenter.x = World.m[0][0] * Center.x + World.m[0][1] * Center.y + World.m[0][2] * Center.z + World.m[0][3];
+        WorldCenter.y = World.m[1][0] * Center.x + World.m[1][1] * Center.y + World.m[1][2] * Center.z + World.m[1][3];
+        WorldCenter.z = World.m[2][0] * Center.x + World.m[2][1] * Center.y + World.m[2][2] * Center.z + World.m[2][3];
+
+        float MaxScaleSq = 0.0f;
+
+        for (unsigned int i = 0 ; i < 3 ; i++) {
+            const float ScaleSq = World.m[0][i] * World.m[0][i] + World.m[1][i] * World.m[1][i] + World.m[2][i] * World.m[2][i];
+
+            if (ScaleSq > MaxScaleSq) {
+                MaxScaleSq = ScaleSq;
+            }
+        }
+
+        WorldRadius = Radius * sqrtf(MaxScaleSq);
+    }
+
+
+    void InitLights()
+    {
+        const Vector3f Colors[] = { Vector3f(1.0f, 0.3f, 0.2f),
+                                    Vector3f(0.2f, 1.0f, 0.3f),
+                                    Vector3f(0.3f, 0.4f, 1.0f),
+                                    Vector3f(1.0f, 0.9f, 0.4f) };
+
+        m_lightManager.Init(LIGHT_GRID_CELL_SIZE);
+
+        // A lattice of point lights between the tanks. The first few of them
+        // circle around the middle of the field.
+        for (unsigned int i = 0 ; i < NUM_POINT_LIGHTS ; i++) {
+            const unsigned int x = i % NUM_POINT_LIGHTS_X;
+            const unsigned int z = i / NUM_POINT_LIGHTS_X;
+
+            m_pointLights[i].Color = Colors[i % ARRAY_SIZE_IN_ELEMENTS(Colors)];
+            m_pointLights[i].AmbientIntensity = 0.0f;
+            m_pointLights[i].DiffuseIntensity = 0.5f;
+            m_pointLights[i].Position = GetTankPos(0, 0) + Vector3f(((float)x - 0.5f) * TANK_SPACING, 2.0f, ((float)z - 0.5f) * TANK_SPACING);
+            m_pointLights[i].Attenuation.Linear = 0.5f;
+            m_pointLights[i].Attenuation.Exp = 0.5f;
+            m_lightManager.AddPointLight(m_pointLights[i]);
+        }
+
+        // One spot light looking down each column of tanks
+        for (unsigned int i = 0 ; i < NUM_SPOT_LIGHTS ; i++) {
+            m_spotLights[i].Color = Vector3f(1.0f, 1.0f, 1.0f);
+            m_spotLights[i].DiffuseIntensity = 0.9f;
+            m_spotLights[i].Position = GetTankPos(i, 0) + Vector3f(0.0f, 6.0f, -TANK_SPACING);
+            m_spotLights[i].Direction = Vector3f(0.0f, -0.5f, 1.0f);
+            m_spotLights[i].Cutoff = 20.0f;
+            m_spotLights[i].Attenuation.Linear = 0.1f;
+            m_spotLights[i].Attenuation.Exp = 0.02f;
+            m_lightManager.AddSpotLight(m_spotLights[i]);
+        }
+
+        for (unsigned int i = 0 ; i < NUM_TANKS ; i++) {
+            m_tankObjects[i] = m_lightManager.AddObject();
+        }
+    }
+
+
+    void UpdateLights()
+    {
+        const Vector3f Middle = GetTankPos(NUM_TANKS_X / 2, NUM_TANKS_Z / 2);
+
+        for (unsigned int i = 0 ; i < NUM_MOVING_POINT_LIGHTS ; i++) {
+            const float Angle = m_scale * 0.5f + (float)i * 2.0f * M_PI / NUM_MOVING_POINT_LIGHTS;
+
+            m_pointLights[i].Position = Middle + Vector3f(cosf(Angle) * TANK_SPACING, 2.0f, sinf(Angle) * TANK_SPACING);
+            m_lightManager.UpdatePointLight(i, m_pointLights[i]);
+        }
+    }
+
+
+    void PrintLightStats()
+    {
+        const LightManagerStats& Stats = m_lightManager.GetStats();
+
+        printf("Light selections %u, cache hits %u, lights tested %u\n",
+               Stats.Selections, Stats.CacheHits, Stats.LightsTested);
+
+        m_lightManager.ResetStats();
+    }
+
+
     LightingTechnique* m_pLightingTechnique;
     Camera* m_pGameCamera;
     float m_scale;
@@ -157,6 +394,15 @@ public:
     Mesh* m_pTankMesh;    
     SkyBox* m_pSkyBox;
     PersProjInfo m_persProjInfo;
+    Vector3f m_tankBoundsCenter;
+    float m_tankBoundsRadius;
+    LightManager m_lightManager;
+    PointLight m_pointLights[NUM_POINT_LIGHTS];
+    SpotLight m_spotLights[NUM_SPOT_LIGHTS];
+    unsigned int m_tankObjects[NUM_TANKS];
+    bool m_ambientSHEnabled;
+    EnvironmentProbe m_probe;
+    Vector3f m_flatAmbientSH[NUM_SH_COEFFICIENTS];
 };
 
 
@@ -1,4 +1,6 @@
 #include <assert.h>
+#include <float.h>
+#include <math.h>
 
 #include "mesh.h"
 
@@ -70,6 +72,8 @@ bool Mesh::InitFromScene(const aiScene* pScene, const std::string& Filename)
 {  
     m_Entries.resize(pScene->mNumMeshes);
     m_Textures.resize(pScene->mNumMaterials);
+    m_boundsMin = Vector3f(FLT_MAX, FLT_MAX, FLT_MAX);
+    m_boundsMax = Vector3f(-FLT_MAX, -FLT_MAX, -FLT_MAX);
 
     // Initialize the meshes in the scene one by one
     for (unsigned int i = 0 ; i < m_Entries.size() ; i++) {
@@ -99,6 +103,9 @@ void Mesh::InitMesh(unsigned int Index, const aiMesh* paiMesh)
                  Vector3f(pNormal->x, pNormal->y, pNormal->z));
 
         Vertices.push_back(v);
+
+        m_boundsMin = Vector3f(fminf(m_boundsMin.x, pPos->x), fminf(m_boundsMin.y, pPos->y), fminf(m_boundsMin.z, pPos->z));
+        m_boundsMax = Vector3f(fmaxf(m_boundsMax.x, pPos->x), fmaxf(m_boundsMax.y, pPos->y), fmaxf(m_boundsMax.z, pPos->z));
     }
 
     for (unsigned int i = 0 ; i < paiMesh->mNumFaces ; i++) {
@@ -186,3 +193,11 @@ void Mesh::Render()
     glDisableVertexAttribArray(1);
     glDisableVertexAttribArray(2);
 }
+
+void Mesh::GetBoundingSphere(Vector3f& Center, float& Radius) const
+{
+    Center = (m_boundsMin + m_boundsMax) * 0.5f;
+
+    const Vector3f HalfSize = (m_boundsMax - m_boundsMin) * 0.5f;
+    Radius = sqrtf(HalfSize.x * HalfSize.x + HalfSize.y * HalfSize.y + HalfSize.z * HalfSize.z);
+}
@@ -39,6 +39,9 @@ class Mesh
         bool LoadMesh(const std::string& Filename);
         void Render();
 
+        // Sphere around the bounding box of the mesh, in model space
+        void GetBoundingSphere(Vector3f& Center, float& Radius) const;
+
     private:
         bool InitFromScene(const aiScene* pScene, const std::string& Filename);
         void InitMesh(unsigned int Index, const aiMesh* paiMesh);
@@ -63,6 +66,8 @@ class Mesh
 
         std::vector<MeshEntry> m_Entries;
         std::vector<Texture*> m_Textures;
+        Vector3f m_boundsMin;
+        Vector3f m_boundsMax;
 };
 
 #endif /* MESH_H */
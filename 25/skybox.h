@@ -67,7 +67,22 @@ public:
     }
 
 
+    const CubemapTexture* GetCubemapTexture() const
+    {
+        return pCubemapTex;
+    }
+
     void Render()
+    {
+        Pipeline p;
+        p.SetCamera(pCamera->GetPos(), pCamera->GetTarget(), pCamera->GetUp());
+        p.SetPerspectiveProj(persProjInfo);
+
+        Render(p.GetWVPTrans(), pCamera->GetPos());
+    }
+
+    // Renders around Pos with any view projection, e.g. a face of an environment probe
+    void Render(const Matrix4f& VP, const Vector3f& Pos)
     {
         pSkyboxTechnique->Enable();
 
@@ -82,10 +97,8 @@ public:
         Pipeline p;
         p.Scale(20.0f, 20.0f, 20.0f);
         p.Rotate(0.0f, 0.0f, 0.0f);
-        p.WorldPos(pCamera->GetPos().x, pCamera->GetPos().y, pCamera->GetPos().z);
-        p.SetCamera(pCamera->GetPos(), pCamera->GetTarget(), pCamera->GetUp());
-        p.SetPerspectiveProj(persProjInfo);
-        pSkyboxTechnique->SetWVP(p.GetWVPTrans());
+        p.WorldPos(Pos.x, Pos.y, Pos.z);
+        pSkyboxTechnique->SetWVP(VP * p.GetWorldTrans());
         pCubemapTex->Bind(GL_TEXTURE0);
         pMesh->Render();
 
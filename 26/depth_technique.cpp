@@ -0,0 +1,76 @@
+#include "depth_technique.h"
+#include "engine_common.h"
+
+static const char* pVS = R"(
+#version 330
+
+layout (location = 0) in vec3 Position;
+
+struct BaseLight
+{
+    vec3 Color;
+    float AmbientIntensity;
+    float DiffuseIntensity;
+};
+
+struct DirectionalLight
+{
+    BaseLight Base;
+    vec3 Direction;
+};
+
+layout (std140, row_major) uniform PerFrame
+{
+    mat4 gVP;
+    mat4 gLightVP;
+    vec3 gEyeWorldPos;
+    DirectionalLight gDirectionalLight;
+};
+
+uniform mat4 gWorld;
+
+invariant gl_Position;
+
+void main()
+{
+    vec4 WorldPos = gWorld * vec4(Position, 1.0);
+    gl_Position = gVP * WorldPos;
+})";
+
+
+DepthTechnique::DepthTechnique()
+{
+}
+
+bool DepthTechnique::Init()
+{
+    if (!Technique::Init()) {
+        return false;
+    }
+
+    if (!AddShader(GL_VERTEX_SHADER, pVS)) {
+        return false;
+    }
+
+    if (!Finalize()) {
+        return false;
+    }
+
+    m_WorldMatrixLocation = GetUniformLocation(UNIFORM_ID("gWorld"));
+
+    if (m_WorldMatrixLocation == INVALID_UNIFORM_LOCATION) {
+        return false;
+    }
+
+    if (!BindUniformBlock("PerFrame", PER_FRAME_UBO_BINDING)) {
+        return false;
+    }
+
+    return true;
+}
+
+
+void DepthTechnique::SetWorldMatrix(const Matrix4f& World)
+{
+    SetUniformMatrix4f(m_WorldMatrixLocation, World);
+}
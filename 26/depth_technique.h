@@ -0,0 +1,32 @@
+#ifndef DEPTH_TECHNIQUE_H
+#define	DEPTH_TECHNIQUE_H
+
+#include "technique.h"
+#include "math_3d.h"
+
+// Depth-only program used by the depth pre-pass and the stencil pass of the
+// deferred light volumes. Only the position is read, so the mesh can feed it
+// from its position-only stream (Mesh::RenderDepth). There is no fragment
+// shader - the rasterizer writes depth and stencil and nothing else runs per
+// fragment.
+//
+// The position is computed exactly like in LightingTechnique (gVP from the
+// PerFrame block times gWorld) and gl_Position is invariant in both, so the
+// lighting pass can test against the pre-pass depth with GL_EQUAL.
+class DepthTechnique : public Technique
+{
+public:
+
+    DepthTechnique();
+
+    virtual bool Init();
+
+    void SetWorldMatrix(const Matrix4f& World);
+
+private:
+
+    GLuint m_WorldMatrixLocation;
+};
+
+
+#endif	/* DEPTH_TECHNIQUE_H */
@@ -0,0 +1,168 @@
+#include "ds_geom_pass_technique.h"
+#include "engine_common.h"
+
+static const char* pVS = R"(
+#version 330
+
+layout (location = 0) in vec3 Position;
+layout (location = 1) in vec2 TexCoord;
+layout (location = 2) in vec3 Normal;
+layout (location = 3) in vec3 Tangent;
+
+struct BaseLight
+{
+    vec3 Color;
+    float AmbientIntensity;
+    float DiffuseIntensity;
+};
+
+struct DirectionalLight
+{
+    BaseLight Base;
+    vec3 Direction;
+};
+
+layout (std140, row_major) uniform PerFrame
+{
+    mat4 gVP;
+    mat4 gLightVP;
+    vec3 gEyeWorldPos;
+    DirectionalLight gDirectionalLight;
+};
+
+uniform mat4 gWorld;
+
+out vec2 TexCoord0;
+out vec3 Normal0;
+out vec3 Tangent0;
+out float ViewDepth0;
+
+void main()
+{
+    vec4 WorldPos = gWorld * vec4(Position, 1.0);
+    gl_Position   = gVP * WorldPos;
+    TexCoord0     = TexCoord;
+    Normal0       = (gWorld * vec4(Normal, 0.0)).xyz;
+    Tangent0      = (gWorld * vec4(Tangent, 0.0)).xyz;
+    ViewDepth0    = gl_Position.w;
+})";
+
+// The normal is folded onto an octahedron and stored in two channels, which
+// leaves room for both specular parameters in the same target
+static const char* pFS = R"(
+#version 330
+
+in vec2 TexCoord0;
+in vec3 Normal0;
+in vec3 Tangent0;
+in float ViewDepth0;
+
+layout (location = 0) out vec4 Albedo;
+layout (location = 1) out vec4 NormalSpecular;
+layout (location = 2) out float ViewDepth;
+
+uniform sampler2D gColorMap;
+uniform sampler2D gNormalMap;
+uniform float gMatSpecularIntensity;
+uniform float gSpecularPower;
+
+vec3 CalcBumpedNormal()
+{
+    vec3 Normal = normalize(Normal0);
+    vec3 Tangent = normalize(Tangent0);
+    Tangent = normalize(Tangent - dot(Tangent, Normal) * Normal);
+    vec3 Bitangent = cross(Tangent, Normal);
+    vec3 BumpMapNormal = texture(gNormalMap, TexCoord0).xyz;
+    BumpMapNormal = 2.0 * BumpMapNormal - vec3(1.0, 1.0, 1.0);
+    mat3 TBN = mat3(Tangent, Bitangent, Normal);
+    return normalize(TBN * BumpMapNormal);
+}
+
+vec2 EncodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+
+    if (n.z < 0.0) {
+        vec2 Sign = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+        n.xy = (1.0 - abs(n.yx)) * Sign;
+    }
+
+    return n.xy;
+}
+
+void main()
+{
+    Albedo = vec4(texture(gColorMap, TexCoord0).rgb, 1.0);
+    NormalSpecular = vec4(EncodeNormal(CalcBumpedNormal()), gMatSpecularIntensity, gSpecularPower);
+    ViewDepth = ViewDepth0;
+})";
+
+
+DSGeomPassTechnique::DSGeomPassTechnique()
+{
+}
+
+bool DSGeomPassTechnique::Init()
+{
+    if (!Technique::Init()) {
+        return false;
+    }
+
+    if (!AddShader(GL_VERTEX_SHADER, pVS)) {
+        return false;
+    }
+
+    if (!AddShader(GL_FRAGMENT_SHADER, pFS)) {
+        return false;
+    }
+
+    if (!Finalize()) {
+        return false;
+    }
+
+    m_WorldMatrixLocation = GetUniformLocation(UNIFORM_ID("gWorld"));
+    m_colorMapLocation = GetUniformLocation(UNIFORM_ID("gColorMap"));
+    m_normalMapLocation = GetUniformLocation(UNIFORM_ID("gNormalMap"));
+    m_matSpecularIntensityLocation = GetUniformLocation(UNIFORM_ID("gMatSpecularIntensity"));
+    m_matSpecularPowerLocation = GetUniformLocation(UNIFORM_ID("gSpecularPower"));
+
+    if (m_WorldMatrixLocation == INVALID_UNIFORM_LOCATION) {
+        return false;
+    }
+
+    if (!BindUniformBlock("PerFrame", PER_FRAME_UBO_BINDING)) {
+        return false;
+    }
+
+    return true;
+}
+
+
+void DSGeomPassTechnique::SetWorldMatrix(const Matrix4f& World)
+{
+    SetUniformMatrix4f(m_WorldMatrixLocation, World);
+}
+
+
+void DSGeomPassTechnique::SetColorTextureUnit(unsigned int TextureUnit)
+{
+    SetUniform1i(m_colorMapLocation, TextureUnit);
+}
+
+
+void DSGeomPassTechnique::SetNormalMapTextureUnit(unsigned int TextureUnit)
+{
+    SetUniform1i(m_normalMapLocation, TextureUnit);
+}
+
+
+void DSGeomPassTechnique::SetMatSpecularIntensity(float Intensity)
+{
+    SetUniform1f(m_matSpecularIntensityLocation, Intensity);
+}
+
+
+void DSGeomPassTechnique::SetMatSpecularPower(float Power)
+{
+    SetUniform1f(m_matSpecularPowerLocation, Power);
+}
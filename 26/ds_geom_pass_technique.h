@@ -0,0 +1,33 @@
+#ifndef DS_GEOM_PASS_TECHNIQUE_H
+#define	DS_GEOM_PASS_TECHNIQUE_H
+
+#include "technique.h"
+#include "math_3d.h"
+
+// First pass of the deferred path. Writes the surface attributes into the
+// G-buffer, no lighting is done here.
+class DSGeomPassTechnique : public Technique
+{
+public:
+
+    DSGeomPassTechnique();
+
+    virtual bool Init();
+
+    void SetWorldMatrix(const Matrix4f& World);
+    void SetColorTextureUnit(unsigned int TextureUnit);
+    void SetNormalMapTextureUnit(unsigned int TextureUnit);
+    void SetMatSpecularIntensity(float Intensity);
+    void SetMatSpecularPower(float Power);
+
+private:
+
+    GLuint m_WorldMatrixLocation;
+    GLuint m_colorMapLocation;
+    GLuint m_normalMapLocation;
+    GLuint m_matSpecularIntensityLocation;
+    GLuint m_matSpecularPowerLocation;
+};
+
+
+#endif	/* DS_GEOM_PASS_TECHNIQUE_H */
@@ -0,0 +1,361 @@
+#include <string>
+#include <glm/glm.hpp>
+
+#include "ds_light_pass_technique.h"
+#include "engine_common.h"
+
+static const char* pPointVS = R"(
+#version 330
+
+layout (location = 0) in vec3 Position;
+
+uniform mat4 gWVP;
+
+void main()
+{
+    gl_Position = gWVP * vec4(Position, 1.0);
+})";
+
+// Full screen triangle generated from gl_VertexID, no vertex buffers needed
+static const char* pDirVS = R"(
+#version 330
+
+void main()
+{
+    vec2 Pos = vec2((gl_VertexID == 1) ? 3.0 : -1.0, (gl_VertexID == 2) ? 3.0 : -1.0);
+    gl_Position = vec4(Pos, 0.0, 1.0);
+})";
+
+// Shared by all the light passes, the lighting model is the one of LightingTechnique
+static const char* pCommonFS = R"(
+#version 330
+
+struct BaseLight
+{
+    vec3 Color;
+    float AmbientIntensity;
+    float DiffuseIntensity;
+};
+
+struct DirectionalLight
+{
+    BaseLight Base;
+    vec3 Direction;
+};
+
+struct Attenuation
+{
+    float Constant;
+    float Linear;
+    float Exp;
+};
+
+struct PointLight
+{
+    BaseLight Base;
+    vec3 Position;
+    Attenuation Atten;
+};
+
+struct SpotLight
+{
+    PointLight Base;
+    vec3 Direction;
+    float Cutoff;
+};
+
+struct Surface
+{
+    vec3 WorldPos;
+    vec3 Normal;
+    vec3 Albedo;
+    float SpecularIntensity;
+    float SpecularPower;
+};
+
+layout (std140, row_major) uniform PerFrame
+{
+    mat4 gVP;
+    mat4 gLightVP;
+    vec3 gEyeWorldPos;
+    DirectionalLight gDirectionalLight;
+};
+
+uniform sampler2D gAlbedoMap;
+uniform sampler2D gNormalMap;
+uniform sampler2D gDepthMap;
+uniform vec2 gScreenSize;
+uniform vec2 gTanHalfFOV;
+uniform mat4 gView;
+
+out vec4 FragColor;
+
+vec3 DecodeNormal(vec2 f)
+{
+    vec3 n = vec3(f, 1.0 - abs(f.x) - abs(f.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.x += (n.x >= 0.0) ? -t : t;
+    n.y += (n.y >= 0.0) ? -t : t;
+    return normalize(n);
+}
+
+// Returns false for background pixels
+bool FetchSurface(out Surface s)
+{
+    ivec2 Coord = ivec2(gl_FragCoord.xy);
+    float Depth = texelFetch(gDepthMap, Coord, 0).r;
+
+    if (Depth == 0.0) {
+        return false;
+    }
+
+    // The view rotation is orthonormal, its transpose takes view space back to world space
+    vec2 NDC = gl_FragCoord.xy / gScreenSize * 2.0 - 1.0;
+    vec3 ViewPos = vec3(NDC * gTanHalfFOV * Depth, Depth);
+    s.WorldPos = gEyeWorldPos + transpose(mat3(gView)) * ViewPos;
+
+    vec4 NormalSpecular = texelFetch(gNormalMap, Coord, 0);
+    s.Normal = DecodeNormal(NormalSpecular.xy);
+    s.SpecularIntensity = NormalSpecular.z;
+    s.SpecularPower = NormalSpecular.w;
+    s.Albedo = texelFetch(gAlbedoMap, Coord, 0).rgb;
+
+    return true;
+}
+
+vec4 CalcLightInternal(BaseLight Light, vec3 LightDirection, Surface s)
+{
+    vec4 AmbientColor = vec4(Light.Color, 1.0f) * Light.AmbientIntensity;
+    float DiffuseFactor = dot(s.Normal, -LightDirection);
+
+    vec4 DiffuseColor  = vec4(0, 0, 0, 0);
+    vec4 SpecularColor = vec4(0, 0, 0, 0);
+
+    if (DiffuseFactor > 0) {
+        DiffuseColor = vec4(Light.Color, 1.0f) * Light.DiffuseIntensity * DiffuseFactor;
+
+        vec3 VertexToEye = normalize(gEyeWorldPos - s.WorldPos);
+        vec3 LightReflect = normalize(reflect(LightDirection, s.Normal));
+        float SpecularFactor = dot(VertexToEye, LightReflect);
+        SpecularFactor = pow(SpecularFactor, s.SpecularPower);
+        if (SpecularFactor > 0) {
+            SpecularColor = vec4(Light.Color, 1.0f) * s.SpecularIntensity * SpecularFactor;
+        }
+    }
+
+    return AmbientColor + DiffuseColor + SpecularColor;
+}
+
+vec4 CalcPointLight(PointLight l, Surface s)
+{
+    vec3 LightDirection = s.WorldPos - l.Position;
+    float Distance = length(LightDirection);
+    LightDirection = normalize(LightDirection);
+
+    vec4 Color = CalcLightInternal(l.Base, LightDirection, s);
+    float Attenuation =  l.Atten.Constant +
+                         l.Atten.Linear * Distance +
+                         l.Atten.Exp * Distance * Distance;
+
+    return Color / Attenuation;
+}
+)";
+
+static const char* pDirFSMain = R"(
+void main()
+{
+    Surface s;
+
+    if (!FetchSurface(s)) {
+        discard;
+    }
+
+    vec4 Light = CalcLightInternal(gDirectionalLight.Base, gDirectionalLight.Direction, s);
+    FragColor = vec4(s.Albedo, 1.0) * Light;
+})";
+
+static const char* pPointFSMain = R"(
+uniform SpotLight gLight;
+uniform int gIsSpotLight;
+
+void main()
+{
+    Surface s;
+
+    if (!FetchSurface(s)) {
+        discard;
+    }
+
+    vec4 Light = CalcPointLight(gLight.Base, s);
+
+    if (gIsSpotLight != 0) {
+        float SpotFactor = dot(normalize(s.WorldPos - gLight.Base.Position), gLight.Direction);
+
+        if (SpotFactor <= gLight.Cutoff) {
+            discard;
+        }
+
+        Light *= 1.0 - (1.0 - SpotFactor) * 1.0/(1.0 - gLight.Cutoff);
+    }
+
+    FragColor = vec4(s.Albedo, 1.0) * Light;
+})";
+
+
+DSLightPassTechnique::DSLightPassTechnique()
+{
+}
+
+bool DSLightPassTechnique::InitLightPass(const char* pVS, const char* pFSMain)
+{
+    if (!Technique::Init()) {
+        return false;
+    }
+
+    if (!AddShader(GL_VERTEX_SHADER, pVS)) {
+        return false;
+    }
+
+    std::string FS = std::string(pCommonFS) + pFSMain;
+
+    if (!AddShader(GL_FRAGMENT_SHADER, FS.c_str())) {
+        return false;
+    }
+
+    if (!Finalize()) {
+        return false;
+    }
+
+    m_albedoMapLocation = GetUniformLocation(UNIFORM_ID("gAlbedoMap"));
+    m_normalMapLocation = GetUniformLocation(UNIFORM_ID("gNormalMap"));
+    m_depthMapLocation = GetUniformLocation(UNIFORM_ID("gDepthMap"));
+    m_screenSizeLocation = GetUniformLocation(UNIFORM_ID("gScreenSize"));
+    m_tanHalfFOVLocation = GetUniformLocation(UNIFORM_ID("gTanHalfFOV"));
+    m_viewLocation = GetUniformLocation(UNIFORM_ID("gView"));
+
+    if (m_depthMapLocation == INVALID_UNIFORM_LOCATION ||
+        m_screenSizeLocation == INVALID_UNIFORM_LOCATION ||
+        m_tanHalfFOVLocation == INVALID_UNIFORM_LOCATION ||
+        m_viewLocation == INVALID_UNIFORM_LOCATION) {
+        return false;
+    }
+
+    // Eye position and the directional light come from the buffer owned by FrameConstants
+    if (!BindUniformBlock("PerFrame", PER_FRAME_UBO_BINDING)) {
+        return false;
+    }
+
+    return true;
+}
+
+
+void DSLightPassTechnique::SetGBufferTextureUnits(unsigned int AlbedoUnit, unsigned int NormalUnit, unsigned int DepthUnit)
+{
+    SetUniform1i(m_albedoMapLocation, AlbedoUnit);
+    SetUniform1i(m_normalMapLocation, NormalUnit);
+    SetUniform1i(m_depthMapLocation, DepthUnit);
+}
+
+
+void DSLightPassTechnique::SetScreenSize(unsigned int Width, unsigned int Height)
+{
+    SetUniform2f(m_screenSizeLocation, Vector2f((float)Width, (float)Height));
+}
+
+
+void DSLightPassTechnique::SetProjection(const PersProjInfo& ProjInfo)
+{
+    const float TanHalfFOV = tanf(glm::radians(ProjInfo.FOV / 2.0f));
+
+    SetUniform2f(m_tanHalfFOVLocation, Vector2f(TanHalfFOV * ProjInfo.Width / ProjInfo.Height, TanHalfFOV));
+}
+
+
+void DSLightPassTechnique::SetViewMatrix(const Matrix4f& View)
+{
+    SetUniformMatrix4f(m_viewLocation, View);
+}
+
+
+DSDirLightPassTechnique::DSDirLightPassTechnique()
+{
+}
+
+bool DSDirLightPassTechnique::Init()
+{
+    return InitLightPass(pDirVS, pDirFSMain);
+}
+
+
+void DSDirLightPassTechnique::Draw()
+{
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+
+DSPointLightPassTechnique::DSPointLightPassTechnique()
+{
+}
+
+bool DSPointLightPassTechnique::Init()
+{
+    if (!InitLightPass(pPointVS, pPointFSMain)) {
+        return false;
+    }
+
+    m_WVPLocation = GetUniformLocation(UNIFORM_ID("gWVP"));
+    m_isSpotLightLocation = GetUniformLocation(UNIFORM_ID("gIsSpotLight"));
+    m_lightLocation.Color = GetUniformLocation(UNIFORM_ID("gLight.Base.Base.Color"));
+    m_lightLocation.AmbientIntensity = GetUniformLocation(UNIFORM_ID("gLight.Base.Base.AmbientIntensity"));
+    m_lightLocation.DiffuseIntensity = GetUniformLocation(UNIFORM_ID("gLight.Base.Base.DiffuseIntensity"));
+    m_lightLocation.Position = GetUniformLocation(UNIFORM_ID("gLight.Base.Position"));
+    m_lightLocation.Atten.Constant = GetUniformLocation(UNIFORM_ID("gLight.Base.Atten.Constant"));
+    m_lightLocation.Atten.Linear = GetUniformLocation(UNIFORM_ID("gLight.Base.Atten.Linear"));
+    m_lightLocation.Atten.Exp = GetUniformLocation(UNIFORM_ID("gLight.Base.Atten.Exp"));
+    m_lightLocation.Direction = GetUniformLocation(UNIFORM_ID("gLight.Direction"));
+    m_lightLocation.Cutoff = GetUniformLocation(UNIFORM_ID("gLight.Cutoff"));
+
+    if (m_WVPLocation == INVALID_UNIFORM_LOCATION ||
+        m_lightLocation.Position == INVALID_UNIFORM_LOCATION) {
+        return false;
+    }
+
+    return true;
+}
+
+
+void DSPointLightPassTechnique::SetWVP(const Matrix4f& WVP)
+{
+    SetUniformMatrix4f(m_WVPLocation, WVP);
+}
+
+
+void DSPointLightPassTechnique::SetLightBase(const PointLight& Light)
+{
+    SetUniform3f(m_lightLocation.Color, Light.Color);
+    SetUniform1f(m_lightLocation.AmbientIntensity, Light.AmbientIntensity);
+    SetUniform1f(m_lightLocation.DiffuseIntensity, Light.DiffuseIntensity);
+    SetUniform3f(m_lightLocation.Position, Light.Position);
+    SetUniform1f(m_lightLocation.Atten.Constant, Light.Attenuation.Constant);
+    SetUniform1f(m_lightLocation.Atten.Linear, Light.Attenuation.Linear);
+    SetUniform1f(m_lightLocation.Atten.Exp, Light.Attenuation.Exp);
+}
+
+
+void DSPointLightPassTechnique::SetPointLight(const PointLight& Light)
+{
+    SetLightBase(Light);
+    SetUniform1i(m_isSpotLightLocation, 0);
+}
+
+
+void DSPointLightPassTechnique::SetSpotLight(const SpotLight& Light)
+{
+    SetLightBase(Light);
+
+    Vector3f Direction = Light.Direction;
+    Direction.Normalize();
+    SetUniform3f(m_lightLocation.Direction, Direction);
+    SetUniform1f(m_lightLocation.Cutoff, cosf(glm::radians(Light.Cutoff)));
+    SetUniform1i(m_isSpotLightLocation, 1);
+}
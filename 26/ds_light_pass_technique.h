@@ -0,0 +1,89 @@
+#ifndef DS_LIGHT_PASS_TECHNIQUE_H
+#define	DS_LIGHT_PASS_TECHNIQUE_H
+
+#include "technique.h"
+#include "lighting_technique.h"
+#include "math_3d.h"
+
+// Common part of the deferred light passes. The surface is read back from the
+// G-buffer and the world position is rebuilt from the stored view depth, the
+// projection and the camera rotation. The result of every pass is added to
+// the light accumulation target.
+class DSLightPassTechnique : public Technique
+{
+public:
+
+    DSLightPassTechnique();
+
+    void SetGBufferTextureUnits(unsigned int AlbedoUnit, unsigned int NormalUnit, unsigned int DepthUnit);
+    void SetScreenSize(unsigned int Width, unsigned int Height);
+    void SetProjection(const PersProjInfo& ProjInfo);
+    void SetViewMatrix(const Matrix4f& View);
+
+protected:
+
+    // Builds the program from the vertex shader and the main() of the fragment shader
+    bool InitLightPass(const char* pVS, const char* pFSMain);
+
+private:
+
+    GLuint m_albedoMapLocation;
+    GLuint m_normalMapLocation;
+    GLuint m_depthMapLocation;
+    GLuint m_screenSizeLocation;
+    GLuint m_tanHalfFOVLocation;
+    GLuint m_viewLocation;
+};
+
+
+// Directional light, applied with a full screen triangle
+class DSDirLightPassTechnique : public DSLightPassTechnique
+{
+public:
+
+    DSDirLightPassTechnique();
+
+    virtual bool Init();
+
+    void Draw();
+};
+
+
+// Point and spot lights, drawn as a sphere around the light which is limited
+// to the lit pixels by the stencil pass
+class DSPointLightPassTechnique : public DSLightPassTechnique
+{
+public:
+
+    DSPointLightPassTechnique();
+
+    virtual bool Init();
+
+    void SetWVP(const Matrix4f& WVP);
+    void SetPointLight(const PointLight& Light);
+    void SetSpotLight(const SpotLight& Light);
+
+private:
+
+    void SetLightBase(const PointLight& Light);
+
+    GLuint m_WVPLocation;
+    GLuint m_isSpotLightLocation;
+
+    struct {
+        GLuint Color;
+        GLuint AmbientIntensity;
+        GLuint DiffuseIntensity;
+        GLuint Position;
+        struct {
+            GLuint Constant;
+            GLuint Linear;
+            GLuint Exp;
+        } Atten;
+        GLuint Direction;
+        GLuint Cutoff;
+    } m_lightLocation;
+};
+
+
+#endif	/* DS_LIGHT_PASS_TECHNIQUE_H */
@@ -4,6 +4,20 @@
 #define COLOR_TEXTURE_UNIT GL_TEXTURE0
 #define SHADOW_TEXTURE_UNIT GL_TEXTURE1
 #define NORMAL_TEXTURE_UNIT GL_TEXTURE2
+#define CLUSTER_LIGHTS_TEXTURE_UNIT GL_TEXTURE3
+#define CLUSTER_LIGHTS_TEXTURE_UNIT_INDEX 3
+#define CLUSTER_GRID_TEXTURE_UNIT GL_TEXTURE4
+#define CLUSTER_GRID_TEXTURE_UNIT_INDEX 4
+#define CLUSTER_INDEX_TEXTURE_UNIT GL_TEXTURE5
+#define CLUSTER_INDEX_TEXTURE_UNIT_INDEX 5
+#define GBUFFER_ALBEDO_TEXTURE_UNIT GL_TEXTURE6
+#define GBUFFER_ALBEDO_TEXTURE_UNIT_INDEX 6
+#define GBUFFER_NORMAL_TEXTURE_UNIT GL_TEXTURE7
+#define GBUFFER_NORMAL_TEXTURE_UNIT_INDEX 7
+#define GBUFFER_DEPTH_TEXTURE_UNIT GL_TEXTURE8
+#define GBUFFER_DEPTH_TEXTURE_UNIT_INDEX 8
+
+#define PER_FRAME_UBO_BINDING 0
 
 
 
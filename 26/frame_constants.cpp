@@ -0,0 +1,72 @@
+#include <string.h>
+
+#include "frame_constants.h"
+#include "engine_common.h"
+
+static void FillBaseLight(BaseLightStd140& Dst, const BaseLight& Src)
+{
+    Dst.Color = Src.Color;
+    Dst.AmbientIntensity = Src.AmbientIntensity;
+    Dst.DiffuseIntensity = Src.DiffuseIntensity;
+}
+
+
+FrameConstants::FrameConstants()
+{
+    memset(&m_perFrame, 0, sizeof(m_perFrame));
+
+    m_perFrame.VP.InitIdentity();
+    m_perFrame.LightVP.InitIdentity();
+
+    m_perFrameDirty = true;
+}
+
+
+bool FrameConstants::Init()
+{
+    if (!m_perFrameUBO.Init(PER_FRAME_UBO_BINDING, sizeof(m_perFrame))) {
+        return false;
+    }
+
+    return true;
+}
+
+
+void FrameConstants::SetViewProj(const Matrix4f& VP)
+{
+    m_perFrame.VP = VP;
+    m_perFrameDirty = true;
+}
+
+
+void FrameConstants::SetLightViewProj(const Matrix4f& LightVP)
+{
+    m_perFrame.LightVP = LightVP;
+    m_perFrameDirty = true;
+}
+
+
+void FrameConstants::SetEyeWorldPos(const Vector3f& EyeWorldPos)
+{
+    m_perFrame.EyeWorldPos = EyeWorldPos;
+    m_perFrameDirty = true;
+}
+
+
+void FrameConstants::SetDirectionalLight(const DirectionalLight& Light)
+{
+    FillBaseLight(m_perFrame.DirectionalLight.Base, Light);
+    Vector3f Direction = Light.Direction;
+    Direction.Normalize();
+    m_perFrame.DirectionalLight.Direction = Direction;
+    m_perFrameDirty = true;
+}
+
+
+void FrameConstants::Commit()
+{
+    if (m_perFrameDirty) {
+        m_perFrameUBO.Update(&m_perFrame, sizeof(m_perFrame));
+        m_perFrameDirty = false;
+    }
+}
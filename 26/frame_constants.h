@@ -0,0 +1,71 @@
+#ifndef FRAME_CONSTANTS_H
+#define	FRAME_CONSTANTS_H
+
+#include "math_3d.h"
+#include "lighting_technique.h"
+#include "uniform_buffer.h"
+
+// CPU side mirrors of the std140 uniform blocks declared by the shaders.
+// The padding members follow the std140 rules: vec3 and structs are
+// aligned on 16 bytes and structs are rounded up to a multiple of 16.
+
+struct BaseLightStd140
+{
+    Vector3f Color;
+    float AmbientIntensity;
+    float DiffuseIntensity;
+    float Padding[3];
+};
+
+struct DirectionalLightStd140
+{
+    BaseLightStd140 Base;
+    Vector3f Direction;
+    float Padding;
+};
+
+// layout (std140, row_major) uniform PerFrame
+struct PerFrameBlock
+{
+    Matrix4f VP;
+    Matrix4f LightVP;
+    Vector3f EyeWorldPos;
+    float Padding;
+    DirectionalLightStd140 DirectionalLight;
+};
+
+static_assert(sizeof(BaseLightStd140) == 32, "std140 layout mismatch");
+static_assert(sizeof(DirectionalLightStd140) == 48, "std140 layout mismatch");
+static_assert(sizeof(PerFrameBlock) == 192, "std140 layout mismatch");
+
+
+// Per-frame constants shared by every technique. The setters only update the
+// CPU copy; Commit() uploads the block with one buffer update. Point and spot
+// lights are not part of it, they are binned per cluster by LightClusters.
+class FrameConstants
+{
+public:
+
+    FrameConstants();
+
+    bool Init();
+
+    void SetViewProj(const Matrix4f& VP);
+    void SetLightViewProj(const Matrix4f& LightVP);
+    void SetEyeWorldPos(const Vector3f& EyeWorldPos);
+    void SetDirectionalLight(const DirectionalLight& Light);
+
+    void Commit();
+
+private:
+
+    PerFrameBlock m_perFrame;
+
+    bool m_perFrameDirty;
+
+    UniformBuffer m_perFrameUBO;
+};
+
+
+#endif	/* FRAME_CONSTANTS_H */
+
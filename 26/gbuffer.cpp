@@ -0,0 +1,139 @@
+#include <stdio.h>
+
+#include "gbuffer.h"
+#include "engine_common.h"
+#include "util.h"
+
+#define GBUFFER_FINAL_ATTACHMENT (GL_COLOR_ATTACHMENT0 + GBuffer::GBUFFER_NUM_TEXTURES)
+
+GBuffer::GBuffer()
+{
+    m_fbo = 0;
+    m_finalTexture = 0;
+    m_depthStencil = 0;
+    m_width = 0;
+    m_height = 0;
+
+    for (unsigned int i = 0 ; i < GBUFFER_NUM_TEXTURES ; i++) {
+        m_textures[i] = 0;
+    }
+}
+
+
+GBuffer::~GBuffer()
+{
+    if (m_fbo != 0) {
+        glDeleteFramebuffers(1, &m_fbo);
+    }
+
+    if (m_textures[0] != 0) {
+        glDeleteTextures(GBUFFER_NUM_TEXTURES, m_textures);
+    }
+
+    if (m_finalTexture != 0) {
+        glDeleteTextures(1, &m_finalTexture);
+    }
+
+    if (m_depthStencil != 0) {
+        glDeleteRenderbuffers(1, &m_depthStencil);
+    }
+}
+
+
+bool GBuffer::Init(unsigned int WindowWidth, unsigned int WindowHeight)
+{
+    m_width = WindowWidth;
+    m_height = WindowHeight;
+
+    glGenFramebuffers(1, &m_fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_fbo);
+
+    const GLenum InternalFormats[GBUFFER_NUM_TEXTURES] = { GL_RGBA8, GL_RGBA16F, GL_R32F };
+    const GLenum Formats[GBUFFER_NUM_TEXTURES] = { GL_RGBA, GL_RGBA, GL_RED };
+
+    glGenTextures(GBUFFER_NUM_TEXTURES, m_textures);
+
+    // The light passes read the targets with texelFetch, no filtering needed
+    for (unsigned int i = 0 ; i < GBUFFER_NUM_TEXTURES ; i++) {
+        glBindTexture(GL_TEXTURE_2D, m_textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, InternalFormats[i], m_width, m_height, 0, Formats[i], GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, m_textures[i], 0);
+    }
+
+    glGenTextures(1, &m_finalTexture);
+    glBindTexture(GL_TEXTURE_2D, m_finalTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_width, m_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GBUFFER_FINAL_ATTACHMENT, GL_TEXTURE_2D, m_finalTexture, 0);
+
+    glGenRenderbuffers(1, &m_depthStencil);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_depthStencil);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, m_width, m_height);
+    glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_depthStencil);
+
+    GLenum Status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+    if (Status != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "G-buffer error, status: 0x%x\n", Status);
+        return false;
+    }
+
+    return true;
+}
+
+
+void GBuffer::StartFrame()
+{
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_fbo);
+    glDrawBuffer(GBUFFER_FINAL_ATTACHMENT);
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
+
+void GBuffer::BindForGeomPass()
+{
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_fbo);
+
+    const GLenum DrawBuffers[GBUFFER_NUM_TEXTURES] = { GL_COLOR_ATTACHMENT0,
+                                                      GL_COLOR_ATTACHMENT1,
+                                                      GL_COLOR_ATTACHMENT2 };
+
+    glDrawBuffers(GBUFFER_NUM_TEXTURES, DrawBuffers);
+}
+
+
+void GBuffer::BindForStencilPass()
+{
+    // Only the stencil is written, no color target needed
+    glDrawBuffer(GL_NONE);
+}
+
+
+void GBuffer::BindForLightPass()
+{
+    glDrawBuffer(GBUFFER_FINAL_ATTACHMENT);
+
+    glActiveTexture(GBUFFER_ALBEDO_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, m_textures[GBUFFER_TEXTURE_TYPE_ALBEDO]);
+    glActiveTexture(GBUFFER_NORMAL_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, m_textures[GBUFFER_TEXTURE_TYPE_NORMAL]);
+    glActiveTexture(GBUFFER_DEPTH_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, m_textures[GBUFFER_TEXTURE_TYPE_DEPTH]);
+}
+
+
+void GBuffer::BlitToScreen()
+{
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_fbo);
+    glReadBuffer(GBUFFER_FINAL_ATTACHMENT);
+
+    glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
@@ -0,0 +1,58 @@
+#ifndef GBUFFER_H
+#define	GBUFFER_H
+
+#include <GL/glew.h>
+
+// Render targets of the deferred path.
+//
+//   ALBEDO   GL_RGBA8    diffuse color of the surface
+//   NORMAL   GL_RGBA16F  octahedral normal in xy, specular intensity and power in zw
+//   DEPTH    GL_R32F     view space depth, zero where nothing was drawn
+//   FINAL    GL_RGBA8    light accumulation, blitted to the screen at the end
+//
+// The depth/stencil renderbuffer is used for depth testing during the
+// geometry pass and for the stencil test of the light volumes. The light
+// passes read depth from the DEPTH target so that nothing attached to the
+// framebuffer is sampled while it is being tested against.
+class GBuffer
+{
+public:
+
+    enum GBUFFER_TEXTURE_TYPE {
+        GBUFFER_TEXTURE_TYPE_ALBEDO,
+        GBUFFER_TEXTURE_TYPE_NORMAL,
+        GBUFFER_TEXTURE_TYPE_DEPTH,
+        GBUFFER_NUM_TEXTURES
+    };
+
+    GBuffer();
+
+    ~GBuffer();
+
+    bool Init(unsigned int WindowWidth, unsigned int WindowHeight);
+
+    // Clears the light accumulation target
+    void StartFrame();
+
+    void BindForGeomPass();
+
+    void BindForStencilPass();
+
+    // Draws into FINAL and binds the other targets to the GBUFFER_*_TEXTURE_UNITs
+    void BindForLightPass();
+
+    // Copies FINAL into the default framebuffer
+    void BlitToScreen();
+
+private:
+
+    GLuint m_fbo;
+    GLuint m_textures[GBUFFER_NUM_TEXTURES];
+    GLuint m_finalTexture;
+    GLuint m_depthStencil;
+    unsigned int m_width;
+    unsigned int m_height;
+};
+
+
+#endif	/* GBUFFER_H */
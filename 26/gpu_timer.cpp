@@ -0,0 +1,117 @@
+#include <stdio.h>
+
+#include "gpu_timer.h"
+
+GPUTimer::GPUTimer()
+{
+    for (unsigned int i = 0 ; i < NUM_QUERIES ; i++) {
+        m_queries[i] = 0;
+        m_pending[i] = false;
+    }
+
+    m_next = 0;
+    m_active = false;
+    m_totalMs = 0.0;
+    m_numSamples = 0;
+}
+
+
+GPUTimer::~GPUTimer()
+{
+    if (m_queries[0] != 0) {
+        glDeleteQueries(NUM_QUERIES, m_queries);
+    }
+}
+
+
+bool GPUTimer::Init()
+{
+    glGenQueries(NUM_QUERIES, m_queries);
+
+    GLenum Error = glGetError();
+
+    if (Error != GL_NO_ERROR) {
+        fprintf(stderr, "Error creating timer queries: 0x%x\n", Error);
+        return false;
+    }
+
+    return true;
+}
+
+
+void GPUTimer::Begin()
+{
+    Collect();
+
+    m_active = !m_pending[m_next];
+
+    if (m_active) {
+        glBeginQuery(GL_TIME_ELAPSED, m_queries[m_next]);
+    }
+}
+
+
+void GPUTimer::End()
+{
+    if (!m_active) {
+        return;
+    }
+
+    glEndQuery(GL_TIME_ELAPSED);
+
+    m_pending[m_next] = true;
+    m_next = (m_next + 1) % NUM_QUERIES;
+    m_active = false;
+}
+
+
+void GPUTimer::Collect()
+{
+    for (unsigned int i = 0 ; i < NUM_QUERIES ; i++) {
+        if (!m_pending[i]) {
+            continue;
+        }
+
+        GLint Available = 0;
+        glGetQueryObjectiv(m_queries[i], GL_QUERY_RESULT_AVAILABLE, &Available);
+
+        if (!Available) {
+            continue;
+        }
+
+        GLuint64 Elapsed = 0;
+        glGetQueryObjectui64v(m_queries[i], GL_QUERY_RESULT, &Elapsed);
+
+        m_totalMs += Elapsed / 1000000.0;
+        m_numSamples++;
+        m_pending[i] = false;
+    }
+}
+
+
+float GPUTimer::GetAverageMs()
+{
+    Collect();
+
+    return m_numSamples ? (float)(m_totalMs / m_numSamples) : 0.0f;
+}
+
+
+unsigned int GPUTimer::GetNumSamples()
+{
+    Collect();
+
+    return m_numSamples;
+}
+
+
+void GPUTimer::Reset()
+{
+    // Queries still in flight belong to the old measurement
+    for (unsigned int i = 0 ; i < NUM_QUERIES ; i++) {
+        m_pending[i] = false;
+    }
+
+    m_totalMs = 0.0;
+    m_numSamples = 0;
+}
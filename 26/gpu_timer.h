@@ -0,0 +1,47 @@
+#ifndef GPU_TIMER_H
+#define	GPU_TIMER_H
+
+#include <GL/glew.h>
+
+// Measures the GPU time of the commands between Begin() and End() with
+// GL_TIME_ELAPSED queries. A few queries are kept in flight and only read
+// back once their result is available, so the CPU never waits on the GPU.
+// Frames for which no query is free are simply not measured.
+class GPUTimer
+{
+public:
+
+    GPUTimer();
+
+    ~GPUTimer();
+
+    bool Init();
+
+    void Begin();
+
+    void End();
+
+    // Average over the frames measured since the last Reset()
+    float GetAverageMs();
+
+    unsigned int GetNumSamples();
+
+    void Reset();
+
+private:
+
+    static const unsigned int NUM_QUERIES = 4;
+
+    void Collect();
+
+    GLuint m_queries[NUM_QUERIES];
+    bool m_pending[NUM_QUERIES];
+    unsigned int m_next;
+    bool m_active;
+
+    double m_totalMs;
+    unsigned int m_numSamples;
+};
+
+
+#endif	/* GPU_TIMER_H */
@@ -0,0 +1,430 @@
+#include <float.h>
+#include <string.h>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include "light_clusters.h"
+#include "math_batch.h"
+#include "engine_common.h"
+#include "util.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define LIGHT_CLUSTERS_SSE
+#include <xmmintrin.h>
+#endif
+
+static const float POINT_LIGHT_TYPE = 0.0f;
+static const float SPOT_LIGHT_TYPE = 1.0f;
+
+
+// Index of the tile containing the NDC coordinate, clamped to the grid
+static int NDCToTile(float NDC, unsigned int Dim)
+{
+    if (NDC < -1.0f) NDC = -1.0f;
+    if (NDC > 1.0f) NDC = 1.0f;
+
+    int Tile = (int)((NDC * 0.5f + 0.5f) * Dim);
+    return Tile < (int)Dim ? Tile : (int)Dim - 1;
+}
+
+
+LightClusters::LightClusters()
+{
+    m_dimX = 0;
+    m_dimY = 0;
+    m_dimZ = 0;
+    m_screenWidth = 0;
+    m_screenHeight = 0;
+
+    memset(&m_projInfo, 0, sizeof(m_projInfo));
+    m_tanHalfFOVX = 0.0f;
+    m_tanHalfFOVY = 0.0f;
+
+    m_lightsDirty = true;
+
+    for (unsigned int i = 0 ; i < NUM_TBOS ; i++) {
+        m_buffers[i] = INVALID_OGL_VALUE;
+        m_textures[i] = INVALID_OGL_VALUE;
+    }
+
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+
+LightClusters::~LightClusters()
+{
+    for (unsigned int i = 0 ; i < NUM_TBOS ; i++) {
+        if (m_textures[i] != INVALID_OGL_VALUE) {
+            glDeleteTextures(1, &m_textures[i]);
+        }
+
+        if (m_buffers[i] != INVALID_OGL_VALUE) {
+            glDeleteBuffers(1, &m_buffers[i]);
+        }
+    }
+}
+
+
+bool LightClusters::Init(unsigned int DimX, unsigned int DimY, unsigned int DimZ,
+                         unsigned int ScreenWidth, unsigned int ScreenHeight)
+{
+    m_dimX = DimX;
+    m_dimY = DimY;
+    m_dimZ = DimZ;
+    m_screenWidth = ScreenWidth;
+    m_screenHeight = ScreenHeight;
+
+    const unsigned int NumClusters = m_dimX * m_dimY * m_dimZ;
+
+    m_clusterLights.resize(NumClusters * MAX_LIGHTS_PER_CLUSTER);
+    m_clusterCounts.resize(NumClusters);
+    m_grid.resize(NumClusters * 2);
+
+    const GLenum Formats[NUM_TBOS] = { GL_RGBA32F, GL_RG32UI, GL_R16UI };
+
+    glGenBuffers(NUM_TBOS, m_buffers);
+    glGenTextures(NUM_TBOS, m_textures);
+
+    for (unsigned int i = 0 ; i < NUM_TBOS ; i++) {
+        Upload(i, NULL, 0);
+
+        glBindTexture(GL_TEXTURE_BUFFER, m_textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, Formats[i], m_buffers[i]);
+    }
+
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    GLenum Error = glGetError();
+
+    if (Error != GL_NO_ERROR) {
+        fprintf(stderr, "Error creating the light cluster buffers: 0x%x\n", Error);
+        return false;
+    }
+
+    return true;
+}
+
+
+void LightClusters::SetProjection(const PersProjInfo& ProjInfo)
+{
+    m_projInfo = ProjInfo;
+    m_tanHalfFOVY = tanf(glm::radians(ProjInfo.FOV / 2.0f));
+    m_tanHalfFOVX = m_tanHalfFOVY * ProjInfo.Width / ProjInfo.Height;
+
+    // Exponential slices keep the clusters roughly cubic along the view direction
+    m_sliceNear.resize(m_dimZ + 1);
+
+    for (unsigned int k = 0 ; k <= m_dimZ ; k++) {
+        m_sliceNear[k] = ProjInfo.zNear * powf(ProjInfo.zFar / ProjInfo.zNear, (float)k / m_dimZ);
+    }
+
+    const unsigned int NumClusters = m_dimX * m_dimY * m_dimZ;
+
+    m_minX.assign(NumClusters + 3, FLT_MAX);
+    m_maxX.assign(NumClusters + 3, -FLT_MAX);
+    m_minY.assign(NumClusters + 3, FLT_MAX);
+    m_maxY.assign(NumClusters + 3, -FLT_MAX);
+
+    for (unsigned int k = 0 ; k < m_dimZ ; k++) {
+        const float z0 = m_sliceNear[k];
+        const float z1 = m_sliceNear[k + 1];
+
+        for (unsigned int j = 0 ; j < m_dimY ; j++) {
+            const float y0 = (-1.0f + 2.0f * j / m_dimY) * m_tanHalfFOVY;
+            const float y1 = (-1.0f + 2.0f * (j + 1) / m_dimY) * m_tanHalfFOVY;
+
+            for (unsigned int i = 0 ; i < m_dimX ; i++) {
+                const float x0 = (-1.0f + 2.0f * i / m_dimX) * m_tanHalfFOVX;
+                const float x1 = (-1.0f + 2.0f * (i + 1) / m_dimX) * m_tanHalfFOVX;
+                const unsigned int c = (k * m_dimY + j) * m_dimX + i;
+
+                // The tile edges are planes through the eye, so the extremes
+                // are at either the near or the far end of the slice
+                m_minX[c] = fminf(x0 * z0, x0 * z1);
+                m_maxX[c] = fmaxf(x1 * z0, x1 * z1);
+                m_minY[c] = fminf(y0 * z0, y0 * z1);
+                m_maxY[c] = fmaxf(y1 * z0, y1 * z1);
+            }
+        }
+    }
+}
+
+
+void LightClusters::AddLight(const PointLight& Light, float Type, const Vector3f& Direction, float CosCutoff)
+{
+    m_lightData.push_back(Vector4f(Light.Position.x, Light.Position.y, Light.Position.z, Type));
+    m_lightData.push_back(Vector4f(Light.Color.x, Light.Color.y, Light.Color.z, Light.DiffuseIntensity));
+    m_lightData.push_back(Vector4f(Light.Attenuation.Constant, Light.Attenuation.Linear,
+                                   Light.Attenuation.Exp, Light.AmbientIntensity));
+    m_lightData.push_back(Vector4f(Direction.x, Direction.y, Direction.z, CosCutoff));
+
+    m_lightPos.push_back(Light.Position);
+    m_lightRadius.push_back(CalcLightRange(Light));
+}
+
+
+void LightClusters::SetLights(unsigned int NumPointLights, const PointLight* pPointLights,
+                              unsigned int NumSpotLights, const SpotLight* pSpotLights)
+{
+    if (NumPointLights > MAX_LIGHTS) {
+        NumPointLights = MAX_LIGHTS;
+    }
+
+    if (NumSpotLights > MAX_LIGHTS - NumPointLights) {
+        NumSpotLights = MAX_LIGHTS - NumPointLights;
+    }
+
+    m_lightData.clear();
+    m_lightPos.clear();
+    m_lightRadius.clear();
+
+    for (unsigned int i = 0 ; i < NumPointLights ; i++) {
+        AddLight(pPointLights[i], POINT_LIGHT_TYPE, Vector3f(0.0f, 0.0f, 0.0f), 0.0f);
+    }
+
+    // Spot lights are bounded by the sphere of their range, which is
+    // conservative but keeps the assignment identical for both types
+    for (unsigned int i = 0 ; i < NumSpotLights ; i++) {
+        Vector3f Direction = pSpotLights[i].Direction;
+        Direction.Normalize();
+        AddLight(pSpotLights[i], SPOT_LIGHT_TYPE, Direction, cosf(glm::radians(pSpotLights[i].Cutoff)));
+    }
+
+    m_lightsDirty = true;
+}
+
+
+void LightClusters::AssignLight(unsigned short Index, const Vector3f& Center, float Radius)
+{
+    const float zNear = m_sliceNear[0];
+    const float zFar = m_sliceNear[m_dimZ];
+
+    if (Radius <= 0.0f || Center.z + Radius < zNear || Center.z - Radius > zFar) {
+        return;
+    }
+
+    const float zMin = fmaxf(Center.z - Radius, zNear);
+    const float zMax = fminf(Center.z + Radius, zFar);
+
+    // Screen rectangle of the bounding box of the sphere over the clipped depth range
+    const float Left = Center.x - Radius;
+    const float Right = Center.x + Radius;
+    const float Bottom = Center.y - Radius;
+    const float Top = Center.y + Radius;
+
+    const float NDCLeft = fminf(Left / zMin, Left / zMax) / m_tanHalfFOVX;
+    const float NDCRight = fmaxf(Right / zMin, Right / zMax) / m_tanHalfFOVX;
+    const float NDCBottom = fminf(Bottom / zMin, Bottom / zMax) / m_tanHalfFOVY;
+    const float NDCTop = fmaxf(Top / zMin, Top / zMax) / m_tanHalfFOVY;
+
+    if (NDCRight < -1.0f || NDCLeft > 1.0f || NDCTop < -1.0f || NDCBottom > 1.0f) {
+        return;
+    }
+
+    const int i0 = NDCToTile(NDCLeft, m_dimX);
+    const int i1 = NDCToTile(NDCRight, m_dimX);
+    const int j0 = NDCToTile(NDCBottom, m_dimY);
+    const int j1 = NDCToTile(NDCTop, m_dimY);
+
+    const Vector2f ZParams = GetZParams();
+    int k0 = (int)(logf(zMin) * ZParams.x + ZParams.y);
+    int k1 = (int)(logf(zMax) * ZParams.x + ZParams.y);
+    k0 = k0 < 0 ? 0 : (k0 >= (int)m_dimZ ? (int)m_dimZ - 1 : k0);
+    k1 = k1 < 0 ? 0 : (k1 >= (int)m_dimZ ? (int)m_dimZ - 1 : k1);
+
+    const float RadiusSq = Radius * Radius;
+
+#ifdef LIGHT_CLUSTERS_SSE
+    const __m128 Zero = _mm_setzero_ps();
+    const __m128 CenterX = _mm_set1_ps(Center.x);
+    const __m128 CenterY = _mm_set1_ps(Center.y);
+#endif
+
+    for (int k = k0 ; k <= k1 ; k++) {
+        // Distance along z is the same for the whole slice
+        const float dz = fmaxf(m_sliceNear[k] - Center.z, 0.0f) + fmaxf(Center.z - m_sliceNear[k + 1], 0.0f);
+        const float RemainingSq = RadiusSq - dz * dz;
+
+        if (RemainingSq < 0.0f) {
+            continue;
+        }
+
+        for (int j = j0 ; j <= j1 ; j++) {
+            const unsigned int Row = (k * m_dimY + j) * m_dimX;
+
+#ifdef LIGHT_CLUSTERS_SSE
+            // Sphere against four cluster boxes at a time
+            const __m128 Remaining = _mm_set1_ps(RemainingSq);
+
+            for (int i = i0 ; i <= i1 ; i += 4) {
+                const unsigned int c = Row + i;
+
+                __m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_minX[c]), CenterX), Zero),
+                                       _mm_max_ps(_mm_sub_ps(CenterX, _mm_loadu_ps(&m_maxX[c])), Zero));
+                __m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_minY[c]), CenterY), Zero),
+                                       _mm_max_ps(_mm_sub_ps(CenterY, _mm_loadu_ps(&m_maxY[c])), Zero));
+                __m128 DistSq = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+
+                int Mask = _mm_movemask_ps(_mm_cmple_ps(DistSq, Remaining));
+
+                // Drop the lanes past the end of the rectangle
+                if (i1 - i < 3) {
+                    Mask &= (1 << (i1 - i + 1)) - 1;
+                }
+
+                for (int b = 0 ; Mask != 0 ; b++, Mask >>= 1) {
+                    if ((Mask & 1) == 0) {
+                        continue;
+                    }
+
+                    unsigned int& Count = m_clusterCounts[c + b];
+
+                    if (Count < MAX_LIGHTS_PER_CLUSTER) {
+                        m_clusterLights[(c + b) * MAX_LIGHTS_PER_CLUSTER + Count++] = Index;
+                    }
+                    else {
+                        m_stats.Dropped++;
+                    }
+                }
+            }
+#else
+            for (int i = i0 ; i <= i1 ; i++) {
+                const unsigned int c = Row + i;
+
+                const float dx = fmaxf(m_minX[c] - Center.x, 0.0f) + fmaxf(Center.x - m_maxX[c], 0.0f);
+                const float dy = fmaxf(m_minY[c] - Center.y, 0.0f) + fmaxf(Center.y - m_maxY[c], 0.0f);
+
+                if (dx * dx + dy * dy > RemainingSq) {
+                    continue;
+                }
+
+                unsigned int& Count = m_clusterCounts[c];
+
+                if (Count < MAX_LIGHTS_PER_CLUSTER) {
+                    m_clusterLights[c * MAX_LIGHTS_PER_CLUSTER + Count++] = Index;
+                }
+                else {
+                    m_stats.Dropped++;
+                }
+            }
+#endif
+        }
+    }
+}
+
+
+void LightClusters::Update(const Matrix4f& View)
+{
+    const unsigned int NumLights = (unsigned int)m_lightPos.size();
+    const unsigned int NumClusters = m_dimX * m_dimY * m_dimZ;
+
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_stats.NumLights = NumLights;
+
+    std::fill(m_clusterCounts.begin(), m_clusterCounts.end(), 0);
+
+    m_lightViewPos.resize(NumLights);
+    TransformPoints(View, m_lightPos.data(), m_lightViewPos.data(), NumLights);
+
+    for (unsigned int i = 0 ; i < NumLights ; i++) {
+        AssignLight((unsigned short)i, m_lightViewPos[i], m_lightRadius[i]);
+    }
+
+    m_indices.clear();
+
+    for (unsigned int c = 0 ; c < NumClusters ; c++) {
+        const unsigned int Count = m_clusterCounts[c];
+        const unsigned short* pList = &m_clusterLights[c * MAX_LIGHTS_PER_CLUSTER];
+
+        m_grid[c * 2] = (unsigned int)m_indices.size();
+        m_grid[c * 2 + 1] = Count;
+        m_indices.insert(m_indices.end(), pList, pList + Count);
+
+        if (Count > 0) {
+            m_stats.NonEmptyClusters++;
+        }
+
+        if (Count > m_stats.MaxLightsPerCluster) {
+            m_stats.MaxLightsPerCluster = Count;
+        }
+    }
+
+    m_stats.NumIndices = (unsigned int)m_indices.size();
+
+    if (m_lightsDirty) {
+        Upload(LIGHTS_TBO, m_lightData.data(), m_lightData.size() * sizeof(Vector4f));
+        m_lightsDirty = false;
+    }
+
+    Upload(GRID_TBO, m_grid.data(), m_grid.size() * sizeof(unsigned int));
+    Upload(INDEX_TBO, m_indices.data(), m_indices.size() * sizeof(unsigned short));
+}
+
+
+void LightClusters::Upload(unsigned int Tbo, const void* pData, unsigned int Size)
+{
+    glBindBuffer(GL_TEXTURE_BUFFER, m_buffers[Tbo]);
+
+    // Orphan the previous storage so that the upload does not wait for the
+    // frame which is still reading it. Empty buffers keep one texel.
+    glBufferData(GL_TEXTURE_BUFFER, Size > 0 ? Size : 16, NULL, GL_STREAM_DRAW);
+
+    if (Size > 0) {
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, Size, pData);
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+
+void LightClusters::Bind()
+{
+    glActiveTexture(CLUSTER_LIGHTS_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, m_textures[LIGHTS_TBO]);
+    glActiveTexture(CLUSTER_GRID_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, m_textures[GRID_TBO]);
+    glActiveTexture(CLUSTER_INDEX_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, m_textures[INDEX_TBO]);
+}
+
+
+Vector3f LightClusters::GetDims() const
+{
+    return Vector3f((float)m_dimX, (float)m_dimY, (float)m_dimZ);
+}
+
+
+Vector2f LightClusters::GetTileSize() const
+{
+    return Vector2f((float)m_screenWidth / m_dimX, (float)m_screenHeight / m_dimY);
+}
+
+
+Vector2f LightClusters::GetZParams() const
+{
+    const float LogRange = logf(m_projInfo.zFar / m_projInfo.zNear);
+
+    return Vector2f(m_dimZ / LogRange, -(float)m_dimZ * logf(m_projInfo.zNear) / LogRange);
+}
+
+
+const LightClusterStats& LightClusters::GetStats() const
+{
+    return m_stats;
+}
+
+
+void LightClusters::PrintStats() const
+{
+    const unsigned int NumClusters = m_dimX * m_dimY * m_dimZ;
+
+    printf("Light clusters: %u lights, %u/%u clusters in use, %u indices, max %u per cluster, avg %.1f per used cluster",
+           m_stats.NumLights, m_stats.NonEmptyClusters, NumClusters, m_stats.NumIndices, m_stats.MaxLightsPerCluster,
+           m_stats.NonEmptyClusters ? (float)m_stats.NumIndices / m_stats.NonEmptyClusters : 0.0f);
+
+    if (m_stats.Dropped > 0) {
+        printf(", %u dropped", m_stats.Dropped);
+    }
+
+    printf("\n");
+}
@@ -0,0 +1,121 @@
+#ifndef LIGHT_CLUSTERS_H
+#define	LIGHT_CLUSTERS_H
+
+#include <vector>
+#include <GL/glew.h>
+
+#include "math_3d.h"
+#include "lighting_technique.h"
+
+struct LightClusterStats
+{
+    unsigned int NumLights;
+    unsigned int NumIndices;
+    unsigned int NonEmptyClusters;
+    unsigned int MaxLightsPerCluster;
+    unsigned int Dropped;
+};
+
+// Clustered forward lighting. The view frustum is split into a grid of screen
+// tiles times exponential depth slices and every cluster gets the list of the
+// lights whose range touches it. The lists are built on the CPU each frame
+// and handed to the lighting shader in three texture buffers:
+//
+//   lights   GL_RGBA32F, four texels per light (see SetLights())
+//   grid     GL_RG32UI, offset and count of the list of each cluster
+//   indices  GL_R16UI, the concatenated light lists
+//
+// The fragment shader finds its cluster from gl_FragCoord and only loops over
+// the lights in that list.
+class LightClusters
+{
+public:
+
+    static const unsigned int MAX_LIGHTS = 1024;
+    static const unsigned int MAX_LIGHTS_PER_CLUSTER = 128;
+
+    LightClusters();
+
+    ~LightClusters();
+
+    bool Init(unsigned int DimX, unsigned int DimY, unsigned int DimZ,
+              unsigned int ScreenWidth, unsigned int ScreenHeight);
+
+    // Rebuilds the view space bounds of the clusters
+    void SetProjection(const PersProjInfo& ProjInfo);
+
+    // Point lights get the indices [0, NumPointLights) followed by the spot
+    // lights. The range of a light is where its attenuation drops below 1/256.
+    void SetLights(unsigned int NumPointLights, const PointLight* pPointLights,
+                   unsigned int NumSpotLights, const SpotLight* pSpotLights);
+
+    // Assigns the lights to the clusters for the given camera and uploads the lists
+    void Update(const Matrix4f& View);
+
+    void Bind();
+
+    Vector3f GetDims() const;
+    Vector2f GetTileSize() const;
+
+    // Scale and bias which turn log(view depth) into the slice index
+    Vector2f GetZParams() const;
+
+    const LightClusterStats& GetStats() const;
+
+    void PrintStats() const;
+
+private:
+
+    enum {
+        LIGHTS_TBO,
+        GRID_TBO,
+        INDEX_TBO,
+        NUM_TBOS
+    };
+
+    void AddLight(const PointLight& Light, float Type, const Vector3f& Direction, float CosCutoff);
+    void AssignLight(unsigned short Index, const Vector3f& Center, float Radius);
+    void Upload(unsigned int Tbo, const void* pData, unsigned int Size);
+
+    unsigned int m_dimX;
+    unsigned int m_dimY;
+    unsigned int m_dimZ;
+    unsigned int m_screenWidth;
+    unsigned int m_screenHeight;
+
+    PersProjInfo m_projInfo;
+    float m_tanHalfFOVX;
+    float m_tanHalfFOVY;
+
+    // View space bounds of the clusters, x is the fastest changing index. The
+    // x/y arrays are padded so that the last tile of a row can be loaded four
+    // at a time.
+    std::vector<float> m_minX;
+    std::vector<float> m_maxX;
+    std::vector<float> m_minY;
+    std::vector<float> m_maxY;
+    std::vector<float> m_sliceNear;
+
+    // World space light data as uploaded, plus the bounding sphere of each light
+    std::vector<Vector4f> m_lightData;
+    std::vector<Vector3f> m_lightPos;
+    std::vector<float> m_lightRadius;
+    bool m_lightsDirty;
+
+    // Centers of the bounding spheres in view space, rebuilt by Update()
+    std::vector<Vector3f> m_lightViewPos;
+
+    // Per cluster scratch lists, compacted into m_grid/m_indices after assignment
+    std::vector<unsigned short> m_clusterLights;
+    std::vector<unsigned int> m_clusterCounts;
+    std::vector<unsigned int> m_grid;
+    std::vector<unsigned short> m_indices;
+
+    GLuint m_buffers[NUM_TBOS];
+    GLuint m_textures[NUM_TBOS];
+
+    LightClusterStats m_stats;
+};
+
+
+#endif	/* LIGHT_CLUSTERS_H */
@@ -1,9 +1,10 @@
 #include <limits.h>
+#include <float.h>
 #include <string.h>
 
 #include "lighting_technique.h"
 #include "util.h"
-#include <glm/glm.hpp>
+#include "engine_common.h"
 
 static const char* pVS = R"(                                                          
 #version 330                                                                        
@@ -13,39 +14,78 @@ layout (location = 1) in vec2 TexCoord;
 layout (location = 2) in vec3 Normal;                                               
 layout (location = 3) in vec3 Tangent;                                              
                                                                                     
-uniform mat4 gWVP;                                                                  
-uniform mat4 gLightWVP;                                                             
+struct BaseLight                                                                    
+{                                                                                   
+    vec3 Color;                                                                     
+    float AmbientIntensity;                                                         
+    float DiffuseIntensity;                                                         
+};                                                                                  
+                                                                                    
+struct DirectionalLight                                                             
+{                                                                                   
+    BaseLight Base;                                                                 
+    vec3 Direction;                                                                 
+};                                                                                  
+                                                                                    
+layout (std140, row_major) uniform PerFrame                                         
+{                                                                                   
+    mat4 gVP;                                                                       
+    mat4 gLightVP;                                                                  
+    vec3 gEyeWorldPos;                                                              
+    DirectionalLight gDirectionalLight;                                             
+};                                                                                  
+                                                                                    
 uniform mat4 gWorld;                                                                
                                                                                     
+invariant gl_Position;                                                              
+                                                                                    
 out vec4 LightSpacePos;                                                             
 out vec2 TexCoord0;                                                                 
 out vec3 Normal0;                                                                   
 out vec3 WorldPos0;                                                                 
-out vec3 Tangent0;                                                                  
-                                                                                    
-void main()                                                                         
+out vec3 Tangent0;                                                                          
+                                                                                            
+// Directional light and eye vector in the tangent space of the vertex. The                 
+// fragment shader lights the normal map sample directly with them.                         
+#ifdef TANGENT_SPACE_LIGHTING                                                               
+out vec3 TangentLightDir0;                                                                  
+out vec3 TangentEyeDir0;                                                                    
+#endif                                                                                      
+                                                                                            
+void main()                                                                                 
 {                                                                                   
-    gl_Position   = gWVP * vec4(Position, 1.0);                                     
-    LightSpacePos = gLightWVP * vec4(Position, 1.0);                                
+    vec4 WorldPos = gWorld * vec4(Position, 1.0);                                   
+    gl_Position   = gVP * WorldPos;                                                 
+    LightSpacePos = gLightVP * WorldPos;                                            
     TexCoord0     = TexCoord;                                                       
     Normal0       = (gWorld * vec4(Normal, 0.0)).xyz;                               
     Tangent0      = (gWorld * vec4(Tangent, 0.0)).xyz;                              
-    WorldPos0     = (gWorld * vec4(Position, 1.0)).xyz;                             
-})";
+    WorldPos0     = WorldPos.xyz;                                                           
+                                                                                            
+#ifdef TANGENT_SPACE_LIGHTING                                                               
+    vec3 N = normalize(Normal0);                                                            
+    vec3 T = normalize(Tangent0 - dot(Tangent0, N) * N);                                    
+    mat3 WorldToTangent = transpose(mat3(T, cross(T, N), N));                               
+    TangentLightDir0 = WorldToTangent * gDirectionalLight.Direction;                        
+    TangentEyeDir0   = WorldToTangent * (gEyeWorldPos - WorldPos.xyz);                      
+#endif                                                                                      
+})";                                                                                        
 
 static const char* pFS = R"(                                                          
 #version 330                                                                        
                                                                                     
-const int MAX_POINT_LIGHTS = 2;                                                     
-const int MAX_SPOT_LIGHTS = 2;                                                      
-                                                                                    
 in vec4 LightSpacePos;                                                              
 in vec2 TexCoord0;                                                                  
 in vec3 Normal0;                                                                    
 in vec3 WorldPos0;                                                                  
-in vec3 Tangent0;                                                                   
-                                                                                    
-out vec4 FragColor;                                                                 
+in vec3 Tangent0;                                                                           
+                                                                                            
+#ifdef TANGENT_SPACE_LIGHTING                                                               
+in vec3 TangentLightDir0;                                                                   
+in vec3 TangentEyeDir0;                                                                     
+#endif                                                                                      
+                                                                                            
+out vec4 FragColor;                                                                         
                                                                                     
 struct BaseLight                                                                    
 {                                                                                   
@@ -81,15 +121,23 @@ struct SpotLight
     float Cutoff;                                                                           
 };                                                                                          
                                                                                             
-uniform int gNumPointLights;                                                                
-uniform int gNumSpotLights;                                                                 
-uniform DirectionalLight gDirectionalLight;                                                 
-uniform PointLight gPointLights[MAX_POINT_LIGHTS];                                          
-uniform SpotLight gSpotLights[MAX_SPOT_LIGHTS];                                             
+layout (std140, row_major) uniform PerFrame                                                 
+{                                                                                           
+    mat4 gVP;                                                                               
+    mat4 gLightVP;                                                                          
+    vec3 gEyeWorldPos;                                                                      
+    DirectionalLight gDirectionalLight;                                                     
+};                                                                                          
+                                                                                            
 uniform sampler2D gColorMap;                                                                
 uniform sampler2D gShadowMap;                                                               
 uniform sampler2D gNormalMap;                                                               
-uniform vec3 gEyeWorldPos;                                                                  
+uniform samplerBuffer gClusterLights;                                                       
+uniform usamplerBuffer gClusterGrid;                                                        
+uniform usamplerBuffer gClusterIndices;                                                     
+uniform vec3 gClusterDims;                                                                  
+uniform vec2 gClusterTileSize;                                                              
+uniform vec2 gClusterZParams;                                                               
 uniform float gMatSpecularIntensity;                                                        
 uniform float gSpecularPower;                                                               
                                                                                             
@@ -106,8 +154,8 @@ float CalcShadowFactor(vec4 LightSpacePos)
         return 1.0;                                                                         
 }                                                                                           
                                                                                             
-vec4 CalcLightInternal(BaseLight Light, vec3 LightDirection, vec3 Normal,            
-                       float ShadowFactor)                                                  
+vec4 CalcLightInternal(BaseLight Light, vec3 LightDirection, vec3 Normal,                   
+                       vec3 VertexToEye, float ShadowFactor)                                
 {                                                                                           
     vec4 AmbientColor = vec4(Light.Color, 1.0f) * Light.AmbientIntensity;                   
     float DiffuseFactor = dot(Normal, -LightDirection);                                     
@@ -118,7 +166,6 @@ vec4 CalcLightInternal(BaseLight Light, vec3 LightDirection, vec3 Normal,
     if (DiffuseFactor > 0) {                                                                
         DiffuseColor = vec4(Light.Color, 1.0f) * Light.DiffuseIntensity * DiffuseFactor;    
                                                                                             
-        vec3 VertexToEye = normalize(gEyeWorldPos - WorldPos0);                             
         vec3 LightReflect = normalize(reflect(LightDirection, Normal));                     
         float SpecularFactor = dot(VertexToEye, LightReflect);                              
         SpecularFactor = pow(SpecularFactor, gSpecularPower);                               
@@ -131,19 +178,20 @@ vec4 CalcLightInternal(BaseLight Light, vec3 LightDirection, vec3 Normal,
     return (AmbientColor + ShadowFactor * (DiffuseColor + SpecularColor));                  
 }                                                                                           
                                                                                             
-vec4 CalcDirectionalLight(vec3 Normal)                                                      
-{                                                                                                
-    return CalcLightInternal(gDirectionalLight.Base, gDirectionalLight.Direction, Normal, 1.0);  
-}                                                                                                
+// Normal, LightDirection and VertexToEye are in the same space, world or tangent           
+vec4 CalcDirectionalLight(vec3 Normal, vec3 LightDirection, vec3 VertexToEye)               
+{                                                                                           
+    return CalcLightInternal(gDirectionalLight.Base, LightDirection, Normal, VertexToEye, 1.0);
+}                                                                                           
                                                                                             
-vec4 CalcPointLight(PointLight l, vec3 Normal, vec4 LightSpacePos)                   
+vec4 CalcPointLight(PointLight l, vec3 Normal, float ShadowFactor)                          
 {                                                                                           
     vec3 LightDirection = WorldPos0 - l.Position;                                           
     float Distance = length(LightDirection);                                                
     LightDirection = normalize(LightDirection);                                             
-    float ShadowFactor = CalcShadowFactor(LightSpacePos);                                   
                                                                                             
-    vec4 Color = CalcLightInternal(l.Base, LightDirection, Normal, ShadowFactor);           
+    vec3 VertexToEye = normalize(gEyeWorldPos - WorldPos0);                                 
+    vec4 Color = CalcLightInternal(l.Base, LightDirection, Normal, VertexToEye, ShadowFactor);
     float Attenuation =  l.Atten.Constant +                                                 
                          l.Atten.Linear * Distance +                                        
                          l.Atten.Exp * Distance * Distance;                                 
@@ -151,13 +199,13 @@ vec4 CalcPointLight(PointLight l, vec3 Normal, vec4 LightSpacePos)
     return Color / Attenuation;                                                             
 }                                                                                           
                                                                                             
-vec4 CalcSpotLight(SpotLight l, vec3 Normal, vec4 LightSpacePos)                     
+vec4 CalcSpotLight(SpotLight l, vec3 Normal, float ShadowFactor)                            
 {                                                                                           
     vec3 LightToPixel = normalize(WorldPos0 - l.Base.Position);                             
     float SpotFactor = dot(LightToPixel, l.Direction);                                      
                                                                                             
     if (SpotFactor > l.Cutoff) {                                                            
-        vec4 Color = CalcPointLight(l.Base, Normal, LightSpacePos);                         
+        vec4 Color = CalcPointLight(l.Base, Normal, ShadowFactor);                          
         return Color * (1.0 - (1.0 - SpotFactor) * 1.0/(1.0 - l.Cutoff));                   
     }                                                                                       
     else {                                                                                  
@@ -165,14 +213,53 @@ vec4 CalcSpotLight(SpotLight l, vec3 Normal, vec4 LightSpacePos)
     }                                                                                       
 }                                                                                           
                                                                                             
-vec3 CalcBumpedNormal()                                                                     
+// Four texels per light, see LightClusters::SetLights()                                    
+vec4 CalcClusterLight(int Index, vec3 Normal)                                               
+{                                                                                           
+    vec4 PosType = texelFetch(gClusterLights, Index * 4);                                   
+    vec4 ColorDiffuse = texelFetch(gClusterLights, Index * 4 + 1);                          
+    vec4 AttenAmbient = texelFetch(gClusterLights, Index * 4 + 2);                          
+                                                                                            
+    PointLight l;                                                                           
+    l.Base.Color = ColorDiffuse.rgb;                                                        
+    l.Base.AmbientIntensity = AttenAmbient.w;                                               
+    l.Base.DiffuseIntensity = ColorDiffuse.w;                                               
+    l.Position = PosType.xyz;                                                               
+    l.Atten.Constant = AttenAmbient.x;                                                      
+    l.Atten.Linear = AttenAmbient.y;                                                        
+    l.Atten.Exp = AttenAmbient.z;                                                           
+                                                                                            
+    if (PosType.w == 0.0) {                                                                 
+        return CalcPointLight(l, Normal, 1.0);                                              
+    }                                                                                       
+                                                                                            
+    vec4 DirCutoff = texelFetch(gClusterLights, Index * 4 + 3);                             
+                                                                                            
+    SpotLight s;                                                                            
+    s.Base = l;                                                                             
+    s.Direction = DirCutoff.xyz;                                                            
+    s.Cutoff = DirCutoff.w;                                                                 
+                                                                                            
+    return CalcSpotLight(s, Normal, 1.0);                                                   
+}                                                                                           
+                                                                                            
+// Index of the grid cell holding this fragment, the slice comes from the                   
+// view depth which is 1/gl_FragCoord.w for a perspective projection                        
+int CalcClusterIndex()                                                                      
+{                                                                                           
+    ivec3 Dims = ivec3(gClusterDims);                                                       
+    ivec2 Tile = ivec2(gl_FragCoord.xy / gClusterTileSize);                                 
+    float Slice = log(1.0 / gl_FragCoord.w) * gClusterZParams.x + gClusterZParams.y;        
+    ivec3 Cluster = clamp(ivec3(Tile, int(max(Slice, 0.0))), ivec3(0), Dims - 1);           
+    return (Cluster.z * Dims.y + Cluster.y) * Dims.x + Cluster.x;                           
+}                                                                                           
+                                                                                            
+vec3 CalcBumpedNormal(vec3 BumpMapNormal)                                                   
 {                                                                                           
     vec3 Normal = normalize(Normal0);                                                       
     vec3 Tangent = normalize(Tangent0);                                                     
     Tangent = normalize(Tangent - dot(Tangent, Normal) * Normal);                           
     vec3 Bitangent = cross(Tangent, Normal);                                                
-    vec3 BumpMapNormal = texture(gNormalMap, TexCoord0).xyz;                                
-    BumpMapNormal = 2.0 * BumpMapNormal - vec3(1.0, 1.0, 1.0);                              
     vec3 NewNormal;                                                                         
     mat3 TBN = mat3(Tangent, Bitangent, Normal);                                            
     NewNormal = TBN * BumpMapNormal;                                                        
@@ -182,15 +269,29 @@ vec3 CalcBumpedNormal()
                                                                                             
 void main()                                                                                 
 {                                                                                           
-    vec3 Normal = CalcBumpedNormal();                                                       
-    vec4 TotalLight = CalcDirectionalLight(Normal);                                         
+    vec3 BumpMapNormal = 2.0 * texture(gNormalMap, TexCoord0).xyz - vec3(1.0, 1.0, 1.0);    
                                                                                             
-    for (int i = 0 ; i < gNumPointLights ; i++) {                                           
-        TotalLight += CalcPointLight(gPointLights[i], Normal, LightSpacePos);               
-    }                                                                                       
+#ifdef TANGENT_SPACE_LIGHTING                                                               
+    vec4 TotalLight = CalcDirectionalLight(normalize(BumpMapNormal),                        
+                                           normalize(TangentLightDir0),                     
+                                           normalize(TangentEyeDir0));                      
+#else                                                                                       
+    vec3 Normal = CalcBumpedNormal(BumpMapNormal);                                          
+    vec4 TotalLight = CalcDirectionalLight(Normal, gDirectionalLight.Direction,             
+                                           normalize(gEyeWorldPos - WorldPos0));            
+#endif                                                                                      
+                                                                                            
+    uvec2 Grid = texelFetch(gClusterGrid, CalcClusterIndex()).xy;                           
+                                                                                            
+#ifdef TANGENT_SPACE_LIGHTING                                                               
+    // The local lights are still evaluated in world space, only pay for the                
+    // TBN transform where the cluster has any                                              
+    vec3 Normal = Grid.y > 0u ? CalcBumpedNormal(BumpMapNormal) : vec3(0.0);                
+#endif                                                                                      
                                                                                             
-    for (int i = 0 ; i < gNumSpotLights ; i++) {                                            
-        TotalLight += CalcSpotLight(gSpotLights[i], Normal, LightSpacePos);                 
+    for (uint i = 0u ; i < Grid.y ; i++) {                                                  
+        int Index = int(texelFetch(gClusterIndices, int(Grid.x + i)).r);                    
+        TotalLight += CalcClusterLight(Index, Normal);                                      
     }                                                                                       
                                                                                             
     vec4 SampledColor = texture2D(gColorMap, TexCoord0.xy);                                 
@@ -198,9 +299,41 @@ void main()
 })";
 
 
+// Intensity below which a light is considered to have no effect
+static const float LIGHT_CUTOFF = 256.0f;
+
+
+float CalcLightRange(const PointLight& Light)
+{
+    float MaxChannel = Light.Color.x;
+
+    if (Light.Color.y > MaxChannel) MaxChannel = Light.Color.y;
+    if (Light.Color.z > MaxChannel) MaxChannel = Light.Color.z;
+
+    // Solve Exp * d^2 + Linear * d + Constant = Intensity * LIGHT_CUTOFF
+    const float c = Light.Attenuation.Constant - MaxChannel * (Light.DiffuseIntensity + Light.AmbientIntensity) * LIGHT_CUTOFF;
+
+    if (c >= 0.0f) {
+        return 0.0f;
+    }
 
-LightingTechnique::LightingTechnique()
+    if (Light.Attenuation.Exp > 0.0f) {
+        const float a = Light.Attenuation.Exp;
+        const float b = Light.Attenuation.Linear;
+        return (-b + sqrtf(b * b - 4.0f * a * c)) / (2.0f * a);
+    }
+
+    if (Light.Attenuation.Linear > 0.0f) {
+        return -c / Light.Attenuation.Linear;
+    }
+
+    return FLT_MAX;
+}
+
+
+LightingTechnique::LightingTechnique(LightingSpace Space)
 {   
+    m_lightingSpace = Space;
 }
 
 bool LightingTechnique::Init()
@@ -209,11 +342,13 @@ bool LightingTechnique::Init()
         return false;
     }
 
-    if (!AddShader(GL_VERTEX_SHADER, pVS)) {
+    const char* pDefines = (m_lightingSpace == LIGHTING_SPACE_TANGENT) ? "#define TANGENT_SPACE_LIGHTING\n" : NULL;
+
+    if (!AddShader(GL_VERTEX_SHADER, pVS, pDefines)) {
         return false;
     }
 
-    if (!AddShader(GL_FRAGMENT_SHADER, pFS)) {
+    if (!AddShader(GL_FRAGMENT_SHADER, pFS, pDefines)) {
         return false;
     }
 
@@ -221,216 +356,80 @@ bool LightingTechnique::Init()
         return false;
     }
 
-    m_WVPLocation = GetUniformLocation("gWVP");
-    m_LightWVPLocation = GetUniformLocation("gLightWVP");
-    m_WorldMatrixLocation = GetUniformLocation("gWorld");
-    m_colorMapLocation = GetUniformLocation("gColorMap");
-    m_shadowMapLocation = GetUniformLocation("gShadowMap");
-    m_normalMapLocation = GetUniformLocation("gNormalMap");
-    m_eyeWorldPosLocation = GetUniformLocation("gEyeWorldPos");
-    m_dirLightLocation.Color = GetUniformLocation("gDirectionalLight.Base.Color");
-    m_dirLightLocation.AmbientIntensity = GetUniformLocation("gDirectionalLight.Base.AmbientIntensity");
-    m_dirLightLocation.Direction = GetUniformLocation("gDirectionalLight.Direction");
-    m_dirLightLocation.DiffuseIntensity = GetUniformLocation("gDirectionalLight.Base.DiffuseIntensity");
-    m_matSpecularIntensityLocation = GetUniformLocation("gMatSpecularIntensity");
-    m_matSpecularPowerLocation = GetUniformLocation("gSpecularPower");
-    m_numPointLightsLocation = GetUniformLocation("gNumPointLights");
-    m_numSpotLightsLocation = GetUniformLocation("gNumSpotLights");
-
-    if (m_dirLightLocation.AmbientIntensity == INVALID_UNIFORM_LOCATION ||
-        m_WVPLocation == INVALID_UNIFORM_LOCATION ||
-        m_LightWVPLocation == INVALID_UNIFORM_LOCATION ||
-        m_WorldMatrixLocation == INVALID_UNIFORM_LOCATION ||
-        m_colorMapLocation == INVALID_UNIFORM_LOCATION ||
-        m_shadowMapLocation == INVALID_UNIFORM_LOCATION ||
-        m_normalMapLocation == INVALID_UNIFORM_LOCATION ||
-        m_eyeWorldPosLocation == INVALID_UNIFORM_LOCATION ||
-        m_dirLightLocation.Color == INVALID_UNIFORM_LOCATION ||
-        m_dirLightLocation.DiffuseIntensity == INVALID_UNIFORM_LOCATION ||
-        m_dirLightLocation.Direction == INVALID_UNIFORM_LOCATION ||
-        m_matSpecularIntensityLocation == INVALID_UNIFORM_LOCATION ||
-        m_matSpecularPowerLocation == INVALID_UNIFORM_LOCATION ||
-        m_numPointLightsLocation == INVALID_UNIFORM_LOCATION ||
-        m_numSpotLightsLocation == INVALID_UNIFORM_LOCATION) {
+    m_WorldMatrixLocation = GetUniformLocation(UNIFORM_ID("gWorld"));
+    m_colorMapLocation = GetUniformLocation(UNIFORM_ID("gColorMap"));
+    m_shadowMapLocation = GetUniformLocation(UNIFORM_ID("gShadowMap"));
+    m_normalMapLocation = GetUniformLocation(UNIFORM_ID("gNormalMap"));
+    m_matSpecularIntensityLocation = GetUniformLocation(UNIFORM_ID("gMatSpecularIntensity"));
+    m_matSpecularPowerLocation = GetUniformLocation(UNIFORM_ID("gSpecularPower"));
+    m_clusterLightsLocation = GetUniformLocation(UNIFORM_ID("gClusterLights"));
+    m_clusterGridLocation = GetUniformLocation(UNIFORM_ID("gClusterGrid"));
+    m_clusterIndicesLocation = GetUniformLocation(UNIFORM_ID("gClusterIndices"));
+    m_clusterDimsLocation = GetUniformLocation(UNIFORM_ID("gClusterDims"));
+    m_clusterTileSizeLocation = GetUniformLocation(UNIFORM_ID("gClusterTileSize"));
+    m_clusterZParamsLocation = GetUniformLocation(UNIFORM_ID("gClusterZParams"));
+
+    // Any of the above may have been optimized away by the compiler. Their
+    // locations stay invalid and the matching setters do nothing, so only
+    // the world matrix and the per-frame block are really required.
+    if (m_WorldMatrixLocation == INVALID_UNIFORM_LOCATION) {
         return false;
     }
 
-    for (unsigned int i = 0 ; i < ARRAY_SIZE_IN_ELEMENTS(m_pointLightsLocation) ; i++) {
-        char Name[128];
-        memset(Name, 0, sizeof(Name));
-        snprintf(Name, sizeof(Name), "gPointLights[%d].Base.Color", i);
-        m_pointLightsLocation[i].Color = GetUniformLocation(Name);
-
-        snprintf(Name, sizeof(Name), "gPointLights[%d].Base.AmbientIntensity", i);
-        m_pointLightsLocation[i].AmbientIntensity = GetUniformLocation(Name);
-
-        snprintf(Name, sizeof(Name), "gPointLights[%d].Position", i);
-        m_pointLightsLocation[i].Position = GetUniformLocation(Name);
-
-        snprintf(Name, sizeof(Name), "gPointLights[%d].Base.DiffuseIntensity", i);
-        m_pointLightsLocation[i].DiffuseIntensity = GetUniformLocation(Name);
-
-        snprintf(Name, sizeof(Name), "gPointLights[%d].Atten.Constant", i);
-        m_pointLightsLocation[i].Atten.Constant = GetUniformLocation(Name);
-
-        snprintf(Name, sizeof(Name), "gPointLights[%d].Atten.Linear", i);
-        m_pointLightsLocation[i].Atten.Linear = GetUniformLocation(Name);
-
-        snprintf(Name, sizeof(Name), "gPointLights[%d].Atten.Exp", i);
-        m_pointLightsLocation[i].Atten.Exp = GetUniformLocation(Name);
-
-        if (m_pointLightsLocation[i].Color == INVALID_UNIFORM_LOCATION ||
-            m_pointLightsLocation[i].AmbientIntensity == INVALID_UNIFORM_LOCATION ||
-            m_pointLightsLocation[i].Position == INVALID_UNIFORM_LOCATION ||
-            m_pointLightsLocation[i].DiffuseIntensity == INVALID_UNIFORM_LOCATION ||
-            m_pointLightsLocation[i].Atten.Constant == INVALID_UNIFORM_LOCATION ||
-            m_pointLightsLocation[i].Atten.Linear == INVALID_UNIFORM_LOCATION ||
-            m_pointLightsLocation[i].Atten.Exp == INVALID_UNIFORM_LOCATION) {
-            return false;
-        }
-    }
-
-    for (unsigned int i = 0 ; i < ARRAY_SIZE_IN_ELEMENTS(m_spotLightsLocation) ; i++) {
-        char Name[128];
-        memset(Name, 0, sizeof(Name));
-        snprintf(Name, sizeof(Name), "gSpotLights[%d].Base.Base.Color", i);
-        m_spotLightsLocation[i].Color = GetUniformLocation(Name);
-
-        snprintf(Name, sizeof(Name), "gSpotLights[%d].Base.Base.AmbientIntensity", i);
-        m_spotLightsLocation[i].AmbientIntensity = GetUniformLocation(Name);
-
-        snprintf(Name, sizeof(Name), "gSpotLights[%d].Base.Position", i);
-        m_spotLightsLocation[i].Position = GetUniformLocation(Name);
-
-        snprintf(Name, sizeof(Name), "gSpotLights[%d].Direction", i);
-        m_spotLightsLocation[i].Direction = GetUniformLocation(Name);
-
-        snprintf(Name, sizeof(Name), "gSpotLights[%d].Cutoff", i);
-        m_spotLightsLocation[i].Cutoff = GetUniformLocation(Name);
-
-        snprintf(Name, sizeof(Name), "gSpotLights[%d].Base.Base.DiffuseIntensity", i);
-        m_spotLightsLocation[i].DiffuseIntensity = GetUniformLocation(Name);
-
-        snprintf(Name, sizeof(Name), "gSpotLights[%d].Base.Atten.Constant", i);
-        m_spotLightsLocation[i].Atten.Constant = GetUniformLocation(Name);
-
-        snprintf(Name, sizeof(Name), "gSpotLights[%d].Base.Atten.Linear", i);
-        m_spotLightsLocation[i].Atten.Linear = GetUniformLocation(Name);
-
-        snprintf(Name, sizeof(Name), "gSpotLights[%d].Base.Atten.Exp", i);
-        m_spotLightsLocation[i].Atten.Exp = GetUniformLocation(Name);
-
-        if (m_spotLightsLocation[i].Color == INVALID_UNIFORM_LOCATION ||
-            m_spotLightsLocation[i].AmbientIntensity == INVALID_UNIFORM_LOCATION ||
-            m_spotLightsLocation[i].Position == INVALID_UNIFORM_LOCATION ||
-            m_spotLightsLocation[i].Direction == INVALID_UNIFORM_LOCATION ||
-            m_spotLightsLocation[i].Cutoff == INVALID_UNIFORM_LOCATION ||
-            m_spotLightsLocation[i].DiffuseIntensity == INVALID_UNIFORM_LOCATION ||
-            m_spotLightsLocation[i].Atten.Constant == INVALID_UNIFORM_LOCATION ||
-            m_spotLightsLocation[i].Atten.Linear == INVALID_UNIFORM_LOCATION ||
-            m_spotLightsLocation[i].Atten.Exp == INVALID_UNIFORM_LOCATION) {
-            return false;
-        }
+    // Camera, eye position and the directional light come from the buffer owned by FrameConstants
+    if (!BindUniformBlock("PerFrame", PER_FRAME_UBO_BINDING)) {
+        return false;
     }
 
     return true;
 }
 
 
-void LightingTechnique::SetWVP(const Matrix4f& WVP)
-{
-    glUniformMatrix4fv(m_WVPLocation, 1, GL_TRUE, (const GLfloat*)WVP.m);    
-}
-
-
-void LightingTechnique::SetLightWVP(const Matrix4f& LightWVP)
-{
-    glUniformMatrix4fv(m_LightWVPLocation, 1, GL_TRUE, (const GLfloat*)LightWVP.m);
-}
-
-
 void LightingTechnique::SetWorldMatrix(const Matrix4f& WorldInverse)
 {
-    glUniformMatrix4fv(m_WorldMatrixLocation, 1, GL_TRUE, (const GLfloat*)WorldInverse.m);
+    SetUniformMatrix4f(m_WorldMatrixLocation, WorldInverse);
 }
 
 
 void LightingTechnique::SetColorTextureUnit(unsigned int TextureUnit)
 {
-    glUniform1i(m_colorMapLocation, TextureUnit);
+    SetUniform1i(m_colorMapLocation, TextureUnit);
 }
 
 
 void LightingTechnique::SetShadowMapTextureUnit(unsigned int TextureUnit)
 {
-    glUniform1i(m_shadowMapLocation, TextureUnit);
+    SetUniform1i(m_shadowMapLocation, TextureUnit);
 }
 
 void LightingTechnique::SetNormalMapTextureUnit(unsigned int TextureUnit)
 {
-    glUniform1i(m_normalMapLocation, TextureUnit);
-}
-
-void LightingTechnique::SetDirectionalLight(const DirectionalLight& Light)
-{
-    glUniform3f(m_dirLightLocation.Color, Light.Color.x, Light.Color.y, Light.Color.z);
-    glUniform1f(m_dirLightLocation.AmbientIntensity, Light.AmbientIntensity);
-    Vector3f Direction = Light.Direction;
-    Direction.Normalize();
-    glUniform3f(m_dirLightLocation.Direction, Direction.x, Direction.y, Direction.z);
-    glUniform1f(m_dirLightLocation.DiffuseIntensity, Light.DiffuseIntensity);
-}
-
-
-void LightingTechnique::SetEyeWorldPos(const Vector3f& EyeWorldPos)
-{
-    glUniform3f(m_eyeWorldPosLocation, EyeWorldPos.x, EyeWorldPos.y, EyeWorldPos.z);
+    SetUniform1i(m_normalMapLocation, TextureUnit);
 }
 
-
 void LightingTechnique::SetMatSpecularIntensity(float Intensity)
 {
-    glUniform1f(m_matSpecularIntensityLocation, Intensity);
+    SetUniform1f(m_matSpecularIntensityLocation, Intensity);
 }
 
 
 void LightingTechnique::SetMatSpecularPower(float Power)
 {
-    glUniform1f(m_matSpecularPowerLocation, Power);
+    SetUniform1f(m_matSpecularPowerLocation, Power);
 }
 
 
-void LightingTechnique::SetPointLights(unsigned int NumLights, const PointLight* pLights)
+void LightingTechnique::SetClusterTextureUnits(unsigned int LightsUnit, unsigned int GridUnit, unsigned int IndexUnit)
 {
-    glUniform1i(m_numPointLightsLocation, NumLights);
-    
-    for (unsigned int i = 0 ; i < NumLights ; i++) {
-        glUniform3f(m_pointLightsLocation[i].Color, pLights[i].Color.x, pLights[i].Color.y, pLights[i].Color.z);
-        glUniform1f(m_pointLightsLocation[i].AmbientIntensity, pLights[i].AmbientIntensity);
-        glUniform1f(m_pointLightsLocation[i].DiffuseIntensity, pLights[i].DiffuseIntensity);
-        glUniform3f(m_pointLightsLocation[i].Position, pLights[i].Position.x, pLights[i].Position.y, pLights[i].Position.z);
-        glUniform1f(m_pointLightsLocation[i].Atten.Constant, pLights[i].Attenuation.Constant);
-        glUniform1f(m_pointLightsLocation[i].Atten.Linear, pLights[i].Attenuation.Linear);
-        glUniform1f(m_pointLightsLocation[i].Atten.Exp, pLights[i].Attenuation.Exp);
-    }
+    SetUniform1i(m_clusterLightsLocation, LightsUnit);
+    SetUniform1i(m_clusterGridLocation, GridUnit);
+    SetUniform1i(m_clusterIndicesLocation, IndexUnit);
 }
 
 
-void LightingTechnique::SetSpotLights(unsigned int NumLights, const SpotLight* pLights)
+void LightingTechnique::SetClusterParams(const Vector3f& Dims, const Vector2f& TileSize, const Vector2f& ZParams)
 {
-    glUniform1i(m_numSpotLightsLocation, NumLights);
-
-    for (unsigned int i = 0 ; i < NumLights ; i++) {
-        glUniform3f(m_spotLightsLocation[i].Color, pLights[i].Color.x, pLights[i].Color.y, pLights[i].Color.z);
-        glUniform1f(m_spotLightsLocation[i].AmbientIntensity, pLights[i].AmbientIntensity);
-        glUniform1f(m_spotLightsLocation[i].DiffuseIntensity, pLights[i].DiffuseIntensity);
-        glUniform3f(m_spotLightsLocation[i].Position,  pLights[i].Position.x, pLights[i].Position.y, pLights[i].Position.z);
-        Vector3f Direction = pLights[i].Direction;
-        Direction.Normalize();
-        glUniform3f(m_spotLightsLocation[i].Direction, Direction.x, Direction.y, Direction.z);
-        glUniform1f(m_spotLightsLocation[i].Cutoff, cosf(glm::radians(pLights[i].Cutoff)));
-        glUniform1f(m_spotLightsLocation[i].Atten.Constant, pLights[i].Attenuation.Constant);
-        glUniform1f(m_spotLightsLocation[i].Atten.Linear,   pLights[i].Attenuation.Linear);
-        glUniform1f(m_spotLightsLocation[i].Atten.Exp,      pLights[i].Attenuation.Exp);
-    }
+    SetUniform3f(m_clusterDimsLocation, Dims);
+    SetUniform2f(m_clusterTileSizeLocation, TileSize);
+    SetUniform2f(m_clusterZParamsLocation, ZParams);
 }
@@ -60,76 +60,58 @@ struct SpotLight : public PointLight
     }
 };
 
+// Distance at which the attenuation brings the light below 1/256 of its
+// intensity. FLT_MAX for lights without falloff.
+float CalcLightRange(const PointLight& Light);
+
 class LightingTechnique : public Technique 
 {
 public:
 
-    static const unsigned int MAX_POINT_LIGHTS = 2;
-    static const unsigned int MAX_SPOT_LIGHTS = 2;
+    // Space in which the directional light meets the normal map. In tangent
+    // space the vertex shader moves the light and eye vectors into the frame
+    // of the normal map and the fragment shader uses the sampled normal as is.
+    // The clustered lights are always lit in world space.
+    enum LightingSpace {
+        LIGHTING_SPACE_WORLD,
+        LIGHTING_SPACE_TANGENT
+    };
 
-    LightingTechnique();
+    LightingTechnique(LightingSpace Space = LIGHTING_SPACE_WORLD);
 
     virtual bool Init();
 
-    void SetWVP(const Matrix4f& WVP);
-    void SetLightWVP(const Matrix4f& LightWVP);
-    void SetWorldMatrix(const Matrix4f& WVP);
+    void SetWorldMatrix(const Matrix4f& World);
     void SetColorTextureUnit(unsigned int TextureUnit);
     void SetShadowMapTextureUnit(unsigned int TextureUnit);
     void SetNormalMapTextureUnit(unsigned int TextureUnit);
-    void SetDirectionalLight(const DirectionalLight& Light);
-    void SetPointLights(unsigned int NumLights, const PointLight* pLights);
-    void SetSpotLights(unsigned int NumLights, const SpotLight* pLights);
-    void SetEyeWorldPos(const Vector3f& EyeWorldPos);
     void SetMatSpecularIntensity(float Intensity);
     void SetMatSpecularPower(float Power);
 
+    // Point and spot lights come from the cluster lists built by LightClusters
+    void SetClusterTextureUnits(unsigned int LightsUnit, unsigned int GridUnit, unsigned int IndexUnit);
+    void SetClusterParams(const Vector3f& Dims, const Vector2f& TileSize, const Vector2f& ZParams);
+
+    LightingSpace GetLightingSpace() const
+    {
+        return m_lightingSpace;
+    }
+
 private:
 
-    GLuint m_WVPLocation;
-    GLuint m_LightWVPLocation;
+    LightingSpace m_lightingSpace;
     GLuint m_WorldMatrixLocation;
     GLuint m_colorMapLocation;
     GLuint m_shadowMapLocation;
     GLuint m_normalMapLocation;
-    GLuint m_eyeWorldPosLocation;
     GLuint m_matSpecularIntensityLocation;
     GLuint m_matSpecularPowerLocation;
-    GLuint m_numPointLightsLocation;
-    GLuint m_numSpotLightsLocation;
-
-    struct {
-        GLuint Color;
-        GLuint AmbientIntensity;
-        GLuint DiffuseIntensity;
-        GLuint Direction;
-    } m_dirLightLocation;
-
-    struct {
-        GLuint Color;
-        GLuint AmbientIntensity;
-        GLuint DiffuseIntensity;
-        GLuint Position;
-        struct {
-            GLuint Constant;
-            GLuint Linear;
-            GLuint Exp;
-        } Atten;
-    } m_pointLightsLocation[MAX_POINT_LIGHTS];
-
-    struct {
-        GLuint Color;
-        GLuint AmbientIntensity;
-        GLuint DiffuseIntensity;
-        GLuint Position;
-        GLuint Direction;
-        GLuint Cutoff;
-        struct {
-            GLuint Constant;
-            GLuint Linear;
-            GLuint Exp;
-        } Atten;
-    } m_spotLightsLocation[MAX_SPOT_LIGHTS];
+    GLuint m_clusterLightsLocation;
+    GLuint m_clusterGridLocation;
+    GLuint m_clusterIndicesLocation;
+    GLuint m_clusterDimsLocation;
+    GLuint m_clusterTileSizeLocation;
+    GLuint m_clusterZParamsLocation;
 };
 
 
@@ -1,4 +1,7 @@
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
 #include <GL/glew.h>
 #include <GL/freeglut.h>
 #include <Magick++.h>
@@ -8,20 +11,59 @@
 #include "camera.h"
 #include "texture.h"
 #include "lighting_technique.h"
+#include "frame_constants.h"
+#include "light_clusters.h"
+#include "gbuffer.h"
+#include "depth_technique.h"
+#include "gpu_timer.h"
+#include "ds_geom_pass_technique.h"
+#include "ds_light_pass_technique.h"
 #include "glut_backend.h"
 #include "mesh.h"
+#include "math_benchmark.h"
+#include "math_batch.h"
 
 #define WINDOW_WIDTH  1920
 #define WINDOW_HEIGHT 1200
 
+// 16x10 tiles of 120x120 pixels times 24 depth slices
+#define CLUSTER_DIM_X 16
+#define CLUSTER_DIM_Y 10
+#define CLUSTER_DIM_Z 24
+
+#define NUM_POINT_LIGHTS 192
+#define NUM_SPOT_LIGHTS 64
+
+// The lights are scattered over a field of boxes in front of the camera
+#define FIELD_BOXES 16
+#define FIELD_SPACING 3.0f
+
+// World and tangent space permutations of the forward lighting technique
+#define NUM_LIGHTING_SPACES 2
+
+// Picked with the command line, "-deferred" selects the deferred path
+enum RenderPath
+{
+    RENDER_PATH_FORWARD,
+    RENDER_PATH_DEFERRED
+};
+
 
 class Tutorial26 : public ICallbacks
 {
 public:
 
-    Tutorial26()
+    Tutorial26(RenderPath Path)
     {
-        m_pLightingTechnique = nullptr;        
+        m_renderPath = Path;
+        m_pLightingTechniques[LightingTechnique::LIGHTING_SPACE_WORLD] = nullptr;
+        m_pLightingTechniques[LightingTechnique::LIGHTING_SPACE_TANGENT] = nullptr;
+        m_lightingSpace = LightingTechnique::LIGHTING_SPACE_WORLD;
+        m_pDSGeomPassTech = nullptr;
+        m_pDepthTech = nullptr;
+        m_pDSDirLightPassTech = nullptr;
+        m_pDSPointLightPassTech = nullptr;
+        m_pLightVolumeMesh = nullptr;
         m_pGameCamera = nullptr;        
         m_pSphereMesh = nullptr;
         m_scale = 0.0f;
@@ -29,9 +71,10 @@ public:
         m_pNormalMap = nullptr;
         m_pTrivialNormalMap = nullptr;
 
-        m_dirLight.AmbientIntensity = 0.2f;
-        m_dirLight.DiffuseIntensity = 0.8f;
-        m_dirLight.Color = Vector3f(1.0f, 1.0f, 1.0f);
+        // moonlight, the scene is lit mostly by the local lights
+        m_dirLight.AmbientIntensity = 0.02f;
+        m_dirLight.DiffuseIntensity = 0.05f;
+        m_dirLight.Color = Vector3f(0.6f, 0.7f, 1.0f);
         m_dirLight.Direction = Vector3f(1.0f, -1.0f, 0.0f);
         
         m_persProjInfo.FOV = 60.0f;
@@ -41,12 +84,23 @@ public:
         m_persProjInfo.zFar = 100.0f;        
         
         m_bumpMapEnabled = true;
+        m_depthPrePass = false;
+        m_frustumCulling = true;
+
+        m_uniformStats.Issued = 0;
+        m_uniformStats.Skipped = 0;
     }
     
 
     ~Tutorial26()
     {
-        SAFE_DELETE(m_pLightingTechnique);
+        SAFE_DELETE(m_pLightingTechniques[LightingTechnique::LIGHTING_SPACE_WORLD]);
+        SAFE_DELETE(m_pLightingTechniques[LightingTechnique::LIGHTING_SPACE_TANGENT]);
+        SAFE_DELETE(m_pDSGeomPassTech);
+        SAFE_DELETE(m_pDepthTech);
+        SAFE_DELETE(m_pDSDirLightPassTech);
+        SAFE_DELETE(m_pDSPointLightPassTech);
+        SAFE_DELETE(m_pLightVolumeMesh);
         SAFE_DELETE(m_pGameCamera);        
         SAFE_DELETE(m_pSphereMesh);        
         SAFE_DELETE(m_pTexture);
@@ -63,18 +117,35 @@ public:
 
         m_pGameCamera = new Camera(WINDOW_WIDTH, WINDOW_HEIGHT, Pos, Target, Up);
      
-        m_pLightingTechnique = new LightingTechnique();
+        if (!m_frameConstants.Init()) {
+            printf("Error initializing the per-frame uniform buffers\n");
+            return false;
+        }
+
+        m_frameConstants.SetDirectionalLight(m_dirLight);
 
-        if (!m_pLightingTechnique->Init()) {
-            printf("Error initializing the lighting technique\n");
+        InitLights();
+
+        m_pDepthTech = new DepthTechnique();
+
+        if (!m_pDepthTech->Init()) {
+            printf("Error initializing the depth technique\n");
             return false;
         }
 
-        m_pLightingTechnique->Enable();
-        m_pLightingTechnique->SetDirectionalLight(m_dirLight);
-        m_pLightingTechnique->SetColorTextureUnit(0);
-        m_pLightingTechnique->SetNormalMapTextureUnit(2);
-              
+        if (m_renderPath == RENDER_PATH_DEFERRED) {
+            if (!InitDeferred()) {
+                return false;
+            }
+        }
+        else {
+            if (!InitForward()) {
+                return false;
+            }
+        }
+
+        printf("Render path: %s\n", m_renderPath == RENDER_PATH_DEFERRED ? "deferred" : "forward");
+
         m_pSphereMesh = new Mesh();
         if (!m_pSphereMesh->LoadMesh("C:/Content/box.obj")) {
             return false;
@@ -115,16 +186,18 @@ public:
         m_pGameCamera->OnRender();
         m_scale += 0.01f;
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        m_pLightingTechnique->Enable();
-       
         Pipeline p;        
-        p.Rotate(0.0f, m_scale, 0.0f);
-        p.WorldPos(0.0f, 0.0f, 3.0f);
         p.SetCamera(m_pGameCamera->GetPos(), m_pGameCamera->GetTarget(), m_pGameCamera->GetUp());
         p.SetPerspectiveProj(m_persProjInfo);
 
+        m_frameConstants.SetViewProj(p.GetVPTrans());
+        m_frameConstants.SetEyeWorldPos(m_pGameCamera->GetPos());
+        m_frameConstants.Commit();
+
+        UpdateLights();
+        UpdateObjects();
+        CullObjects(p.GetVPTrans());
+
         m_pTexture->Bind(COLOR_TEXTURE_UNIT);
         
         if (m_bumpMapEnabled)
@@ -136,9 +209,15 @@ public:
             m_pTrivialNormalMap->Bind(NORMAL_TEXTURE_UNIT);
         }
         
-        m_pLightingTechnique->SetWVP(p.GetWVPTrans());
-        m_pLightingTechnique->SetWorldMatrix(p.GetWorldTrans());
-        m_pSphereMesh->Render();
+        if (m_renderPath == RENDER_PATH_DEFERRED) {
+            DeferredRender(p);
+        }
+        else {
+            ForwardRender(p);
+        }
+
+        m_uniformStats = Technique::GetUniformStats();
+        Technique::ResetUniformStats();
              
         glutSwapBuffers();
     }
@@ -166,6 +245,48 @@ public:
             case 'b':
                 m_bumpMapEnabled = !m_bumpMapEnabled;
                 break;
+
+            case 'u':
+                printf("Uniform updates last frame: %u issued, %u skipped\n",
+                       m_uniformStats.Issued, m_uniformStats.Skipped);
+                break;
+
+            case 'c':
+                if (m_renderPath == RENDER_PATH_FORWARD) {
+                    m_lightClusters.PrintStats();
+                }
+                break;
+
+            case 'z':
+                if (m_renderPath == RENDER_PATH_FORWARD) {
+                    m_depthPrePass = !m_depthPrePass;
+                    PrintTimings();
+                }
+                break;
+
+            case 'n':
+                if (m_renderPath == RENDER_PATH_FORWARD) {
+                    m_lightingSpace = (m_lightingSpace == LightingTechnique::LIGHTING_SPACE_WORLD) ?
+                                      LightingTechnique::LIGHTING_SPACE_TANGENT : LightingTechnique::LIGHTING_SPACE_WORLD;
+                    PrintTimings();
+                }
+                break;
+
+            case 't':
+                if (m_renderPath == RENDER_PATH_FORWARD) {
+                    PrintTimings();
+                }
+                break;
+
+            case 'm':
+                RunMathBenchmark();
+                break;
+
+            case 'f':
+                m_frustumCulling = !m_frustumCulling;
+                printf("Frustum culling %s, %u of %u objects drawn last frame\n", m_frustumCulling ? "on" : "off",
+                       (unsigned int)m_visibleObjects.size(), (unsigned int)m_objectWorlds.size());
+                break;
         }
     }
 
@@ -177,7 +298,471 @@ public:
 
  private:
 
-    LightingTechnique* m_pLightingTechnique;
+    bool InitForward()
+    {
+        // Both permutations are built up front so that switching between them
+        // does not hitch
+        for (unsigned int i = 0 ; i < NUM_LIGHTING_SPACES ; i++) {
+            m_pLightingTechniques[i] = new LightingTechnique((LightingTechnique::LightingSpace)i);
+
+            if (!m_pLightingTechniques[i]->Init()) {
+                printf("Error initializing the lighting technique\n");
+                return false;
+            }
+        }
+
+        if (!m_lightClusters.Init(CLUSTER_DIM_X, CLUSTER_DIM_Y, CLUSTER_DIM_Z, WINDOW_WIDTH, WINDOW_HEIGHT)) {
+            printf("Error initializing the light clusters\n");
+            return false;
+        }
+
+        m_lightClusters.SetProjection(m_persProjInfo);
+
+        if (!m_depthPassTimer.Init()) {
+            return false;
+        }
+
+        for (unsigned int i = 0 ; i < NUM_LIGHTING_SPACES ; i++) {
+            if (!m_lightingTimers[i][0].Init() || !m_lightingTimers[i][1].Init()) {
+                return false;
+            }
+
+            LightingTechnique* pTech = m_pLightingTechniques[i];
+            pTech->Enable();
+            pTech->SetColorTextureUnit(0);
+            pTech->SetNormalMapTextureUnit(2);
+            pTech->SetClusterTextureUnits(CLUSTER_LIGHTS_TEXTURE_UNIT_INDEX,
+                                          CLUSTER_GRID_TEXTURE_UNIT_INDEX,
+                                          CLUSTER_INDEX_TEXTURE_UNIT_INDEX);
+            pTech->SetClusterParams(m_lightClusters.GetDims(),
+                                    m_lightClusters.GetTileSize(),
+                                    m_lightClusters.GetZParams());
+        }
+
+        return true;
+    }
+
+
+    bool InitDeferred()
+    {
+        if (!m_gbuffer.Init(WINDOW_WIDTH, WINDOW_HEIGHT)) {
+            printf("Error initializing the G-buffer\n");
+            return false;
+        }
+
+        m_pDSGeomPassTech = new DSGeomPassTechnique();
+
+        if (!m_pDSGeomPassTech->Init()) {
+            printf("Error initializing the geometry pass technique\n");
+            return false;
+        }
+
+        m_pDSGeomPassTech->Enable();
+        m_pDSGeomPassTech->SetColorTextureUnit(0);
+        m_pDSGeomPassTech->SetNormalMapTextureUnit(2);
+
+        m_pDSDirLightPassTech = new DSDirLightPassTechnique();
+
+        if (!m_pDSDirLightPassTech->Init()) {
+            printf("Error initializing the directional light pass technique\n");
+            return false;
+        }
+
+        m_pDSPointLightPassTech = new DSPointLightPassTechnique();
+
+        if (!m_pDSPointLightPassTech->Init()) {
+            printf("Error initializing the point light pass technique\n");
+            return false;
+        }
+
+        DSLightPassTechnique* LightPasses[] = { m_pDSDirLightPassTech, m_pDSPointLightPassTech };
+
+        for (unsigned int i = 0 ; i < ARRAY_SIZE_IN_ELEMENTS(LightPasses) ; i++) {
+            LightPasses[i]->Enable();
+            LightPasses[i]->SetGBufferTextureUnits(GBUFFER_ALBEDO_TEXTURE_UNIT_INDEX,
+                                                   GBUFFER_NORMAL_TEXTURE_UNIT_INDEX,
+                                                   GBUFFER_DEPTH_TEXTURE_UNIT_INDEX);
+            LightPasses[i]->SetScreenSize(WINDOW_WIDTH, WINDOW_HEIGHT);
+            LightPasses[i]->SetProjection(m_persProjInfo);
+        }
+
+        // unit sphere, scaled to the range of each light
+        m_pLightVolumeMesh = new Mesh();
+
+        if (!m_pLightVolumeMesh->LoadMesh("C:/Content/sphere.obj")) {
+            return false;
+        }
+
+        return true;
+    }
+
+
+    // World matrices of everything drawn this frame, shared by both paths
+    void UpdateObjects()
+    {
+        m_objectWorlds.clear();
+
+        Pipeline p;
+        p.Rotate(0.0f, m_scale, 0.0f);
+        p.WorldPos(0.0f, 0.0f, 3.0f);
+        m_objectWorlds.push_back(p.GetWorldTrans());
+
+        for (int z = 0 ; z < FIELD_BOXES ; z++) {
+            for (int x = 0 ; x < FIELD_BOXES ; x++) {
+                Pipeline Box;
+                Box.Scale(1.0f, 0.25f, 1.0f);
+                Box.WorldPos((x - FIELD_BOXES / 2) * FIELD_SPACING, -1.5f, 3.0f + z * FIELD_SPACING);
+                m_objectWorlds.push_back(Box.GetWorldTrans());
+            }
+        }
+
+        m_objectMin.resize(m_objectWorlds.size());
+        m_objectMax.resize(m_objectWorlds.size());
+
+        for (unsigned int i = 0 ; i < m_objectWorlds.size() ; i++) {
+            const AABB Bounds = m_pSphereMesh->GetBounds().Transform(m_objectWorlds[i]);
+            m_objectMin[i] = Bounds.Min;
+            m_objectMax[i] = Bounds.Max;
+        }
+    }
+
+
+    // The passes only draw the objects whose world box touches the view frustum
+    void CullObjects(const Matrix4f& VP)
+    {
+        const unsigned int NumObjects = (unsigned int)m_objectWorlds.size();
+
+        m_visibleObjects.resize(NumObjects);
+
+        if (m_frustumCulling) {
+            const unsigned int NumVisible = CullBoxes(Frustum(VP), m_objectMin.data(), m_objectMax.data(),
+                                                      NumObjects, m_visibleObjects.data());
+            m_visibleObjects.resize(NumVisible);
+        }
+        else {
+            for (unsigned int i = 0 ; i < NumObjects ; i++) {
+                m_visibleObjects[i] = i;
+            }
+        }
+    }
+
+
+    void ForwardRender(Pipeline& p)
+    {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        m_lightClusters.SetLights(m_pointLights.size(), m_pointLights.data(),
+                                  m_spotLights.size(), m_spotLights.data());
+        m_lightClusters.Update(p.GetViewTrans());
+        m_lightClusters.Bind();
+
+        if (m_depthPrePass) {
+            DepthPrePass();
+
+            // Only the front-most fragment of every pixel passes and runs the
+            // lighting shader, the depth buffer is already final
+            glDepthFunc(GL_EQUAL);
+            glDepthMask(GL_FALSE);
+        }
+
+        GPUTimer& LightingTimer = m_lightingTimers[m_lightingSpace][m_depthPrePass ? 1 : 0];
+        LightingTimer.Begin();
+
+        LightingTechnique* pLightingTech = m_pLightingTechniques[m_lightingSpace];
+        pLightingTech->Enable();
+
+        for (unsigned int i = 0 ; i < m_visibleObjects.size() ; i++) {
+            pLightingTech->SetWorldMatrix(m_objectWorlds[m_visibleObjects[i]]);
+            m_pSphereMesh->Render();
+        }
+
+        LightingTimer.End();
+
+        if (m_depthPrePass) {
+            glDepthFunc(GL_LESS);
+            glDepthMask(GL_TRUE);
+        }
+    }
+
+
+    // Lays down the depth of the scene with the cheap depth-only program and
+    // the position stream of the meshes
+    void DepthPrePass()
+    {
+        m_depthPassTimer.Begin();
+
+        m_pDepthTech->Enable();
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+        for (unsigned int i = 0 ; i < m_visibleObjects.size() ; i++) {
+            m_pDepthTech->SetWorldMatrix(m_objectWorlds[m_visibleObjects[i]]);
+            m_pSphereMesh->RenderDepth();
+        }
+
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+        m_depthPassTimer.End();
+    }
+
+
+    void PrintTimings()
+    {
+        const char* SpaceNames[NUM_LIGHTING_SPACES] = { "world", "tangent" };
+        const float Depth = m_depthPassTimer.GetAverageMs();
+
+        printf("Depth pre-pass %s, %s space lighting\n", m_depthPrePass ? "on" : "off", SpaceNames[m_lightingSpace]);
+
+        for (unsigned int i = 0 ; i < NUM_LIGHTING_SPACES ; i++) {
+            const float LightingOff = m_lightingTimers[i][0].GetAverageMs();
+            const float LightingOn = m_lightingTimers[i][1].GetAverageMs();
+
+            printf("  %s space\n", SpaceNames[i]);
+            printf("    without pre-pass: %.3f ms (%u frames)\n", LightingOff, m_lightingTimers[i][0].GetNumSamples());
+            printf("    with pre-pass:    %.3f ms depth + %.3f ms lighting = %.3f ms (%u frames)\n",
+                   Depth, LightingOn, Depth + LightingOn, m_lightingTimers[i][1].GetNumSamples());
+        }
+    }
+
+
+    void DeferredRender(Pipeline& p)
+    {
+        m_gbuffer.StartFrame();
+
+        DSGeometryPass();
+
+        // Each local light marks the pixels inside its volume in the stencil
+        // and then shades only those
+        glEnable(GL_STENCIL_TEST);
+
+        const unsigned int NumPointLights = (unsigned int)m_pointLights.size();
+        const unsigned int NumVisible = CullLights(p.GetVPTrans());
+
+        for (unsigned int i = 0 ; i < NumVisible ; i++) {
+            const unsigned int Light = m_visibleLights[i];
+
+            if (Light < NumPointLights) {
+                DSLocalLightPass(p, m_pointLights[Light], NULL);
+            }
+            else {
+                DSLocalLightPass(p, m_spotLights[Light - NumPointLights], &m_spotLights[Light - NumPointLights]);
+            }
+        }
+
+        glDisable(GL_STENCIL_TEST);
+
+        DSDirectionalLightPass(p);
+
+        m_gbuffer.BlitToScreen();
+    }
+
+
+    // A light whose volume misses the view frustum cannot touch a pixel. The
+    // visible ones go to m_visibleLights, point lights first and then the
+    // spot lights offset by the number of point lights.
+    unsigned int CullLights(const Matrix4f& VP)
+    {
+        const unsigned int NumPointLights = (unsigned int)m_pointLights.size();
+        const unsigned int NumLights = NumPointLights + (unsigned int)m_spotLights.size();
+
+        m_lightCenters.resize(NumLights);
+        m_lightRadii.resize(NumLights);
+        m_visibleLights.resize(NumLights);
+
+        for (unsigned int i = 0 ; i < NumLights ; i++) {
+            const PointLight& Light = i < NumPointLights ? m_pointLights[i] : m_spotLights[i - NumPointLights];
+            m_lightCenters[i] = Light.Position;
+            m_lightRadii[i] = CalcLightRange(Light);
+        }
+
+        if (!m_frustumCulling) {
+            for (unsigned int i = 0 ; i < NumLights ; i++) {
+                m_visibleLights[i] = i;
+            }
+
+            return NumLights;
+        }
+
+        return CullSpheres(Frustum(VP), m_lightCenters.data(), m_lightRadii.data(), NumLights, m_visibleLights.data());
+    }
+
+
+    void DSGeometryPass()
+    {
+        m_pDSGeomPassTech->Enable();
+
+        m_gbuffer.BindForGeomPass();
+
+        // Only the geometry pass updates the depth buffer
+        glDepthMask(GL_TRUE);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_DEPTH_TEST);
+
+        for (unsigned int i = 0 ; i < m_visibleObjects.size() ; i++) {
+            m_pDSGeomPassTech->SetWorldMatrix(m_objectWorlds[m_visibleObjects[i]]);
+            m_pSphereMesh->Render();
+        }
+
+        glDepthMask(GL_FALSE);
+    }
+
+
+    // pSpot is NULL for point lights. Spot lights use the sphere of their
+    // range as well, the cone is applied in the fragment shader.
+    void DSLocalLightPass(Pipeline& p, const PointLight& Light, const SpotLight* pSpot)
+    {
+        float Range = CalcLightRange(Light);
+
+        if (Range <= 0.0f) {
+            return;
+        }
+
+        if (Range > m_persProjInfo.zFar) {
+            Range = m_persProjInfo.zFar;
+        }
+
+        p.Scale(Range, Range, Range);
+        p.Rotate(0.0f, 0.0f, 0.0f);
+        p.WorldPos(Light.Position.x, Light.Position.y, Light.Position.z);
+        const Matrix4f& WVP = p.GetWVPTrans();
+
+        // Stencil pass: back faces behind the scene increment, front faces
+        // behind the scene decrement, so pixels inside the volume end up non zero
+        m_pDepthTech->Enable();
+        m_pDepthTech->SetWorldMatrix(p.GetWorldTrans());
+
+        m_gbuffer.BindForStencilPass();
+        glEnable(GL_DEPTH_TEST);
+        glDisable(GL_CULL_FACE);
+        glClear(GL_STENCIL_BUFFER_BIT);
+
+        glStencilFunc(GL_ALWAYS, 0, 0);
+        glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+        glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+
+        m_pLightVolumeMesh->RenderDepth();
+
+        // Light pass: back faces only, so that the volume still covers the
+        // screen when the camera is inside it
+        m_gbuffer.BindForLightPass();
+
+        m_pDSPointLightPassTech->Enable();
+        m_pDSPointLightPassTech->SetWVP(WVP);
+        m_pDSPointLightPassTech->SetViewMatrix(p.GetViewTrans());
+
+        if (pSpot) {
+            m_pDSPointLightPassTech->SetSpotLight(*pSpot);
+        }
+        else {
+            m_pDSPointLightPassTech->SetPointLight(Light);
+        }
+
+        glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
+        glDisable(GL_DEPTH_TEST);
+
+        glEnable(GL_BLEND);
+        glBlendEquation(GL_FUNC_ADD);
+        glBlendFunc(GL_ONE, GL_ONE);
+
+        glEnable(GL_CULL_FACE);
+        glCullFace(GL_FRONT);
+
+        m_pLightVolumeMesh->Render();
+
+        glCullFace(GL_BACK);
+        glDisable(GL_BLEND);
+    }
+
+
+    void DSDirectionalLightPass(Pipeline& p)
+    {
+        m_gbuffer.BindForLightPass();
+
+        m_pDSDirLightPassTech->Enable();
+        m_pDSDirLightPassTech->SetViewMatrix(p.GetViewTrans());
+
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_CULL_FACE);
+        glEnable(GL_BLEND);
+        glBlendEquation(GL_FUNC_ADD);
+        glBlendFunc(GL_ONE, GL_ONE);
+
+        m_pDSDirLightPassTech->Draw();
+
+        glDisable(GL_BLEND);
+        glEnable(GL_CULL_FACE);
+        glEnable(GL_DEPTH_TEST);
+        glDepthMask(GL_TRUE);
+    }
+
+
+    static float RandomFloat(float Min, float Max)
+    {
+        return Min + (Max - Min) * ((float)rand() / RAND_MAX);
+    }
+
+    // Small colored lights with a range of a few boxes. The point lights hover
+    // between the boxes, the spot lights hang above the field pointing down.
+    void InitLights()
+    {
+        srand(1);
+
+        const float FieldHalfWidth = FIELD_BOXES * FIELD_SPACING * 0.5f;
+
+        m_pointLights.resize(NUM_POINT_LIGHTS);
+
+        for (unsigned int i = 0 ; i < m_pointLights.size() ; i++) {
+            PointLight& l = m_pointLights[i];
+            l.Color = Vector3f(RandomFloat(0.2f, 1.0f), RandomFloat(0.2f, 1.0f), RandomFloat(0.2f, 1.0f));
+            l.DiffuseIntensity = 0.6f;
+            l.Position = Vector3f(RandomFloat(-FieldHalfWidth, FieldHalfWidth), -0.5f,
+                                  RandomFloat(3.0f, 3.0f + 2.0f * FieldHalfWidth));
+            l.Attenuation.Linear = 0.5f;
+            l.Attenuation.Exp = 8.0f;
+        }
+
+        m_spotLights.resize(NUM_SPOT_LIGHTS);
+
+        for (unsigned int i = 0 ; i < m_spotLights.size() ; i++) {
+            SpotLight& l = m_spotLights[i];
+            l.Color = Vector3f(1.0f, RandomFloat(0.7f, 1.0f), RandomFloat(0.4f, 0.8f));
+            l.DiffuseIntensity = 0.9f;
+            l.Position = Vector3f(RandomFloat(-FieldHalfWidth, FieldHalfWidth), 2.0f,
+                                  RandomFloat(3.0f, 3.0f + 2.0f * FieldHalfWidth));
+            l.Direction = Vector3f(0.0f, -1.0f, 0.0f);
+            l.Cutoff = 30.0f;
+            l.Attenuation.Linear = 0.1f;
+            l.Attenuation.Exp = 2.0f;
+        }
+    }
+
+    // The point lights bob up and down so the cluster lists change every frame
+    void UpdateLights()
+    {
+        for (unsigned int i = 0 ; i < m_pointLights.size() ; i++) {
+            m_pointLights[i].Position.y = -0.5f + 0.5f * sinf(m_scale * 2.0f + i);
+        }
+    }
+
+    RenderPath m_renderPath;
+    LightingTechnique* m_pLightingTechniques[NUM_LIGHTING_SPACES];
+    LightingTechnique::LightingSpace m_lightingSpace;
+    DSGeomPassTechnique* m_pDSGeomPassTech;
+    DepthTechnique* m_pDepthTech;
+    DSDirLightPassTechnique* m_pDSDirLightPassTech;
+    DSPointLightPassTechnique* m_pDSPointLightPassTech;
+    GBuffer m_gbuffer;
+    Mesh* m_pLightVolumeMesh;
+    FrameConstants m_frameConstants;
+    LightClusters m_lightClusters;
+    std::vector<PointLight> m_pointLights;
+    std::vector<SpotLight> m_spotLights;
+    std::vector<Matrix4f> m_objectWorlds;
+    std::vector<Vector3f> m_objectMin;
+    std::vector<Vector3f> m_objectMax;
+    std::vector<unsigned int> m_visibleObjects;
+    std::vector<Vector3f> m_lightCenters;
+    std::vector<float> m_lightRadii;
+    std::vector<unsigned int> m_visibleLights;
     Camera* m_pGameCamera;
     float m_scale;
     DirectionalLight m_dirLight;    
@@ -187,11 +772,24 @@ public:
     Texture* m_pTrivialNormalMap;
     PersProjInfo m_persProjInfo;
     bool m_bumpMapEnabled;
+    bool m_depthPrePass;
+    bool m_frustumCulling;
+    GPUTimer m_depthPassTimer;
+    GPUTimer m_lightingTimers[NUM_LIGHTING_SPACES][2];
+    UniformStats m_uniformStats;
 };
 
 
 int main(int argc, char** argv)
 {
+    RenderPath Path = RENDER_PATH_FORWARD;
+
+    for (int i = 1 ; i < argc ; i++) {
+        if (strcmp(argv[i], "-deferred") == 0) {
+            Path = RENDER_PATH_DEFERRED;
+        }
+    }
+
     Magick::InitializeMagick(*argv);
     GLUTBackendInit(argc, argv);
 
@@ -199,7 +797,7 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    Tutorial26* pApp = new Tutorial26();
+    Tutorial26* pApp = new Tutorial26(Path);
 
     if (!pApp->Init()) {
         return 1;
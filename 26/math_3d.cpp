@@ -1,4 +1,5 @@
 #include "math_3d.h"
+#include "math_batch.h"
 #include <glm/glm.hpp>
 
 Vector3f Vector3f::Cross(const Vector3f& v) const
@@ -12,25 +13,18 @@ Vector3f Vector3f::Cross(const Vector3f& v) const
 
 Vector3f& Vector3f::Normalize()
 {
-    const float Length = sqrtf(x * x + y * y + z * z);
+    const float InvLength = 1.0f / sqrtf(x * x + y * y + z * z);
 
-    x /= Length;
-    y /= Length;
-    z /= Length;
+    x *= InvLength;
+    y *= InvLength;
+    z *= InvLength;
 
     return *this;
 }
 
 void Vector3f::Rotate(float Angle, const Vector3f& Axe)
 {
-    const float SinHalfAngle = sinf(glm::radians(Angle/2));
-    const float CosHalfAngle = cosf(glm::radians(Angle/2));
-
-    const float Rx = Axe.x * SinHalfAngle;
-    const float Ry = Axe.y * SinHalfAngle;
-    const float Rz = Axe.z * SinHalfAngle;
-    const float Rw = CosHalfAngle;
-    Quaternion RotationQ(Rx, Ry, Rz, Rw);
+    Quaternion RotationQ(Axe, Angle);
 
     Quaternion ConjugateQ = RotationQ.Conjugate();
   //  ConjugateQ.Normalize();
@@ -52,28 +46,12 @@ void Matrix4f::InitScaleTransform(float ScaleX, float ScaleY, float ScaleZ)
 
 void Matrix4f::InitRotateTransform(float RotateX, float RotateY, float RotateZ)
 {
-    Matrix4f rx, ry, rz;
-
-    const float x = glm::radians(RotateX);
-    const float y = glm::radians(RotateY);
-    const float z = glm::radians(RotateZ);
-
-    rx.m[0][0] = 1.0f; rx.m[0][1] = 0.0f   ; rx.m[0][2] = 0.0f    ; rx.m[0][3] = 0.0f;
-    rx.m[1][0] = 0.0f; rx.m[1][1] = cosf(x); rx.m[1][2] = -sinf(x); rx.m[1][3] = 0.0f;
-    rx.m[2][0] = 0.0f; rx.m[2][1] = sinf(x); rx.m[2][2] = cosf(x) ; rx.m[2][3] = 0.0f;
-    rx.m[3][0] = 0.0f; rx.m[3][1] = 0.0f   ; rx.m[3][2] = 0.0f    ; rx.m[3][3] = 1.0f;
-
-    ry.m[0][0] = cosf(y); ry.m[0][1] = 0.0f; ry.m[0][2] = -sinf(y); ry.m[0][3] = 0.0f;
-    ry.m[1][0] = 0.0f   ; ry.m[1][1] = 1.0f; ry.m[1][2] = 0.0f    ; ry.m[1][3] = 0.0f;
-    ry.m[2][0] = sinf(y); ry.m[2][1] = 0.0f; ry.m[2][2] = cosf(y) ; ry.m[2][3] = 0.0f;
-    ry.m[3][0] = 0.0f   ; ry.m[3][1] = 0.0f; ry.m[3][2] = 0.0f    ; ry.m[3][3] = 1.0f;
-
-    rz.m[0][0] = cosf(z); rz.m[0][1] = -sinf(z); rz.m[0][2] = 0.0f; rz.m[0][3] = 0.0f;
-    rz.m[1][0] = sinf(z); rz.m[1][1] = cosf(z) ; rz.m[1][2] = 0.0f; rz.m[1][3] = 0.0f;
-    rz.m[2][0] = 0.0f   ; rz.m[2][1] = 0.0f    ; rz.m[2][2] = 1.0f; rz.m[2][3] = 0.0f;
-    rz.m[3][0] = 0.0f   ; rz.m[3][1] = 0.0f    ; rz.m[3][2] = 0.0f; rz.m[3][3] = 1.0f;
+    InitTRSTransform(Vector3f(0.0f, 0.0f, 0.0f), Vector3f(RotateX, RotateY, RotateZ), Vector3f(1.0f, 1.0f, 1.0f));
+}
 
-    *this = rz * ry * rx;
+void Matrix4f::InitRotateTransform(const Quaternion& q)
+{
+    InitTRSTransform(Vector3f(0.0f, 0.0f, 0.0f), q, Vector3f(1.0f, 1.0f, 1.0f));
 }
 
 void Matrix4f::InitTranslationTransform(float x, float y, float z)
@@ -85,6 +63,58 @@ void Matrix4f::InitTranslationTransform(float x, float y, float z)
 }
 
 
+// The rotation columns come out scaled, the translation is the last column
+static void ComposeTRS(Matrix4f& Mat, const Vector3f& Translation, const float r[3][3], const Vector3f& Scale)
+{
+    Mat.m[0][0] = r[0][0] * Scale.x; Mat.m[0][1] = r[0][1] * Scale.y; Mat.m[0][2] = r[0][2] * Scale.z; Mat.m[0][3] = Translation.x;
+    Mat.m[1][0] = r[1][0] * Scale.x; Mat.m[1][1] = r[1][1] * Scale.y; Mat.m[1][2] = r[1][2] * Scale.z; Mat.m[1][3] = Translation.y;
+    Mat.m[2][0] = r[2][0] * Scale.x; Mat.m[2][1] = r[2][1] * Scale.y; Mat.m[2][2] = r[2][2] * Scale.z; Mat.m[2][3] = Translation.z;
+    Mat.m[3][0] = 0.0f;              Mat.m[3][1] = 0.0f;              Mat.m[3][2] = 0.0f;              Mat.m[3][3] = 1.0f;
+}
+
+static inline void SinCos(float Angle, float* pSin, float* pCos)
+{
+#ifdef __GLIBC__
+    sincosf(Angle, pSin, pCos);
+#else
+    *pSin = sinf(Angle);
+    *pCos = cosf(Angle);
+#endif
+}
+
+void Matrix4f::InitTRSTransform(const Vector3f& Translation, const Vector3f& Rotation, const Vector3f& Scale)
+{
+    float sx, cx, sy, cy, sz, cz;
+
+    SinCos(glm::radians(Rotation.x), &sx, &cx);
+    SinCos(glm::radians(Rotation.y), &sy, &cy);
+    SinCos(glm::radians(Rotation.z), &sz, &cz);
+
+    // rz * ry * rx multiplied out. Note that ry turns the other way from rx
+    // and rz, which the Euler angles of the tutorials have always done.
+    const float r[3][3] = {
+        { cz * cy, -cz * sy * sx - sz * cx, -cz * sy * cx + sz * sx },
+        { sz * cy, -sz * sy * sx + cz * cx, -sz * sy * cx - cz * sx },
+        { sy,       cy * sx,                 cy * cx                }
+    };
+
+    ComposeTRS(*this, Translation, r, Scale);
+}
+
+void Matrix4f::InitTRSTransform(const Vector3f& Translation, const Quaternion& Rotation, const Vector3f& Scale)
+{
+    const float x = Rotation.x, y = Rotation.y, z = Rotation.z, w = Rotation.w;
+
+    const float r[3][3] = {
+        { 1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y - w * z),        2.0f * (x * z + w * y)        },
+        { 2.0f * (x * y + w * z),        1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z - w * x)        },
+        { 2.0f * (x * z - w * y),        2.0f * (y * z + w * x),        1.0f - 2.0f * (x * x + y * y) }
+    };
+
+    ComposeTRS(*this, Translation, r, Scale);
+}
+
+
 void Matrix4f::InitCameraTransform(const Vector3f& Target, const Vector3f& Up)
 {
     Vector3f N = Target;
@@ -121,14 +151,26 @@ Quaternion::Quaternion(float _x, float _y, float _z, float _w)
     w = _w;
 }
 
+Quaternion::Quaternion(const Vector3f& Axis, float Angle)
+{
+    float SinHalfAngle, CosHalfAngle;
+
+    SinCos(glm::radians(Angle / 2.0f), &SinHalfAngle, &CosHalfAngle);
+
+    x = Axis.x * SinHalfAngle;
+    y = Axis.y * SinHalfAngle;
+    z = Axis.z * SinHalfAngle;
+    w = CosHalfAngle;
+}
+
 void Quaternion::Normalize()
 {
-    float Length = sqrtf(x * x + y * y + z * z + w * w);
+    const float InvLength = 1.0f / sqrtf(x * x + y * y + z * z + w * w);
 
-    x /= Length;
-    y /= Length;
-    z /= Length;
-    w /= Length;
+    x *= InvLength;
+    y *= InvLength;
+    z *= InvLength;
+    w *= InvLength;
 }
 
 
@@ -160,4 +202,159 @@ Quaternion operator*(const Quaternion& q, const Vector3f& v)
     Quaternion ret(x, y, z, w);
 
     return ret;
-}
\ No newline at end of file
+}
+
+Quaternion Slerp(const Quaternion& a, const Quaternion& b, float t)
+{
+    float CosTheta = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+
+    // q and -q are the same rotation, flipping b takes the shorter way
+    const float Sign = CosTheta < 0.0f ? -1.0f : 1.0f;
+    CosTheta *= Sign;
+
+    float wa = 1.0f - t;
+    float wb = t;
+
+    // Close to each other the sines vanish and a normalized lerp is as good
+    if (CosTheta < 0.9995f) {
+        const float Theta = acosf(CosTheta);
+        const float InvSinTheta = 1.0f / sinf(Theta);
+
+        wa = sinf(wa * Theta) * InvSinTheta;
+        wb = sinf(wb * Theta) * InvSinTheta;
+    }
+
+    wb *= Sign;
+
+    Quaternion ret(a.x * wa + b.x * wb,
+                   a.y * wa + b.y * wb,
+                   a.z * wa + b.z * wb,
+                   a.w * wa + b.w * wb);
+    ret.Normalize();
+
+    return ret;
+}
+
+
+void AABB::Merge(const AABB& Box)
+{
+    Min = Vector3f(fminf(Min.x, Box.Min.x), fminf(Min.y, Box.Min.y), fminf(Min.z, Box.Min.z));
+    Max = Vector3f(fmaxf(Max.x, Box.Max.x), fmaxf(Max.y, Box.Max.y), fmaxf(Max.z, Box.Max.z));
+}
+
+void AABB::Merge(const Vector3f& Point)
+{
+    Merge(AABB(Point, Point));
+}
+
+AABB AABB::Transform(const Matrix4f& Mat) const
+{
+    AABB ret;
+
+    TransformBoxes(Mat, &Min, &Max, &ret.Min, &ret.Max, 1);
+
+    return ret;
+}
+
+
+void BoundingSphere::Merge(const BoundingSphere& Sphere)
+{
+    const Vector3f Offset = Sphere.Center - Center;
+    const float Distance = sqrtf(Offset.x * Offset.x + Offset.y * Offset.y + Offset.z * Offset.z);
+
+    // One already contains the other
+    if (Distance + Sphere.Radius <= Radius) {
+        return;
+    }
+
+    if (Distance + Radius <= Sphere.Radius) {
+        *this = Sphere;
+        return;
+    }
+
+    // The new sphere spans from the far side of one to the far side of the other
+    const float NewRadius = (Distance + Radius + Sphere.Radius) * 0.5f;
+    Center = Center + Offset * ((NewRadius - Radius) / Distance);
+    Radius = NewRadius;
+}
+
+BoundingSphere BoundingSphere::Transform(const Matrix4f& Mat) const
+{
+    Vector3f NewCenter;
+
+    TransformPoints(Mat, &Center, &NewCenter, 1);
+
+    float MaxScaleSq = 0.0f;
+
+    for (unsigned int i = 0 ; i < 3 ; i++) {
+        const float ScaleSq = Mat.m[0][i] * Mat.m[0][i] + Mat.m[1][i] * Mat.m[1][i] + Mat.m[2][i] * Mat.m[2][i];
+        MaxScaleSq = fmaxf(MaxScaleSq, ScaleSq);
+    }
+
+    return BoundingSphere(NewCenter, Radius * sqrtf(MaxScaleSq));
+}
+
+
+// Gribb and Hartmann: every clip plane is the last row of the matrix plus or
+// minus one of the others
+void Frustum::Init(const Matrix4f& Mat)
+{
+    for (unsigned int i = 0 ; i < 3 ; i++) {
+        m_planes[i * 2] = Vector4f(Mat.m[3][0] + Mat.m[i][0], Mat.m[3][1] + Mat.m[i][1],
+                                   Mat.m[3][2] + Mat.m[i][2], Mat.m[3][3] + Mat.m[i][3]);
+        m_planes[i * 2 + 1] = Vector4f(Mat.m[3][0] - Mat.m[i][0], Mat.m[3][1] - Mat.m[i][1],
+                                       Mat.m[3][2] - Mat.m[i][2], Mat.m[3][3] - Mat.m[i][3]);
+    }
+
+    for (unsigned int i = 0 ; i < NUM_PLANES ; i++) {
+        Vector4f& p = m_planes[i];
+        const float InvLength = 1.0f / sqrtf(p.x * p.x + p.y * p.y + p.z * p.z);
+
+        p = Vector4f(p.x * InvLength, p.y * InvLength, p.z * InvLength, p.w * InvLength);
+    }
+}
+
+// The box is outside when its center is further behind a plane than the
+// projection of its half extent on the plane normal
+FrustumTest Frustum::Classify(const AABB& Box) const
+{
+    const Vector3f Center = (Box.Min + Box.Max) * 0.5f;
+    const Vector3f Extent = (Box.Max - Box.Min) * 0.5f;
+    FrustumTest ret = FRUSTUM_INSIDE;
+
+    for (unsigned int i = 0 ; i < NUM_PLANES ; i++) {
+        const Vector4f& p = m_planes[i];
+        const float Distance = p.x * Center.x + p.y * Center.y + p.z * Center.z + p.w;
+        const float Radius = fabsf(p.x) * Extent.x + fabsf(p.y) * Extent.y + fabsf(p.z) * Extent.z;
+
+        if (Distance < -Radius) {
+            return FRUSTUM_OUTSIDE;
+        }
+
+        if (Distance < Radius) {
+            ret = FRUSTUM_INTERSECTS;
+        }
+    }
+
+    return ret;
+}
+
+FrustumTest Frustum::Classify(const BoundingSphere& Sphere) const
+{
+    FrustumTest ret = FRUSTUM_INSIDE;
+
+    for (unsigned int i = 0 ; i < NUM_PLANES ; i++) {
+        const Vector4f& p = m_planes[i];
+        const float Distance = p.x * Sphere.Center.x + p.y * Sphere.Center.y + p.z * Sphere.Center.z + p.w;
+
+        if (Distance < -Sphere.Radius) {
+            return FRUSTUM_OUTSIDE;
+        }
+
+        if (Distance < Sphere.Radius) {
+            ret = FRUSTUM_INTERSECTS;
+        }
+    }
+
+    return ret;
+}
@@ -4,6 +4,8 @@
 #include <stdio.h>
 #include <math.h>
 
+#include "math_simd.h"
+
 #define ToRadian(x) ((x) * M_PI / 180.0f)
 #define ToDegree(x) ((x) * 180.0f / M_PI)
 
@@ -148,6 +150,8 @@ struct PersProjInfo
     float zFar;
 };
 
+struct Quaternion;
+
 class Matrix4f
 {
 public:
@@ -170,14 +174,7 @@ public:
     {
         Matrix4f Ret;
 
-        for (unsigned int i = 0 ; i < 4 ; i++) {
-            for (unsigned int j = 0 ; j < 4 ; j++) {
-                Ret.m[i][j] = m[i][0] * Right.m[0][j] +
-                              m[i][1] * Right.m[1][j] +
-                              m[i][2] * Right.m[2][j] +
-                              m[i][3] * Right.m[3][j];
-            }
-        }
+        Matrix4fMultiply(&m[0][0], &Right.m[0][0], &Ret.m[0][0]);
 
         return Ret;
     }
@@ -186,10 +183,7 @@ public:
     {
         Vector4f r;
         
-        r.x = m[0][0]* v.x + m[0][1]* v.y + m[0][2]* v.z + m[0][3]* v.w;
-        r.y = m[1][0]* v.x + m[1][1]* v.y + m[1][2]* v.z + m[1][3]* v.w;
-        r.z = m[2][0]* v.x + m[2][1]* v.y + m[2][2]* v.z + m[2][3]* v.w;
-        r.w = m[3][0]* v.x + m[3][1]* v.y + m[3][2]* v.z + m[3][3]* v.w;
+        Matrix4fTransform(&m[0][0], &v.x, &r.x);
         
         return r;
     }
@@ -203,18 +197,59 @@ public:
 
     void InitScaleTransform(float ScaleX, float ScaleY, float ScaleZ);
     void InitRotateTransform(float RotateX, float RotateY, float RotateZ);
+    void InitRotateTransform(const Quaternion& q);
     void InitTranslationTransform(float x, float y, float z);
+
+    // Translation * Rotate * Scale written out directly, which is what
+    // composing the three matrices above gives without the products. The
+    // rotation is either in degrees around x, y and z or a unit quaternion.
+    void InitTRSTransform(const Vector3f& Translation, const Vector3f& Rotation, const Vector3f& Scale);
+    void InitTRSTransform(const Vector3f& Translation, const Quaternion& Rotation, const Vector3f& Scale);
+
     void InitCameraTransform(const Vector3f& Target, const Vector3f& Up);
     void InitPersProjTransform(const PersProjInfo& p);
 };
 
 
+// Matrix on a 16 byte boundary, so that products between two of them use
+// aligned loads and stores. Meant for matrices kept in arrays or members on
+// the hot path. Heap allocations, new and std::vector alike, only honor the
+// alignment since C++17, so keep them in static or automatic storage before that.
+struct alignas(16) AlignedMatrix4f : public Matrix4f
+{
+    AlignedMatrix4f()
+    {
+    }
+
+    AlignedMatrix4f(const Matrix4f& r) : Matrix4f(r)
+    {
+    }
+
+    inline AlignedMatrix4f operator*(const AlignedMatrix4f& Right) const
+    {
+        AlignedMatrix4f Ret;
+
+        Matrix4fMultiplyAligned(&m[0][0], &Right.m[0][0], &Ret.m[0][0]);
+
+        return Ret;
+    }
+};
+
+
 struct Quaternion
 {
     float x, y, z, w;
 
+    Quaternion()
+    {
+    }
+
     Quaternion(float _x, float _y, float _z, float _w);
 
+    // Rotation by Angle degrees around the unit vector Axis, the same one
+    // Vector3f::Rotate() applies
+    Quaternion(const Vector3f& Axis, float Angle);
+
     void Normalize();
 
     Quaternion Conjugate();  
@@ -224,5 +259,109 @@ Quaternion operator*(const Quaternion& l, const Quaternion& r);
 
 Quaternion operator*(const Quaternion& q, const Vector3f& v);
 
+// Constant speed interpolation from a to b along the shorter arc. Both are
+// expected to be unit quaternions and so is the result.
+Quaternion Slerp(const Quaternion& a, const Quaternion& b, float t);
+
+
+struct AABB
+{
+    Vector3f Min;
+    Vector3f Max;
+
+    AABB()
+    {
+    }
+
+    AABB(const Vector3f& _Min, const Vector3f& _Max)
+    {
+        Min = _Min;
+        Max = _Max;
+    }
+
+    // Grows the box to contain the other box or point
+    void Merge(const AABB& Box);
+    void Merge(const Vector3f& Point);
+
+    // Smallest axis aligned box around the transformed box
+    AABB Transform(const Matrix4f& Mat) const;
+};
+
+
+struct BoundingSphere
+{
+    Vector3f Center;
+    float Radius;
+
+    BoundingSphere()
+    {
+    }
+
+    BoundingSphere(const Vector3f& _Center, float _Radius)
+    {
+        Center = _Center;
+        Radius = _Radius;
+    }
+
+    // Grows the sphere to the smallest one containing both
+    void Merge(const BoundingSphere& Sphere);
+
+    // The radius is scaled by the largest scale of the matrix, so the result
+    // stays a sphere even under non uniform scaling
+    BoundingSphere Transform(const Matrix4f& Mat) const;
+};
+
+
+enum FrustumTest
+{
+    FRUSTUM_OUTSIDE,
+    FRUSTUM_INTERSECTS,
+    FRUSTUM_INSIDE
+};
+
+// The six planes of the clip volume of a matrix, -w <= x, y, z <= w. Built
+// from a projection alone it is the frustum in view space, from a view
+// projection it is in world space and from a WVP in the space of the object.
+// The planes face inwards and are normalized, so plugging a point into one
+// gives its distance from the plane.
+class Frustum
+{
+public:
+
+    enum {
+        PLANE_LEFT,
+        PLANE_RIGHT,
+        PLANE_BOTTOM,
+        PLANE_TOP,
+        PLANE_NEAR,
+        PLANE_FAR,
+        NUM_PLANES
+    };
+
+    Frustum()
+    {
+    }
+
+    Frustum(const Matrix4f& Mat)
+    {
+        Init(Mat);
+    }
+
+    void Init(const Matrix4f& Mat);
+
+    // (a, b, c, d) with a * x + b * y + c * z + d >= 0 on the inside
+    const Vector4f& GetPlane(unsigned int Plane) const
+    {
+        return m_planes[Plane];
+    }
+
+    FrustumTest Classify(const AABB& Box) const;
+    FrustumTest Classify(const BoundingSphere& Sphere) const;
+
+private:
+
+    Vector4f m_planes[NUM_PLANES];
+};
+
 #endif	/* MATH_3D_H */
 
@@ -0,0 +1,470 @@
+#include <math.h>
+#include <float.h>
+
+#include "math_batch.h"
+
+// The loops below are written once against a handful of four wide
+// operations, mapped to SSE or NEON. Without either only the scalar
+// remainder loops are left.
+
+#if defined(MATH_3D_SSE)
+
+#define MATH_BATCH_SIMD
+
+typedef __m128 Float4;
+
+static inline Float4 Load4(const float* p) { return _mm_loadu_ps(p); }
+static inline void Store4(float* p, Float4 v) { _mm_storeu_ps(p, v); }
+static inline Float4 Splat4(float f) { return _mm_set1_ps(f); }
+static inline Float4 Add4(Float4 a, Float4 b) { return _mm_add_ps(a, b); }
+static inline Float4 Sub4(Float4 a, Float4 b) { return _mm_sub_ps(a, b); }
+static inline Float4 Mul4(Float4 a, Float4 b) { return _mm_mul_ps(a, b); }
+static inline Float4 MulAdd4(Float4 a, Float4 b, Float4 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+static inline Float4 Min4(Float4 a, Float4 b) { return _mm_min_ps(a, b); }
+
+// Bit i is set when lane i is negative
+static inline int NegativeMask4(Float4 v) { return _mm_movemask_ps(_mm_cmplt_ps(v, _mm_setzero_ps())); }
+
+// Four consecutive Vector3f to a register per component and back. The twelve
+// floats are loaded as x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3.
+static inline void LoadVector3f4(const Vector3f* p, Float4& x, Float4& y, Float4& z)
+{
+    const __m128 a = _mm_loadu_ps(&p->x);
+    const __m128 b = _mm_loadu_ps(&p->x + 4);
+    const __m128 c = _mm_loadu_ps(&p->x + 8);
+
+    x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+    y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+                       _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+    z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+                       _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+static inline void StoreVector3f4(Vector3f* p, Float4 x, Float4 y, Float4 z)
+{
+    const __m128 a = _mm_shuffle_ps(_mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)),
+                                    _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+    const __m128 b = _mm_shuffle_ps(_mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)),
+                                    _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+    const __m128 c = _mm_shuffle_ps(_mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)),
+                                    _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+
+    _mm_storeu_ps(&p->x, a);
+    _mm_storeu_ps(&p->x + 4, b);
+    _mm_storeu_ps(&p->x + 8, c);
+}
+
+#elif defined(MATH_3D_NEON)
+
+#define MATH_BATCH_SIMD
+
+typedef float32x4_t Float4;
+
+static inline Float4 Load4(const float* p) { return vld1q_f32(p); }
+static inline void Store4(float* p, Float4 v) { vst1q_f32(p, v); }
+static inline Float4 Splat4(float f) { return vdupq_n_f32(f); }
+static inline Float4 Add4(Float4 a, Float4 b) { return vaddq_f32(a, b); }
+static inline Float4 Sub4(Float4 a, Float4 b) { return vsubq_f32(a, b); }
+static inline Float4 Mul4(Float4 a, Float4 b) { return vmulq_f32(a, b); }
+static inline Float4 MulAdd4(Float4 a, Float4 b, Float4 c) { return vmlaq_f32(c, a, b); }
+static inline Float4 Min4(Float4 a, Float4 b) { return vminq_f32(a, b); }
+
+static inline int NegativeMask4(Float4 v)
+{
+    const uint32x4_t Negative = vcltq_f32(v, vdupq_n_f32(0.0f));
+
+    return (vgetq_lane_u32(Negative, 0) & 1) | (vgetq_lane_u32(Negative, 1) & 2) |
+           (vgetq_lane_u32(Negative, 2) & 4) | (vgetq_lane_u32(Negative, 3) & 8);
+}
+
+// The structure loads and stores deinterleave the components on their own
+static inline void LoadVector3f4(const Vector3f* p, Float4& x, Float4& y, Float4& z)
+{
+    const float32x4x3_t v = vld3q_f32(&p->x);
+
+    x = v.val[0];
+    y = v.val[1];
+    z = v.val[2];
+}
+
+static inline void StoreVector3f4(Vector3f* p, Float4 x, Float4 y, Float4 z)
+{
+    float32x4x3_t v;
+    v.val[0] = x;
+    v.val[1] = y;
+    v.val[2] = z;
+
+    vst3q_f32(&p->x, v);
+}
+
+#endif
+
+
+#ifdef MATH_BATCH_SIMD
+
+// The first three rows of a matrix with every element in all four lanes. The
+// last column is scaled by w so that directions drop the translation.
+struct SplatRows
+{
+    Float4 m[3][4];
+
+    SplatRows(const Matrix4f& Mat, float w)
+    {
+        for (unsigned int i = 0 ; i < 3 ; i++) {
+            m[i][0] = Splat4(Mat.m[i][0]);
+            m[i][1] = Splat4(Mat.m[i][1]);
+            m[i][2] = Splat4(Mat.m[i][2]);
+            m[i][3] = Splat4(Mat.m[i][3] * w);
+        }
+    }
+
+    inline Float4 Row(unsigned int i, Float4 x, Float4 y, Float4 z) const
+    {
+        return MulAdd4(x, m[i][0], MulAdd4(y, m[i][1], MulAdd4(z, m[i][2], m[i][3])));
+    }
+};
+
+#endif
+
+
+static inline float TransformRow(const Matrix4f& Mat, unsigned int i, float x, float y, float z, float w)
+{
+    return Mat.m[i][0] * x + Mat.m[i][1] * y + Mat.m[i][2] * z + Mat.m[i][3] * w;
+}
+
+
+static void TransformVectors(const Matrix4f& Mat, float w, const Vector3f* pIn, Vector3f* pOut, unsigned int Count)
+{
+    unsigned int i = 0;
+
+#ifdef MATH_BATCH_SIMD
+    const SplatRows Rows(Mat, w);
+
+    for ( ; i + 4 <= Count ; i += 4) {
+        Float4 x, y, z;
+        LoadVector3f4(pIn + i, x, y, z);
+        StoreVector3f4(pOut + i, Rows.Row(0, x, y, z), Rows.Row(1, x, y, z), Rows.Row(2, x, y, z));
+    }
+#endif
+
+    for ( ; i < Count ; i++) {
+        const Vector3f v = pIn[i];
+        pOut[i] = Vector3f(TransformRow(Mat, 0, v.x, v.y, v.z, w),
+                           TransformRow(Mat, 1, v.x, v.y, v.z, w),
+                           TransformRow(Mat, 2, v.x, v.y, v.z, w));
+    }
+}
+
+
+static void TransformVectorsSoA(const Matrix4f& Mat, float w, const float* pX, const float* pY, const float* pZ,
+                                float* pOutX, float* pOutY, float* pOutZ, unsigned int Count)
+{
+    unsigned int i = 0;
+
+#ifdef MATH_BATCH_SIMD
+    const SplatRows Rows(Mat, w);
+
+    for ( ; i + 4 <= Count ; i += 4) {
+        const Float4 x = Load4(pX + i);
+        const Float4 y = Load4(pY + i);
+        const Float4 z = Load4(pZ + i);
+
+        Store4(pOutX + i, Rows.Row(0, x, y, z));
+        Store4(pOutY + i, Rows.Row(1, x, y, z));
+        Store4(pOutZ + i, Rows.Row(2, x, y, z));
+    }
+#endif
+
+    for ( ; i < Count ; i++) {
+        const float x = pX[i];
+        const float y = pY[i];
+        const float z = pZ[i];
+
+        pOutX[i] = TransformRow(Mat, 0, x, y, z, w);
+        pOutY[i] = TransformRow(Mat, 1, x, y, z, w);
+        pOutZ[i] = TransformRow(Mat, 2, x, y, z, w);
+    }
+}
+
+
+void TransformPoints(const Matrix4f& Mat, const Vector3f* pIn, Vector3f* pOut, unsigned int Count)
+{
+    TransformVectors(Mat, 1.0f, pIn, pOut, Count);
+}
+
+
+void TransformDirections(const Matrix4f& Mat, const Vector3f* pIn, Vector3f* pOut, unsigned int Count)
+{
+    TransformVectors(Mat, 0.0f, pIn, pOut, Count);
+}
+
+
+void TransformPointsSoA(const Matrix4f& Mat, const float* pX, const float* pY, const float* pZ,
+                        float* pOutX, float* pOutY, float* pOutZ, unsigned int Count)
+{
+    TransformVectorsSoA(Mat, 1.0f, pX, pY, pZ, pOutX, pOutY, pOutZ, Count);
+}
+
+
+void TransformDirectionsSoA(const Matrix4f& Mat, const float* pX, const float* pY, const float* pZ,
+                            float* pOutX, float* pOutY, float* pOutZ, unsigned int Count)
+{
+    TransformVectorsSoA(Mat, 0.0f, pX, pY, pZ, pOutX, pOutY, pOutZ, Count);
+}
+
+
+void MultiplyMatrices(const Matrix4f& Left, const Matrix4f* pRight, Matrix4f* pOut, unsigned int Count)
+{
+#ifdef MATH_BATCH_SIMD
+    // A row of the product is the rows of the right matrix weighted by the
+    // elements of the same row on the left, which are the same every time
+    Float4 l[4][4];
+
+    for (unsigned int r = 0 ; r < 4 ; r++) {
+        for (unsigned int k = 0 ; k < 4 ; k++) {
+            l[r][k] = Splat4(Left.m[r][k]);
+        }
+    }
+
+    for (unsigned int i = 0 ; i < Count ; i++) {
+        const Float4 r0 = Load4(pRight[i].m[0]);
+        const Float4 r1 = Load4(pRight[i].m[1]);
+        const Float4 r2 = Load4(pRight[i].m[2]);
+        const Float4 r3 = Load4(pRight[i].m[3]);
+
+        for (unsigned int r = 0 ; r < 4 ; r++) {
+            Store4(pOut[i].m[r], MulAdd4(l[r][0], r0, MulAdd4(l[r][1], r1, MulAdd4(l[r][2], r2, Mul4(l[r][3], r3)))));
+        }
+    }
+#else
+    for (unsigned int i = 0 ; i < Count ; i++) {
+        const Matrix4f Right = pRight[i];
+        Matrix4fMultiplyScalar(&Left.m[0][0], &Right.m[0][0], &pOut[i].m[0][0]);
+    }
+#endif
+}
+
+
+void MultiplyMatrices(const Matrix4f* pLeft, const Matrix4f& Right, Matrix4f* pOut, unsigned int Count)
+{
+#ifdef MATH_BATCH_SIMD
+    const Float4 r0 = Load4(Right.m[0]);
+    const Float4 r1 = Load4(Right.m[1]);
+    const Float4 r2 = Load4(Right.m[2]);
+    const Float4 r3 = Load4(Right.m[3]);
+
+    for (unsigned int i = 0 ; i < Count ; i++) {
+        Float4 Rows[4];
+
+        // All four rows are read before any is written, pOut may be pLeft
+        for (unsigned int r = 0 ; r < 4 ; r++) {
+            const float* pRow = pLeft[i].m[r];
+            Rows[r] = MulAdd4(Splat4(pRow[0]), r0, MulAdd4(Splat4(pRow[1]), r1,
+                      MulAdd4(Splat4(pRow[2]), r2, Mul4(Splat4(pRow[3]), r3))));
+        }
+
+        for (unsigned int r = 0 ; r < 4 ; r++) {
+            Store4(pOut[i].m[r], Rows[r]);
+        }
+    }
+#else
+    for (unsigned int i = 0 ; i < Count ; i++) {
+        const Matrix4f Left = pLeft[i];
+        Matrix4fMultiplyScalar(&Left.m[0][0], &Right.m[0][0], &pOut[i].m[0][0]);
+    }
+#endif
+}
+
+
+// Arvo's method on the center and half extent of the box: the center is
+// transformed as a point and every new half extent is the old ones weighted by
+// the absolute values of the matching row
+void TransformBoxes(const Matrix4f& Mat, const Vector3f* pMin, const Vector3f* pMax,
+                    Vector3f* pOutMin, Vector3f* pOutMax, unsigned int Count)
+{
+    float Abs[3][3];
+
+    for (unsigned int r = 0 ; r < 3 ; r++) {
+        for (unsigned int c = 0 ; c < 3 ; c++) {
+            Abs[r][c] = fabsf(Mat.m[r][c]);
+        }
+    }
+
+    unsigned int i = 0;
+
+#ifdef MATH_BATCH_SIMD
+    const SplatRows Rows(Mat, 1.0f);
+    const Float4 Half = Splat4(0.5f);
+    Float4 AbsRows[3][3];
+
+    for (unsigned int r = 0 ; r < 3 ; r++) {
+        for (unsigned int c = 0 ; c < 3 ; c++) {
+            AbsRows[r][c] = Splat4(Abs[r][c]);
+        }
+    }
+
+    for ( ; i + 4 <= Count ; i += 4) {
+        Float4 MinX, MinY, MinZ, MaxX, MaxY, MaxZ;
+        LoadVector3f4(pMin + i, MinX, MinY, MinZ);
+        LoadVector3f4(pMax + i, MaxX, MaxY, MaxZ);
+
+        const Float4 cx = Mul4(Add4(MinX, MaxX), Half);
+        const Float4 cy = Mul4(Add4(MinY, MaxY), Half);
+        const Float4 cz = Mul4(Add4(MinZ, MaxZ), Half);
+        const Float4 ex = Mul4(Sub4(MaxX, MinX), Half);
+        const Float4 ey = Mul4(Sub4(MaxY, MinY), Half);
+        const Float4 ez = Mul4(Sub4(MaxZ, MinZ), Half);
+
+        Float4 Center[3], Extent[3];
+
+        for (unsigned int r = 0 ; r < 3 ; r++) {
+            Center[r] = Rows.Row(r, cx, cy, cz);
+            Extent[r] = MulAdd4(ex, AbsRows[r][0], MulAdd4(ey, AbsRows[r][1], Mul4(ez, AbsRows[r][2])));
+        }
+
+        StoreVector3f4(pOutMin + i, Sub4(Center[0], Extent[0]), Sub4(Center[1], Extent[1]), Sub4(Center[2], Extent[2]));
+        StoreVector3f4(pOutMax + i, Add4(Center[0], Extent[0]), Add4(Center[1], Extent[1]), Add4(Center[2], Extent[2]));
+    }
+#endif
+
+    for ( ; i < Count ; i++) {
+        const Vector3f c = (pMin[i] + pMax[i]) * 0.5f;
+        const Vector3f e = (pMax[i] - pMin[i]) * 0.5f;
+        float Center[3], Extent[3];
+
+        for (unsigned int r = 0 ; r < 3 ; r++) {
+            Center[r] = TransformRow(Mat, r, c.x, c.y, c.z, 1.0f);
+            Extent[r] = Abs[r][0] * e.x + Abs[r][1] * e.y + Abs[r][2] * e.z;
+        }
+
+        pOutMin[i] = Vector3f(Center[0] - Extent[0], Center[1] - Extent[1], Center[2] - Extent[2]);
+        pOutMax[i] = Vector3f(Center[0] + Extent[0], Center[1] + Extent[1], Center[2] + Extent[2]);
+    }
+}
+
+
+#ifdef MATH_BATCH_SIMD
+
+// The planes of a frustum with every component in all four lanes, plus the
+// absolute values of the normals for the boxes
+struct SplatPlanes
+{
+    Float4 p[Frustum::NUM_PLANES][4];
+    Float4 Abs[Frustum::NUM_PLANES][3];
+
+    SplatPlanes(const Frustum& f)
+    {
+        for (unsigned int i = 0 ; i < Frustum::NUM_PLANES ; i++) {
+            const Vector4f& Plane = f.GetPlane(i);
+
+            p[i][0] = Splat4(Plane.x);
+            p[i][1] = Splat4(Plane.y);
+            p[i][2] = Splat4(Plane.z);
+            p[i][3] = Splat4(Plane.w);
+            Abs[i][0] = Splat4(fabsf(Plane.x));
+            Abs[i][1] = Splat4(fabsf(Plane.y));
+            Abs[i][2] = Splat4(fabsf(Plane.z));
+        }
+    }
+
+    inline Float4 Distance(unsigned int i, Float4 x, Float4 y, Float4 z) const
+    {
+        return MulAdd4(x, p[i][0], MulAdd4(y, p[i][1], MulAdd4(z, p[i][2], p[i][3])));
+    }
+};
+
+// Appends the four indices from First on whose bit in Outside is clear,
+// without branching on the mask
+static inline unsigned int AppendVisible4(unsigned int First, int Outside, unsigned int* pVisible)
+{
+    unsigned int NumVisible = 0;
+
+    for (unsigned int b = 0 ; b < 4 ; b++) {
+        pVisible[NumVisible] = First + b;
+        NumVisible += ((Outside >> b) & 1) ^ 1;
+    }
+
+    return NumVisible;
+}
+
+#endif
+
+
+// Same test as Frustum::Classify(): a box is out when its center is further
+// behind some plane than its half extent projected on the normal
+unsigned int CullBoxes(const Frustum& f, const Vector3f* pMin, const Vector3f* pMax,
+                       unsigned int Count, unsigned int* pVisible)
+{
+    unsigned int NumVisible = 0;
+    unsigned int i = 0;
+
+#ifdef MATH_BATCH_SIMD
+    const SplatPlanes Planes(f);
+    const Float4 Half = Splat4(0.5f);
+
+    for ( ; i + 4 <= Count ; i += 4) {
+        Float4 MinX, MinY, MinZ, MaxX, MaxY, MaxZ;
+        LoadVector3f4(pMin + i, MinX, MinY, MinZ);
+        LoadVector3f4(pMax + i, MaxX, MaxY, MaxZ);
+
+        const Float4 cx = Mul4(Add4(MinX, MaxX), Half);
+        const Float4 cy = Mul4(Add4(MinY, MaxY), Half);
+        const Float4 cz = Mul4(Add4(MinZ, MaxZ), Half);
+        const Float4 ex = Mul4(Sub4(MaxX, MinX), Half);
+        const Float4 ey = Mul4(Sub4(MaxY, MinY), Half);
+        const Float4 ez = Mul4(Sub4(MaxZ, MinZ), Half);
+
+        // Smallest distance of the furthest corner in front of any plane
+        Float4 Margin = Splat4(FLT_MAX);
+
+        for (unsigned int p = 0 ; p < Frustum::NUM_PLANES ; p++) {
+            const Float4 Radius = MulAdd4(ex, Planes.Abs[p][0], MulAdd4(ey, Planes.Abs[p][1], Mul4(ez, Planes.Abs[p][2])));
+            Margin = Min4(Margin, Add4(Planes.Distance(p, cx, cy, cz), Radius));
+        }
+
+        NumVisible += AppendVisible4(i, NegativeMask4(Margin), pVisible + NumVisible);
+    }
+#endif
+
+    for ( ; i < Count ; i++) {
+        if (f.Classify(AABB(pMin[i], pMax[i])) != FRUSTUM_OUTSIDE) {
+            pVisible[NumVisible++] = i;
+        }
+    }
+
+    return NumVisible;
+}
+
+
+unsigned int CullSpheres(const Frustum& f, const Vector3f* pCenters, const float* pRadii,
+                         unsigned int Count, unsigned int* pVisible)
+{
+    unsigned int NumVisible = 0;
+    unsigned int i = 0;
+
+#ifdef MATH_BATCH_SIMD
+    const SplatPlanes Planes(f);
+
+    for ( ; i + 4 <= Count ; i += 4) {
+        Float4 x, y, z;
+        LoadVector3f4(pCenters + i, x, y, z);
+        const Float4 Radius = Load4(pRadii + i);
+
+        Float4 Margin = Splat4(FLT_MAX);
+
+        for (unsigned int p = 0 ; p < Frustum::NUM_PLANES ; p++) {
+            Margin = Min4(Margin, Add4(Planes.Distance(p, x, y, z), Radius));
+        }
+
+        NumVisible += AppendVisible4(i, NegativeMask4(Margin), pVisible + NumVisible);
+    }
+#endif
+
+    for ( ; i < Count ; i++) {
+        if (f.Classify(BoundingSphere(pCenters[i], pRadii[i])) != FRUSTUM_OUTSIDE) {
+            pVisible[NumVisible++] = i;
+        }
+    }
+
+    return NumVisible;
+}
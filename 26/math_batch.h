@@ -0,0 +1,46 @@
+#ifndef MATH_BATCH_H
+#define	MATH_BATCH_H
+
+#include "math_3d.h"
+
+// Array versions of the Matrix4f products. The matrix is set up once per call
+// instead of once per element and the inner loops handle four elements per
+// SIMD iteration, with a scalar loop for the remainder.
+//
+// Points are transformed as (x, y, z, 1) and directions as (x, y, z, 0). Only
+// the first three rows of the matrix are used, so the results are meant for
+// affine matrices such as world and view; there is no divide by w. The output
+// may be the same array as the input.
+
+void TransformPoints(const Matrix4f& Mat, const Vector3f* pIn, Vector3f* pOut, unsigned int Count);
+
+void TransformDirections(const Matrix4f& Mat, const Vector3f* pIn, Vector3f* pOut, unsigned int Count);
+
+// Same as above on separate x, y and z arrays
+void TransformPointsSoA(const Matrix4f& Mat, const float* pX, const float* pY, const float* pZ,
+                        float* pOutX, float* pOutY, float* pOutZ, unsigned int Count);
+
+void TransformDirectionsSoA(const Matrix4f& Mat, const float* pX, const float* pY, const float* pZ,
+                            float* pOutX, float* pOutY, float* pOutZ, unsigned int Count);
+
+// pOut[i] = Left * pRight[i], e.g. the view projection times a list of world matrices
+void MultiplyMatrices(const Matrix4f& Left, const Matrix4f* pRight, Matrix4f* pOut, unsigned int Count);
+
+// pOut[i] = pLeft[i] * Right
+void MultiplyMatrices(const Matrix4f* pLeft, const Matrix4f& Right, Matrix4f* pOut, unsigned int Count);
+
+// Axis aligned boxes given by their corners. Every box is replaced by the
+// smallest axis aligned box around the transformed one.
+void TransformBoxes(const Matrix4f& Mat, const Vector3f* pMin, const Vector3f* pMax,
+                    Vector3f* pOutMin, Vector3f* pOutMax, unsigned int Count);
+
+// Frustum culling of arrays of boxes, given by their corners, and of spheres.
+// The indices of the ones not entirely outside go to pVisible in increasing
+// order and their number is returned. pVisible needs room for Count indices.
+unsigned int CullBoxes(const Frustum& f, const Vector3f* pMin, const Vector3f* pMax,
+                       unsigned int Count, unsigned int* pVisible);
+
+unsigned int CullSpheres(const Frustum& f, const Vector3f* pCenters, const float* pRadii,
+                         unsigned int Count, unsigned int* pVisible);
+
+#endif	/* MATH_BATCH_H */
@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "math_benchmark.h"
+#include "math_3d.h"
+#include "math_batch.h"
+#include "pipeline.h"
+
+// Enough matrices to stay in L1 and L2 while still defeating the
+// optimizer's constant folding
+#define BENCHMARK_COUNT 1024
+#define BENCHMARK_PASSES 1000
+
+// Keeps the results alive so that the loops are not dropped
+static volatile float s_sink;
+
+// Static storage honors alignas in every standard, unlike operator new before
+// C++17, which on 32 bit MSVC only guarantees 8 bytes
+static AlignedMatrix4f s_alignedLeft[BENCHMARK_COUNT];
+static AlignedMatrix4f s_alignedRight[BENCHMARK_COUNT];
+static AlignedMatrix4f s_alignedResult[BENCHMARK_COUNT];
+
+
+static float RandomFloat()
+{
+    return (float)rand() / RAND_MAX * 2.0f - 1.0f;
+}
+
+
+// Reference copy of the rotation as it was built before InitRotateTransform
+// went through InitTRSTransform: one matrix per axis, multiplied together
+static void InitRotateTransformComposed(Matrix4f& Mat, float RotateX, float RotateY, float RotateZ)
+{
+    Matrix4f rx, ry, rz;
+
+    const float x = glm::radians(RotateX);
+    const float y = glm::radians(RotateY);
+    const float z = glm::radians(RotateZ);
+
+    rx.m[0][0] = 1.0f; rx.m[0][1] = 0.0f   ; rx.m[0][2] = 0.0f    ; rx.m[0][3] = 0.0f;
+    rx.m[1][0] = 0.0f; rx.m[1][1] = cosf(x); rx.m[1][2] = -sinf(x); rx.m[1][3] = 0.0f;
+    rx.m[2][0] = 0.0f; rx.m[2][1] = sinf(x); rx.m[2][2] = cosf(x) ; rx.m[2][3] = 0.0f;
+    rx.m[3][0] = 0.0f; rx.m[3][1] = 0.0f   ; rx.m[3][2] = 0.0f    ; rx.m[3][3] = 1.0f;
+
+    ry.m[0][0] = cosf(y); ry.m[0][1] = 0.0f; ry.m[0][2] = -sinf(y); ry.m[0][3] = 0.0f;
+    ry.m[1][0] = 0.0f   ; ry.m[1][1] = 1.0f; ry.m[1][2] = 0.0f    ; ry.m[1][3] = 0.0f;
+    ry.m[2][0] = sinf(y); ry.m[2][1] = 0.0f; ry.m[2][2] = cosf(y) ; ry.m[2][3] = 0.0f;
+    ry.m[3][0] = 0.0f   ; ry.m[3][1] = 0.0f; ry.m[3][2] = 0.0f    ; ry.m[3][3] = 1.0f;
+
+    rz.m[0][0] = cosf(z); rz.m[0][1] = -sinf(z); rz.m[0][2] = 0.0f; rz.m[0][3] = 0.0f;
+    rz.m[1][0] = sinf(z); rz.m[1][1] = cosf(z) ; rz.m[1][2] = 0.0f; rz.m[1][3] = 0.0f;
+    rz.m[2][0] = 0.0f   ; rz.m[2][1] = 0.0f    ; rz.m[2][2] = 1.0f; rz.m[2][3] = 0.0f;
+    rz.m[3][0] = 0.0f   ; rz.m[3][1] = 0.0f    ; rz.m[3][2] = 0.0f; rz.m[3][3] = 1.0f;
+
+    Mat = rz * ry * rx;
+}
+
+
+static void RandomMatrix(Matrix4f& Mat)
+{
+    for (unsigned int i = 0 ; i < 4 ; i++) {
+        for (unsigned int j = 0 ; j < 4 ; j++) {
+            Mat.m[i][j] = RandomFloat();
+        }
+    }
+}
+
+
+static double NsPerOp(std::chrono::high_resolution_clock::time_point Start, unsigned int Ops)
+{
+    const std::chrono::duration<double, std::nano> Elapsed = std::chrono::high_resolution_clock::now() - Start;
+    return Elapsed.count() / Ops;
+}
+
+
+void RunMathBenchmark()
+{
+    typedef std::chrono::high_resolution_clock Clock;
+
+    const unsigned int NumOps = BENCHMARK_COUNT * BENCHMARK_PASSES;
+
+    std::vector<Matrix4f> Left(BENCHMARK_COUNT), Right(BENCHMARK_COUNT), Result(BENCHMARK_COUNT);
+    std::vector<Vector4f> Vectors(BENCHMARK_COUNT), Transformed(BENCHMARK_COUNT);
+
+    srand(1);
+
+    for (unsigned int i = 0 ; i < BENCHMARK_COUNT ; i++) {
+        RandomMatrix(Left[i]);
+        RandomMatrix(Right[i]);
+        Vectors[i] = Vector4f(RandomFloat(), RandomFloat(), RandomFloat(), 1.0f);
+        s_alignedLeft[i] = Left[i];
+        s_alignedRight[i] = Right[i];
+    }
+
+    Clock::time_point Start = Clock::now();
+
+    for (unsigned int Pass = 0 ; Pass < BENCHMARK_PASSES ; Pass++) {
+        for (unsigned int i = 0 ; i < BENCHMARK_COUNT ; i++) {
+            Matrix4fMultiplyScalar(&Left[i].m[0][0], &Right[i].m[0][0], &Result[i].m[0][0]);
+        }
+    }
+
+    const double MulScalar = NsPerOp(Start, NumOps);
+    s_sink = Result[BENCHMARK_COUNT - 1].m[3][3];
+
+    Start = Clock::now();
+
+    for (unsigned int Pass = 0 ; Pass < BENCHMARK_PASSES ; Pass++) {
+        for (unsigned int i = 0 ; i < BENCHMARK_COUNT ; i++) {
+            Result[i] = Left[i] * Right[i];
+        }
+    }
+
+    const double MulSIMD = NsPerOp(Start, NumOps);
+    s_sink = Result[BENCHMARK_COUNT - 1].m[3][3];
+
+    Start = Clock::now();
+
+    for (unsigned int Pass = 0 ; Pass < BENCHMARK_PASSES ; Pass++) {
+        for (unsigned int i = 0 ; i < BENCHMARK_COUNT ; i++) {
+            s_alignedResult[i] = s_alignedLeft[i] * s_alignedRight[i];
+        }
+    }
+
+    const double MulAligned = NsPerOp(Start, NumOps);
+    s_sink = s_alignedResult[BENCHMARK_COUNT - 1].m[3][3];
+
+    Start = Clock::now();
+
+    for (unsigned int Pass = 0 ; Pass < BENCHMARK_PASSES ; Pass++) {
+        for (unsigned int i = 0 ; i < BENCHMARK_COUNT ; i++) {
+            Matrix4fTransformScalar(&Left[i].m[0][0], &Vectors[i].x, &Transformed[i].x);
+        }
+    }
+
+    const double TransformScalar = NsPerOp(Start, NumOps);
+    s_sink = Transformed[BENCHMARK_COUNT - 1].w;
+
+    Start = Clock::now();
+
+    for (unsigned int Pass = 0 ; Pass < BENCHMARK_PASSES ; Pass++) {
+        for (unsigned int i = 0 ; i < BENCHMARK_COUNT ; i++) {
+            Transformed[i] = Left[i] * Vectors[i];
+        }
+    }
+
+    const double TransformSIMD = NsPerOp(Start, NumOps);
+    s_sink = Transformed[BENCHMARK_COUNT - 1].w;
+
+    std::vector<Vector3f> Points(BENCHMARK_COUNT), TransformedPoints(BENCHMARK_COUNT);
+
+    for (unsigned int i = 0 ; i < BENCHMARK_COUNT ; i++) {
+        Points[i] = Vector3f(Vectors[i].x, Vectors[i].y, Vectors[i].z);
+    }
+
+    Start = Clock::now();
+
+    for (unsigned int Pass = 0 ; Pass < BENCHMARK_PASSES ; Pass++) {
+        for (unsigned int i = 0 ; i < BENCHMARK_COUNT ; i++) {
+            const Vector4f v = Left[Pass % BENCHMARK_COUNT] * Vector4f(Points[i].x, Points[i].y, Points[i].z, 1.0f);
+            TransformedPoints[i] = Vector3f(v.x, v.y, v.z);
+        }
+    }
+
+    const double PointsSingle = NsPerOp(Start, NumOps);
+    s_sink = TransformedPoints[BENCHMARK_COUNT - 1].z;
+
+    Start = Clock::now();
+
+    for (unsigned int Pass = 0 ; Pass < BENCHMARK_PASSES ; Pass++) {
+        TransformPoints(Left[Pass % BENCHMARK_COUNT], Points.data(), TransformedPoints.data(), BENCHMARK_COUNT);
+    }
+
+    const double PointsBatch = NsPerOp(Start, NumOps);
+    s_sink = TransformedPoints[BENCHMARK_COUNT - 1].z;
+
+    Start = Clock::now();
+
+    for (unsigned int Pass = 0 ; Pass < BENCHMARK_PASSES ; Pass++) {
+        MultiplyMatrices(Left[Pass % BENCHMARK_COUNT], Right.data(), Result.data(), BENCHMARK_COUNT);
+    }
+
+    const double MulBatch = NsPerOp(Start, NumOps);
+    s_sink = Result[BENCHMARK_COUNT - 1].m[3][3];
+
+    // A world matrix composed from the three transforms, with the rotation
+    // built the old way, against the fused builders, with Euler angles and
+    // with a quaternion
+    Start = Clock::now();
+
+    for (unsigned int i = 0 ; i < NumOps / 16 ; i++) {
+        Matrix4f ScaleTrans, RotateTrans, TranslationTrans;
+        ScaleTrans.InitScaleTransform(1.0f, 0.25f, 1.0f);
+        InitRotateTransformComposed(RotateTrans, 0.0f, (float)(i & 255), 0.0f);
+        TranslationTrans.InitTranslationTransform((float)(i & 15), -1.5f, 3.0f);
+        s_sink = (TranslationTrans * RotateTrans * ScaleTrans).m[0][0];
+    }
+
+    const double WorldComposed = NsPerOp(Start, NumOps / 16);
+
+    Start = Clock::now();
+
+    for (unsigned int i = 0 ; i < NumOps / 16 ; i++) {
+        Matrix4f World;
+        World.InitTRSTransform(Vector3f((float)(i & 15), -1.5f, 3.0f), Vector3f(0.0f, (float)(i & 255), 0.0f),
+                               Vector3f(1.0f, 0.25f, 1.0f));
+        s_sink = World.m[0][0];
+    }
+
+    const double WorldFused = NsPerOp(Start, NumOps / 16);
+
+    const Quaternion Orientation(Vector3f(0.0f, 1.0f, 0.0f), 30.0f);
+
+    Start = Clock::now();
+
+    for (unsigned int i = 0 ; i < NumOps / 16 ; i++) {
+        Matrix4f World;
+        World.InitTRSTransform(Vector3f((float)(i & 15), -1.5f, 3.0f), Orientation, Vector3f(1.0f, 0.25f, 1.0f));
+        s_sink = World.m[0][0];
+    }
+
+    const double WorldQuaternion = NsPerOp(Start, NumOps / 16);
+
+    // The way every draw of the tutorials builds its matrices
+    PersProjInfo ProjInfo = { 60.0f, 1920.0f, 1200.0f, 1.0f, 100.0f };
+    Pipeline p;
+    p.SetCamera(Vector3f(0.0f, 1.0f, -5.0f), Vector3f(0.0f, 0.0f, 1.0f), Vector3f(0.0f, 1.0f, 0.0f));
+    p.SetPerspectiveProj(ProjInfo);
+
+    Start = Clock::now();
+
+    for (unsigned int i = 0 ; i < NumOps / 16 ; i++) {
+        p.Scale(1.0f, 0.25f, 1.0f);
+        p.Rotate(0.0f, (float)(i & 255), 0.0f);
+        p.WorldPos((float)(i & 15), -1.5f, 3.0f);
+        s_sink = p.GetWVPTrans().m[3][3];
+    }
+
+    const double WVP = NsPerOp(Start, NumOps / 16);
+
+#if defined(MATH_3D_SSE)
+    const char* pPath = "SSE";
+#elif defined(MATH_3D_NEON)
+    const char* pPath = "NEON";
+#else
+    const char* pPath = "scalar fallback";
+#endif
+
+    printf("Math benchmark, %s kernels, ns per operation\n", pPath);
+    printf("  Matrix4f * Matrix4f   scalar %.2f, SIMD %.2f, aligned %.2f\n", MulScalar, MulSIMD, MulAligned);
+    printf("  Matrix4f * Vector4f   scalar %.2f, SIMD %.2f\n", TransformScalar, TransformSIMD);
+    printf("  Batch points          one by one %.2f, TransformPoints %.2f\n", PointsSingle, PointsBatch);
+    printf("  Batch Matrix4f        MultiplyMatrices %.2f\n", MulBatch);
+    printf("  World matrix          composed %.2f, fused %.2f, quaternion %.2f\n", WorldComposed, WorldFused, WorldQuaternion);
+    printf("  Pipeline::GetWVPTrans %.2f\n", WVP);
+}
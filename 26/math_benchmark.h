@@ -0,0 +1,9 @@
+#ifndef MATH_BENCHMARK_H
+#define	MATH_BENCHMARK_H
+
+// Times the transform math on the CPU: the scalar reference kernels against
+// the SIMD ones behind Matrix4f, plus a full Pipeline::GetWVPTrans(). The
+// results are printed as nanoseconds per operation.
+void RunMathBenchmark();
+
+#endif	/* MATH_BENCHMARK_H */
@@ -0,0 +1,145 @@
+#ifndef MATH_SIMD_H
+#define	MATH_SIMD_H
+
+// 4x4 matrix kernels behind the Matrix4f operators. The matrices are row
+// major, 16 consecutive floats. SSE is used on x86 and NEON on ARM, anything
+// else falls back to the scalar versions, which are always compiled so that
+// the benchmark can compare against them.
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MATH_3D_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define MATH_3D_NEON
+#include <arm_neon.h>
+#endif
+
+inline void Matrix4fMultiplyScalar(const float* pLeft, const float* pRight, float* pResult)
+{
+    for (unsigned int i = 0 ; i < 4 ; i++) {
+        for (unsigned int j = 0 ; j < 4 ; j++) {
+            pResult[i * 4 + j] = pLeft[i * 4 + 0] * pRight[0 * 4 + j] +
+                                 pLeft[i * 4 + 1] * pRight[1 * 4 + j] +
+                                 pLeft[i * 4 + 2] * pRight[2 * 4 + j] +
+                                 pLeft[i * 4 + 3] * pRight[3 * 4 + j];
+        }
+    }
+}
+
+inline void Matrix4fTransformScalar(const float* pMatrix, const float* pVector, float* pResult)
+{
+    for (unsigned int i = 0 ; i < 4 ; i++) {
+        pResult[i] = pMatrix[i * 4 + 0] * pVector[0] +
+                     pMatrix[i * 4 + 1] * pVector[1] +
+                     pMatrix[i * 4 + 2] * pVector[2] +
+                     pMatrix[i * 4 + 3] * pVector[3];
+    }
+}
+
+#ifdef MATH_3D_SSE
+
+// A row of the product is the rows of the right matrix weighted by the
+// elements of the same row on the left
+inline __m128 Matrix4fCombineRows(__m128 Row, __m128 r0, __m128 r1, __m128 r2, __m128 r3)
+{
+    __m128 Sum = _mm_mul_ps(_mm_shuffle_ps(Row, Row, _MM_SHUFFLE(0, 0, 0, 0)), r0);
+    Sum = _mm_add_ps(Sum, _mm_mul_ps(_mm_shuffle_ps(Row, Row, _MM_SHUFFLE(1, 1, 1, 1)), r1));
+    Sum = _mm_add_ps(Sum, _mm_mul_ps(_mm_shuffle_ps(Row, Row, _MM_SHUFFLE(2, 2, 2, 2)), r2));
+    Sum = _mm_add_ps(Sum, _mm_mul_ps(_mm_shuffle_ps(Row, Row, _MM_SHUFFLE(3, 3, 3, 3)), r3));
+
+    return Sum;
+}
+
+inline void Matrix4fMultiply(const float* pLeft, const float* pRight, float* pResult)
+{
+    const __m128 r0 = _mm_loadu_ps(pRight);
+    const __m128 r1 = _mm_loadu_ps(pRight + 4);
+    const __m128 r2 = _mm_loadu_ps(pRight + 8);
+    const __m128 r3 = _mm_loadu_ps(pRight + 12);
+
+    for (unsigned int i = 0 ; i < 4 ; i++) {
+        _mm_storeu_ps(pResult + i * 4, Matrix4fCombineRows(_mm_loadu_ps(pLeft + i * 4), r0, r1, r2, r3));
+    }
+}
+
+// All three pointers must be 16 byte aligned
+inline void Matrix4fMultiplyAligned(const float* pLeft, const float* pRight, float* pResult)
+{
+    const __m128 r0 = _mm_load_ps(pRight);
+    const __m128 r1 = _mm_load_ps(pRight + 4);
+    const __m128 r2 = _mm_load_ps(pRight + 8);
+    const __m128 r3 = _mm_load_ps(pRight + 12);
+
+    for (unsigned int i = 0 ; i < 4 ; i++) {
+        _mm_store_ps(pResult + i * 4, Matrix4fCombineRows(_mm_load_ps(pLeft + i * 4), r0, r1, r2, r3));
+    }
+}
+
+// The products of the rows with the vector are transposed so that the four
+// dot products finish with three adds
+inline void Matrix4fTransform(const float* pMatrix, const float* pVector, float* pResult)
+{
+    const __m128 v = _mm_loadu_ps(pVector);
+    __m128 r0 = _mm_mul_ps(_mm_loadu_ps(pMatrix), v);
+    __m128 r1 = _mm_mul_ps(_mm_loadu_ps(pMatrix + 4), v);
+    __m128 r2 = _mm_mul_ps(_mm_loadu_ps(pMatrix + 8), v);
+    __m128 r3 = _mm_mul_ps(_mm_loadu_ps(pMatrix + 12), v);
+
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+    _mm_storeu_ps(pResult, _mm_add_ps(_mm_add_ps(r0, r1), _mm_add_ps(r2, r3)));
+}
+
+#elif defined(MATH_3D_NEON)
+
+inline void Matrix4fMultiply(const float* pLeft, const float* pRight, float* pResult)
+{
+    const float32x4_t r0 = vld1q_f32(pRight);
+    const float32x4_t r1 = vld1q_f32(pRight + 4);
+    const float32x4_t r2 = vld1q_f32(pRight + 8);
+    const float32x4_t r3 = vld1q_f32(pRight + 12);
+
+    for (unsigned int i = 0 ; i < 4 ; i++) {
+        float32x4_t Sum = vmulq_n_f32(r0, pLeft[i * 4 + 0]);
+        Sum = vmlaq_n_f32(Sum, r1, pLeft[i * 4 + 1]);
+        Sum = vmlaq_n_f32(Sum, r2, pLeft[i * 4 + 2]);
+        Sum = vmlaq_n_f32(Sum, r3, pLeft[i * 4 + 3]);
+        vst1q_f32(pResult + i * 4, Sum);
+    }
+}
+
+// NEON loads do not care about alignment
+inline void Matrix4fMultiplyAligned(const float* pLeft, const float* pRight, float* pResult)
+{
+    Matrix4fMultiply(pLeft, pRight, pResult);
+}
+
+inline void Matrix4fTransform(const float* pMatrix, const float* pVector, float* pResult)
+{
+    for (unsigned int i = 0 ; i < 4 ; i++) {
+        const float32x4_t p = vmulq_f32(vld1q_f32(pMatrix + i * 4), vld1q_f32(pVector));
+        const float32x2_t s = vadd_f32(vget_low_f32(p), vget_high_f32(p));
+        pResult[i] = vget_lane_f32(vpadd_f32(s, s), 0);
+    }
+}
+
+#else
+
+inline void Matrix4fMultiply(const float* pLeft, const float* pRight, float* pResult)
+{
+    Matrix4fMultiplyScalar(pLeft, pRight, pResult);
+}
+
+inline void Matrix4fMultiplyAligned(const float* pLeft, const float* pRight, float* pResult)
+{
+    Matrix4fMultiplyScalar(pLeft, pRight, pResult);
+}
+
+inline void Matrix4fTransform(const float* pMatrix, const float* pVector, float* pResult)
+{
+    Matrix4fTransformScalar(pMatrix, pVector, pResult);
+}
+
+#endif
+
+#endif	/* MATH_SIMD_H */
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <float.h>
 
 #include "mesh.h"
 #include "engine_common.h"
@@ -6,6 +7,7 @@
 Mesh::MeshEntry::MeshEntry()
 {
     VB = INVALID_OGL_VALUE;
+    PB = INVALID_OGL_VALUE;
     IB = INVALID_OGL_VALUE;
     NumIndices  = 0;
     MaterialIndex = INVALID_MATERIAL;
@@ -18,6 +20,11 @@ Mesh::MeshEntry::~MeshEntry()
         glDeleteBuffers(1, &VB);
     }
 
+    if (PB != INVALID_OGL_VALUE)
+    {
+        glDeleteBuffers(1, &PB);
+    }
+
     if (IB != INVALID_OGL_VALUE)
     {
         glDeleteBuffers(1, &IB);
@@ -32,6 +39,16 @@ bool Mesh::MeshEntry::Init(const std::vector<Vertex>& Vertices, const std::vecto
   	glBindBuffer(GL_ARRAY_BUFFER, VB);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * Vertices.size(), &Vertices[0], GL_STATIC_DRAW);
 
+    std::vector<Vector3f> Positions(Vertices.size());
+
+    for (unsigned int i = 0 ; i < Vertices.size() ; i++) {
+        Positions[i] = Vertices[i].m_pos;
+    }
+
+    glGenBuffers(1, &PB);
+    glBindBuffer(GL_ARRAY_BUFFER, PB);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(Vector3f) * Positions.size(), &Positions[0], GL_STATIC_DRAW);
+
     glGenBuffers(1, &IB);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IB);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * NumIndices, &Indices[0], GL_STATIC_DRAW);
@@ -83,6 +100,7 @@ bool Mesh::InitFromScene(const aiScene* pScene, const std::string& Filename)
 {  
     m_Entries.resize(pScene->mNumMeshes);
     m_Textures.resize(pScene->mNumMaterials);
+    m_bounds = AABB(Vector3f(FLT_MAX, FLT_MAX, FLT_MAX), Vector3f(-FLT_MAX, -FLT_MAX, -FLT_MAX));
 
     // Initialize the meshes in the scene one by one
     for (unsigned int i = 0 ; i < m_Entries.size() ; i++) {
@@ -114,6 +132,7 @@ void Mesh::InitMesh(unsigned int Index, const aiMesh* paiMesh)
                  Vector3f(pTangent->x, pTangent->y, pTangent->z));
         
         Vertices.push_back(v);
+        m_bounds.Merge(v.m_pos);
     }
 
     for (unsigned int i = 0 ; i < paiMesh->mNumFaces ; i++) {
@@ -204,3 +223,20 @@ void Mesh::Render()
     glDisableVertexAttribArray(2);
     glDisableVertexAttribArray(3);
 }
+
+
+void Mesh::RenderDepth()
+{
+    glEnableVertexAttribArray(0);
+
+    for (unsigned int i = 0 ; i < m_Entries.size() ; i++) {
+        glBindBuffer(GL_ARRAY_BUFFER, m_Entries[i].PB);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vector3f), 0);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Entries[i].IB);
+
+        glDrawElements(GL_TRIANGLES, m_Entries[i].NumIndices, GL_UNSIGNED_INT, 0);
+    }
+
+    glDisableVertexAttribArray(0);
+}
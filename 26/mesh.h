@@ -44,6 +44,16 @@ public:
 
     void Render();
 
+    // Draws the geometry from the tightly packed position buffers only - used by
+    // depth-only passes where the other attributes would just waste fetch bandwidth
+    void RenderDepth();
+
+    // Model space box around all the vertices
+    const AABB& GetBounds() const
+    {
+        return m_bounds;
+    }
+
 private:
     bool InitFromScene(const aiScene* pScene, const std::string& Filename);
     void InitMesh(unsigned int Index, const aiMesh* paiMesh);
@@ -61,6 +71,7 @@ private:
                   const std::vector<unsigned int>& Indices);
 
         GLuint VB;
+        GLuint PB;
         GLuint IB;
         unsigned int NumIndices;
         unsigned int MaterialIndex;
@@ -68,6 +79,7 @@ private:
 
     std::vector<MeshEntry> m_Entries;
     std::vector<Texture*> m_Textures;
+    AABB m_bounds;
 };
 
 
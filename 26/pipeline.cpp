@@ -3,28 +3,43 @@
 
 const Matrix4f& Pipeline::GetWorldTrans()
 {
-    Matrix4f ScaleTrans, RotateTrans, TranslationTrans;
+    if (m_useOrientation) {
+        m_WorldTransformation.InitTRSTransform(m_worldPos, m_orientation, m_scale);
+    }
+    else {
+        m_WorldTransformation.InitTRSTransform(m_worldPos, m_rotateInfo, m_scale);
+    }
 
-    ScaleTrans.InitScaleTransform(m_scale.x, m_scale.y, m_scale.z);
-    RotateTrans.InitRotateTransform(m_rotateInfo.x, m_rotateInfo.y, m_rotateInfo.z);
-    TranslationTrans.InitTranslationTransform(m_worldPos.x, m_worldPos.y, m_worldPos.z);
-
-    m_WorldTransformation = TranslationTrans * RotateTrans * ScaleTrans;
     return m_WorldTransformation;
 }
 
-const Matrix4f& Pipeline::GetWVPTrans()
+const Matrix4f& Pipeline::GetViewTrans()
 {
-    GetWorldTrans();
-
-    Matrix4f CameraTranslationTrans, CameraRotateTrans, PersProjTrans;
+    Matrix4f CameraTranslationTrans, CameraRotateTrans;
 
     CameraTranslationTrans.InitTranslationTransform(-m_camera.Pos.x, -m_camera.Pos.y, -m_camera.Pos.z);
     CameraRotateTrans.InitCameraTransform(m_camera.Target, m_camera.Up);
+
+    m_ViewTransformation = CameraRotateTrans * CameraTranslationTrans;
+    return m_ViewTransformation;
+}
+
+const Matrix4f& Pipeline::GetVPTrans()
+{
+    Matrix4f PersProjTrans;
+
+    GetViewTrans();
     PersProjTrans.InitPersProjTransform(m_persProjInfo);
 
-    m_WVPtransformation = PersProjTrans * CameraRotateTrans * CameraTranslationTrans * m_WorldTransformation;
-    return m_WVPtransformation;
+    m_VPTransformation = PersProjTrans * m_ViewTransformation;
+    return m_VPTransformation;
 }
 
+const Matrix4f& Pipeline::GetWVPTrans()
+{
+    GetWorldTrans();
+    GetVPTrans();
 
+    m_WVPtransformation = m_VPTransformation * m_WorldTransformation;
+    return m_WVPtransformation;
+}
\ No newline at end of file
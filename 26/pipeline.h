@@ -11,6 +11,8 @@ public:
         m_scale      = Vector3f(1.0f, 1.0f, 1.0f);
         m_worldPos   = Vector3f(0.0f, 0.0f, 0.0f);
         m_rotateInfo = Vector3f(0.0f, 0.0f, 0.0f);
+        m_orientation = Quaternion(0.0f, 0.0f, 0.0f, 1.0f);
+        m_useOrientation = false;
     }
 
     void Scale(float ScaleX, float ScaleY, float ScaleZ)
@@ -32,6 +34,14 @@ public:
         m_rotateInfo.x = RotateX;
         m_rotateInfo.y = RotateY;
         m_rotateInfo.z = RotateZ;
+        m_useOrientation = false;
+    }
+
+    // Unit quaternion, replaces the angles until the next Rotate() with angles
+    void Rotate(const Quaternion& Orientation)
+    {
+        m_orientation = Orientation;
+        m_useOrientation = true;
     }
 
     void SetPerspectiveProj(const PersProjInfo& p)
@@ -46,6 +56,10 @@ public:
         m_camera.Up = Up;
     }
 
+    const Matrix4f& GetViewTrans();
+
+    const Matrix4f& GetVPTrans();
+
     const Matrix4f& GetWVPTrans();
 
     const Matrix4f& GetWorldTrans();
@@ -54,6 +68,8 @@ private:
     Vector3f m_scale;
     Vector3f m_worldPos;
     Vector3f m_rotateInfo;
+    Quaternion m_orientation;
+    bool m_useOrientation;
 
     PersProjInfo m_persProjInfo;
 
@@ -63,6 +79,8 @@ private:
         Vector3f Up;
     } m_camera;
 
+    Matrix4f m_ViewTransformation;
+    Matrix4f m_VPTransformation;
     Matrix4f m_WVPtransformation;
     Matrix4f m_WorldTransformation;
 };
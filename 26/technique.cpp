@@ -4,6 +4,8 @@
 
 #include "technique.h"
 
+UniformStats Technique::s_uniformStats = { 0, 0 };
+
 static const char* pVSName = "VS";
 static const char* pFSName = "FS";
 
@@ -57,7 +59,9 @@ bool Technique::Init()
 }
 
 // Use this method to add shaders to the program. When finished - call finalize()
-bool Technique::AddShader(GLenum ShaderType, const char* pShaderText)
+// pDefines, if given, is inserted right after the #version line so that the
+// same source can be compiled into several permutations.
+bool Technique::AddShader(GLenum ShaderType, const char* pShaderText, const char* pDefines)
 {
     GLuint ShaderObj = glCreateShader(ShaderType);
 
@@ -69,11 +73,31 @@ bool Technique::AddShader(GLenum ShaderType, const char* pShaderText)
     // Save the shader object - will be deleted in the destructor
     m_shaderObjList.push_back(ShaderObj);
 
-    const GLchar* p[1];
+    const GLchar* p[3];
+    GLint Lengths[3];
+    GLsizei NumStrings = 1;
     p[0] = pShaderText;
-    GLint Lengths[1];
     Lengths[0]= strlen(pShaderText);
-    glShaderSource(ShaderObj, 1, p, Lengths);
+
+    if (pDefines) {
+        const char* pVersion = strstr(pShaderText, "#version");
+        const char* pBody = pVersion ? strchr(pVersion, '\n') : NULL;
+
+        if (!pBody) {
+            fprintf(stderr, "Shader defines need a #version line to follow\n");
+            return false;
+        }
+
+        pBody++;
+        Lengths[0] = pBody - pShaderText;
+        p[1] = pDefines;
+        Lengths[1] = strlen(pDefines);
+        p[2] = pBody;
+        Lengths[2] = strlen(pBody);
+        NumStrings = 3;
+    }
+
+    glShaderSource(ShaderObj, NumStrings, p, Lengths);
 
     glCompileShader(ShaderObj);
 
@@ -125,24 +149,253 @@ bool Technique::Finalize()
 
     m_shaderObjList.clear();
 
+    ReflectUniforms();
+
     return true;
 }
 
 
+void Technique::InitNameTable(NameTable& Table, unsigned int NumNames)
+{
+    // Keep the load factor at or below one half so that probing stays short
+    unsigned int Size = 8;
+
+    while (Size < NumNames * 2) {
+        Size *= 2;
+    }
+
+    NameSlot Empty = { 0, 0, -1 };
+    Table.Slots.assign(Size, Empty);
+    Table.Names.clear();
+}
+
+
+void Technique::InsertName(NameTable& Table, const char* pName, GLint Value)
+{
+    const unsigned int Hash = HashUniformName(pName);
+    const unsigned int Mask = Table.Slots.size() - 1;
+
+    for (unsigned int i = Hash & Mask ; ; i = (i + 1) & Mask) {
+        NameSlot& Slot = Table.Slots[i];
+
+        if (Slot.Value < 0) {
+            Slot.Hash = Hash;
+            Slot.NameOffset = Table.Names.size();
+            Slot.Value = Value;
+            Table.Names.insert(Table.Names.end(), pName, pName + strlen(pName) + 1);
+            return;
+        }
+
+        // a different name with the same hash just probes on
+        if (Slot.Hash == Hash && strcmp(&Table.Names[Slot.NameOffset], pName) == 0) {
+            return;
+        }
+    }
+}
+
+
+GLint Technique::FindName(const NameTable& Table, unsigned int Hash, const char* pName)
+{
+    if (Table.Slots.empty()) {
+        return -1;
+    }
+
+    const unsigned int Mask = Table.Slots.size() - 1;
+
+    for (unsigned int i = Hash & Mask ; Table.Slots[i].Value >= 0 ; i = (i + 1) & Mask) {
+        const NameSlot& Slot = Table.Slots[i];
+
+        if (Slot.Hash == Hash && strcmp(&Table.Names[Slot.NameOffset], pName) == 0) {
+            return Slot.Value;
+        }
+    }
+
+    return -1;
+}
+
+
+// Enumerates the active uniforms and uniform blocks of the linked program.
+// Uniforms which the compiler optimized away are simply not in the table.
+void Technique::ReflectUniforms()
+{
+    GLint NumUniforms = 0;
+    GLint NumBlocks = 0;
+    GLchar Name[256];
+
+    if (GLEW_ARB_program_interface_query) {
+        glGetProgramInterfaceiv(m_shaderProg, GL_UNIFORM, GL_ACTIVE_RESOURCES, &NumUniforms);
+        glGetProgramInterfaceiv(m_shaderProg, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &NumBlocks);
+    }
+    else {
+        glGetProgramiv(m_shaderProg, GL_ACTIVE_UNIFORMS, &NumUniforms);
+        glGetProgramiv(m_shaderProg, GL_ACTIVE_UNIFORM_BLOCKS, &NumBlocks);
+    }
+
+    // Arrays are also registered without their "[0]" suffix
+    InitNameTable(m_uniforms, NumUniforms * 2);
+    InitNameTable(m_uniformBlocks, NumBlocks);
+
+    for (GLint i = 0 ; i < NumUniforms ; i++) {
+        GLint Location = -1;
+
+        if (GLEW_ARB_program_interface_query) {
+            const GLenum Props[] = { GL_LOCATION };
+            glGetProgramResourceName(m_shaderProg, GL_UNIFORM, i, sizeof(Name), NULL, Name);
+            glGetProgramResourceiv(m_shaderProg, GL_UNIFORM, i, 1, Props, 1, NULL, &Location);
+        }
+        else {
+            GLint Size;
+            GLenum Type;
+            glGetActiveUniform(m_shaderProg, i, sizeof(Name), NULL, &Size, &Type, Name);
+            Location = glGetUniformLocation(m_shaderProg, Name);
+        }
+
+        // Members of uniform blocks have no location
+        if (Location < 0) {
+            continue;
+        }
+
+        InsertName(m_uniforms, Name, Location);
+
+        size_t Length = strlen(Name);
+
+        if (Length > 3 && strcmp(Name + Length - 3, "[0]") == 0) {
+            Name[Length - 3] = 0;
+            InsertName(m_uniforms, Name, Location);
+        }
+    }
+
+    for (GLint i = 0 ; i < NumBlocks ; i++) {
+        if (GLEW_ARB_program_interface_query) {
+            glGetProgramResourceName(m_shaderProg, GL_UNIFORM_BLOCK, i, sizeof(Name), NULL, Name);
+        }
+        else {
+            glGetActiveUniformBlockName(m_shaderProg, i, sizeof(Name), NULL, Name);
+        }
+
+        InsertName(m_uniformBlocks, Name, i);
+    }
+}
+
+
 void Technique::Enable()
 {
     glUseProgram(m_shaderProg);
 }
 
 
-GLint Technique::GetUniformLocation(const char* pUniformName)
+GLint Technique::GetUniformLocation(const char* pUniformName) const
 {
-    GLint Location = glGetUniformLocation(m_shaderProg, pUniformName);
+    GLint Location = FindName(m_uniforms, HashUniformName(pUniformName), pUniformName);
 
-    if (Location == 0xFFFFFFFF)
+    if (Location < 0)
     {
-        fprintf(stderr, "Warning! Unable to get the location of uniform '%s'\n", pUniformName);
+        fprintf(stderr, "Warning! Uniform '%s' is not active in the program\n", pUniformName);
     }
 
     return Location;
-}
\ No newline at end of file
+}
+
+
+GLint Technique::GetUniformLocation(const UniformId& Id) const
+{
+    return FindName(m_uniforms, Id.Hash, Id.pName);
+}
+
+
+// Connects a uniform block of the program to one of the global binding points
+// (see engine_common.h) so it reads from the buffer attached there.
+bool Technique::BindUniformBlock(const char* pBlockName, GLuint BindingPoint)
+{
+    GLint BlockIndex = FindName(m_uniformBlocks, HashUniformName(pBlockName), pBlockName);
+
+    if (BlockIndex < 0) {
+        fprintf(stderr, "Warning! Unable to get the index of uniform block '%s'\n", pBlockName);
+        return false;
+    }
+
+    glUniformBlockBinding(m_shaderProg, BlockIndex, BindingPoint);
+
+    return true;
+}
+
+
+const UniformStats& Technique::GetUniformStats()
+{
+    return s_uniformStats;
+}
+
+
+void Technique::ResetUniformStats()
+{
+    s_uniformStats.Issued = 0;
+    s_uniformStats.Skipped = 0;
+}
+
+
+// Returns true if the value differs from the one last sent to this location
+// (and records it), false if the GL call can be skipped.
+bool Technique::UpdateShadowValue(GLint Location, const void* pData, unsigned int Size)
+{
+    if (Location < 0) {
+        return false;
+    }
+
+    assert(Size <= sizeof(UniformShadow::Data));
+
+    UniformShadowMap::iterator it = m_uniformShadows.find(Location);
+
+    if (it != m_uniformShadows.end() && it->second.Size == Size &&
+        memcmp(it->second.Data, pData, Size) == 0) {
+        s_uniformStats.Skipped++;
+        return false;
+    }
+
+    UniformShadow& Shadow = m_uniformShadows[Location];
+    Shadow.Size = Size;
+    memcpy(Shadow.Data, pData, Size);
+
+    s_uniformStats.Issued++;
+
+    return true;
+}
+
+
+void Technique::SetUniform1i(GLint Location, int Value)
+{
+    if (UpdateShadowValue(Location, &Value, sizeof(Value))) {
+        glUniform1i(Location, Value);
+    }
+}
+
+
+void Technique::SetUniform1f(GLint Location, float Value)
+{
+    if (UpdateShadowValue(Location, &Value, sizeof(Value))) {
+        glUniform1f(Location, Value);
+    }
+}
+
+
+void Technique::SetUniform2f(GLint Location, const Vector2f& Value)
+{
+    if (UpdateShadowValue(Location, &Value, sizeof(Value))) {
+        glUniform2f(Location, Value.x, Value.y);
+    }
+}
+
+
+void Technique::SetUniform3f(GLint Location, const Vector3f& Value)
+{
+    if (UpdateShadowValue(Location, &Value, sizeof(Value))) {
+        glUniform3f(Location, Value.x, Value.y, Value.z);
+    }
+}
+
+
+void Technique::SetUniformMatrix4f(GLint Location, const Matrix4f& Value)
+{
+    if (UpdateShadowValue(Location, Value.m, sizeof(Value.m))) {
+        glUniformMatrix4fv(Location, 1, GL_TRUE, (const GLfloat*)Value.m);
+    }
+}
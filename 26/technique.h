@@ -2,8 +2,38 @@
 #define	TECHNIQUE_H
 
 #include <list>
+#include <map>
+#include <vector>
+#include <type_traits>
 #include <GL/glew.h>
 
+#include "math_3d.h"
+
+// 32 bit FNV-1a hash of a uniform name. It is constexpr so that the names
+// used by the techniques can be hashed at compile time via UNIFORM_ID().
+constexpr unsigned int HashUniformName(const char* pName, unsigned int Hash = 2166136261u)
+{
+    return (*pName == 0) ? Hash : HashUniformName(pName + 1, (Hash ^ (unsigned char)*pName) * 16777619u);
+}
+
+// The name travels with its hash so that a lookup can tell two names with the
+// same hash apart
+struct UniformId
+{
+    unsigned int Hash;
+    const char* pName;
+};
+
+#define UNIFORM_ID(Name) (UniformId{ std::integral_constant<unsigned int, HashUniformName(Name)>::value, Name })
+
+// Number of glUniform* calls issued and skipped because the program already
+// held the same value. Accumulated across all techniques until reset.
+struct UniformStats
+{
+    unsigned int Issued;
+    unsigned int Skipped;
+};
+
 class Technique
 {
 public:
@@ -16,18 +46,70 @@ public:
 
     void Enable();
 
+    static const UniformStats& GetUniformStats();
+
+    static void ResetUniformStats();
+
 protected:
 
-    bool AddShader(GLenum ShaderType, const char* pShaderText);
+    bool AddShader(GLenum ShaderType, const char* pShaderText, const char* pDefines = NULL);
 
     bool Finalize();
 
-    GLint GetUniformLocation(const char* pUniformName);
+    // Both lookups go through the table built by Finalize() and never call GL
+    GLint GetUniformLocation(const char* pUniformName) const;
+    GLint GetUniformLocation(const UniformId& Id) const;
+
+    bool BindUniformBlock(const char* pBlockName, GLuint BindingPoint);
+
+    // Uniform setters which compare against the last value sent to this
+    // program and skip the GL call when nothing changed
+    void SetUniform1i(GLint Location, int Value);
+    void SetUniform1f(GLint Location, float Value);
+    void SetUniform2f(GLint Location, const Vector2f& Value);
+    void SetUniform3f(GLint Location, const Vector3f& Value);
+    void SetUniformMatrix4f(GLint Location, const Matrix4f& Value);
 
 private:
 
+    bool UpdateShadowValue(GLint Location, const void* pData, unsigned int Size);
+
+    void ReflectUniforms();
+
+    // Open addressing hash table from a name to a uniform location or a
+    // uniform block index. Slots with a negative value are empty. The names
+    // are kept one after the other, zero terminated, in Names and a slot
+    // refers to its name by offset; it is only compared when the hash matches.
+    struct NameSlot {
+        unsigned int Hash;
+        unsigned int NameOffset;
+        GLint Value;
+    };
+
+    struct NameTable {
+        std::vector<NameSlot> Slots;
+        std::vector<char> Names;
+    };
+
+    static void InitNameTable(NameTable& Table, unsigned int NumNames);
+    static void InsertName(NameTable& Table, const char* pName, GLint Value);
+    static GLint FindName(const NameTable& Table, unsigned int Hash, const char* pName);
+
     GLuint m_shaderProg;
 
+    NameTable m_uniforms;
+    NameTable m_uniformBlocks;
+
+    struct UniformShadow {
+        unsigned int Size;
+        unsigned char Data[sizeof(Matrix4f)];
+    };
+
+    typedef std::map<GLint, UniformShadow> UniformShadowMap;
+    UniformShadowMap m_uniformShadows;
+
+    static UniformStats s_uniformStats;
+
     typedef std::list<GLuint> ShaderObjList;
     ShaderObjList m_shaderObjList;
 };
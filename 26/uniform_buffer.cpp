@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <assert.h>
+
+#include "uniform_buffer.h"
+#include "util.h"
+
+UniformBuffer::UniformBuffer()
+{
+    m_ubo = INVALID_OGL_VALUE;
+    m_bindingPoint = 0;
+    m_size = 0;
+}
+
+
+UniformBuffer::~UniformBuffer()
+{
+    if (m_ubo != INVALID_OGL_VALUE) {
+        glDeleteBuffers(1, &m_ubo);
+    }
+}
+
+
+bool UniformBuffer::Init(GLuint BindingPoint, unsigned int Size)
+{
+    m_bindingPoint = BindingPoint;
+    m_size = Size;
+
+    glGenBuffers(1, &m_ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+    glBufferData(GL_UNIFORM_BUFFER, m_size, NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, m_bindingPoint, m_ubo);
+
+    GLenum Error = glGetError();
+
+    if (Error != GL_NO_ERROR) {
+        fprintf(stderr, "Error creating uniform buffer for binding %u: 0x%x\n", BindingPoint, Error);
+        return false;
+    }
+
+    return true;
+}
+
+
+void UniformBuffer::Update(const void* pData, unsigned int Size)
+{
+    assert(Size <= m_size);
+
+    glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, Size, pData);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -0,0 +1,31 @@
+#ifndef UNIFORM_BUFFER_H
+#define	UNIFORM_BUFFER_H
+
+#include <GL/glew.h>
+
+// Wrapper around a uniform buffer object which stays attached to a fixed
+// binding point. Every technique that declares a block with the matching
+// binding reads from the same storage.
+class UniformBuffer
+{
+public:
+
+    UniformBuffer();
+
+    ~UniformBuffer();
+
+    bool Init(GLuint BindingPoint, unsigned int Size);
+
+    // Replaces the contents of the buffer with a single upload
+    void Update(const void* pData, unsigned int Size);
+
+private:
+
+    GLuint m_ubo;
+    GLuint m_bindingPoint;
+    unsigned int m_size;
+};
+
+
+#endif	/* UNIFORM_BUFFER_H */
+